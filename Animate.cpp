@@ -1,7 +1,9 @@
 #include "Animate.h"
+#include "Station.h"
 
 sf::IntRect GetGhostFrame(GhostType type, TargetState state, Dir dir)
 {
+	Animation& animate = gStation->animate;
 	sf::IntRect ghost = { 0,128,32,32 };
 
 	int offset = 0;
@@ -40,9 +42,10 @@ sf::IntRect GetGhostFrame(GhostType type, TargetState state, Dir dir)
 }
 void AnimateUpdate(int ms_elapsed)
 {
+	Animation& animate = gStation->animate;
 	PulseUpdate(ms_elapsed);
 
-	if (gState.player->stopped && !animate.death_animation) {
+	if (gState->player->stopped && !animate.death_animation) {
 		animate.pacman_frame = 0;
 		animate.assending = true;
 	}
@@ -56,9 +59,9 @@ void AnimateUpdate(int ms_elapsed)
 			animate.pacman_frame++;
 		}
 		if (animate.pacman_frame > 10)
-			gState.player->enable_draw = false;
+			gState->player->enable_draw = false;
 	}
-	else if (animate.pacman_timer > 25 && !gState.player->stopped) {
+	else if (animate.pacman_timer > 25 && !gState->player->stopped) {
 		animate.pacman_frame += (animate.assending) ? 1 : -1;
 		animate.pacman_timer = 0;
 	}
@@ -74,7 +77,7 @@ void AnimateUpdate(int ms_elapsed)
 	}
 
 	// start flashing with 2 seconds to go
-	if (gState.energizer_time > 0 && gState.energizer_time < 2000) {
+	if (gState->energizer_time > 0 && gState->energizer_time < 2000) {
 		animate.energrizer_timer += ms_elapsed;
 		if (animate.energrizer_timer > 200) {
 			animate.fright_flash = !animate.fright_flash;
@@ -85,6 +88,7 @@ void AnimateUpdate(int ms_elapsed)
 }
 sf::IntRect GetPacManFrame(Dir dir)
 {
+	Animation& animate = gStation->animate;
 	sf::IntRect rect = { 0,0,30,30 };
 	rect.left = (2 - animate.pacman_frame) * 32;
 
@@ -113,6 +117,7 @@ sf::IntRect GetPacManFrame(Dir dir)
 }
 sf::IntRect GetPoweredPacManFrame(Dir dir)
 {
+	Animation& animate = gStation->animate;
 	sf::IntRect rect = { 0,0,30,30 };
 	rect.left = (2 - animate.pacman_frame) * 32;  // Use the same animation frame as regular Pacman
 
@@ -144,24 +149,33 @@ sf::IntRect GetPoweredPacManFrame(Dir dir)
 }
 void StartPacManDeath()
 {
+	Animation& animate = gStation->animate;
 	animate.death_animation = true;
 	animate.pacman_frame = 0;
 	animate.pacman_timer = -250;
 }
 void ResetAnimation()
 {
+	Animation& animate = gStation->animate;
 	animate.pacman_frame = 0;
 	animate.death_animation = false;
 }
 void SetPacManMenuFrame()
 {
+	Animation& animate = gStation->animate;
 	animate.pacman_frame = 1;
 	animate.death_animation = false;
 
 	animate.ghost_frame_2 = false;
 }
+bool IsDeathAnimation()
+{
+	Animation& animate = gStation->animate;
+	return animate.death_animation;
+}
 void PulseUpdate(int ms_elapsed)
 {
+	Animation& animate = gStation->animate;
 	animate.pulse_timer += ms_elapsed;
 	if (animate.pulse_timer > animate.pulse_limit) {
 		animate.pulse = !animate.pulse;
@@ -170,9 +184,11 @@ void PulseUpdate(int ms_elapsed)
 }
 void SetPulseFrequency(int ms)
 {
+	Animation& animate = gStation->animate;
 	animate.pulse_limit = ms;
 }
 bool IsPulse()
 {
+	Animation& animate = gStation->animate;
 	return animate.pulse;
 }
\ No newline at end of file
@@ -23,12 +23,11 @@ struct Animation
 	int pulse_limit = 200;
 };
 
-static Animation animate;
-
 void AnimateUpdate(int ms_elapsed);
 void StartPacManDeath();
 void ResetAnimation();
 void SetPacManMenuFrame();
+bool IsDeathAnimation();
 
 sf::IntRect GetGhostFrame(GhostType type, TargetState state, Dir dir);
 sf::IntRect GetPacManFrame(Dir dir);
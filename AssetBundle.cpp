@@ -0,0 +1,173 @@
+#include "AssetBundle.h"
+#include "Log.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(AssetBundleHeader) == 16, "bundle header layout");
+static_assert(sizeof(AssetEntry) == 56, "bundle entry layout");
+
+// SFML 2.5 reads wav, ogg and flac, the bundle tool needs 2.6 for the mp3
+const Asset bundle_assets[] = {
+	{ "dots", ASSET_TEXTURE, "textures/dots.png", false },
+	{ "sprites", ASSET_TEXTURE, "textures/sprites.png", false },
+	{ "map", ASSET_TEXTURE, "textures/map.png", false },
+	{ "map_white", ASSET_TEXTURE, "textures/map_white.png", false },
+	{ "font", ASSET_TEXTURE, "textures/font.png", false },
+	{ "poweredbees", ASSET_TEXTURE, "textures/poweredbees.png", false },
+	{ "buzzy", ASSET_TEXTURE, "textures/buzzy.png", false },
+	{ "buzzy_and_friends", ASSET_TEXTURE, "textures/buzzy_and_friends.png", false },
+	{ "flower", ASSET_TEXTURE, "textures/flower.png", false },
+
+	{ "death_1", ASSET_SOUND, "audio/death_1.wav", false },
+	{ "death_2", ASSET_SOUND, "audio/death_2.wav", false },
+	{ "eat_ghost", ASSET_SOUND, "audio/eat_ghost.wav", false },
+	{ "game_start", ASSET_SOUND, "audio/game_start.wav", false },
+	{ "munch_1", ASSET_SOUND, "audio/munch_1.wav", false },
+	{ "munch_2", ASSET_SOUND, "audio/munch_2.wav", false },
+	{ "power_pellet", ASSET_SOUND, "audio/power_pellet.wav", false },
+	{ "retreating", ASSET_SOUND, "audio/retreating.wav", false },
+	{ "siren", ASSET_SOUND, "audio/siren_4.wav", false },
+	{ "button_press", ASSET_SOUND, "audio/button_press.mp3", false },
+	{ "answer_correct", ASSET_SOUND, "audio/answer_correct.wav", false },
+	{ "answer_wrong", ASSET_SOUND, "audio/answer_incorrect.wav", false },
+	{ "win_game", ASSET_SOUND, "audio/win_game.wav", true },
+	{ "lose_game", ASSET_SOUND, "audio/lose_game.wav", true },
+	{ "instruction_ambient", ASSET_SOUND, "audio/instruction_ambient.wav", true },
+	{ "gameplay_ambient", ASSET_SOUND, "audio/gameplay_ambient.wav", true },
+
+	{ "maze", ASSET_TEXT, "Map.txt", false },
+	{ "trivia", ASSET_TRIVIA, "trivia/questions.txt", false },
+};
+const int bundle_asset_count = sizeof(bundle_assets) / sizeof(bundle_assets[0]);
+
+const Asset* FindAsset(AssetType type, const char* name)
+{
+	for (const Asset& asset : bundle_assets) {
+		if (asset.type == type && !std::strcmp(asset.name, name))
+			return &asset;
+	}
+	return nullptr;
+}
+
+bool AssetBundle::open(const std::string& path)
+{
+	if (!file.open(path)) {
+		LOG_INFO("No {}, loading the loose files", path);
+		return false;
+	}
+
+	const AssetBundleHeader* header = (const AssetBundleHeader*)file.data();
+	if (file.size() < sizeof(AssetBundleHeader) || std::memcmp(header->magic, asset_bundle_magic, 4)
+		|| header->version != asset_bundle_version
+		|| file.size() < sizeof(AssetBundleHeader) + uint64_t(header->count) * sizeof(AssetEntry)) {
+		LOG_WARN("{} is damaged or from another version, rebuild it with tools/MakeAssetBundle", path);
+		file.close();
+		return false;
+	}
+	entries = (const AssetEntry*)(file.data() + sizeof(AssetBundleHeader));
+	count = header->count;
+	sound_rate = header->sound_rate;
+
+	for (uint32_t i = 0; i < count; i++) {
+		const AssetEntry& entry = entries[i];
+		bool fits = entry.offset <= file.size() && entry.size <= file.size() - entry.offset;
+		if (entry.type == ASSET_TEXTURE)
+			fits = fits && entry.size == uint64_t(entry.width) * entry.height * 4;
+		else if (entry.type == ASSET_SOUND) {
+			fits = fits && entry.channels >= 1 && entry.channels <= 2 && entry.offset % 2 == 0
+				&& entry.size == uint64_t(entry.width) * entry.channels * sizeof(int16_t);
+		}
+		if (!fits || entry.name[asset_name_size - 1]) {
+			LOG_WARN("{} is damaged, rebuild it with tools/MakeAssetBundle", path);
+			file.close();
+			return false;
+		}
+	}
+
+	for (const Asset& asset : bundle_assets) {
+		if (!asset.optional && !find(asset.type, asset.name)) {
+			LOG_WARN("{} has no {}, rebuild it with tools/MakeAssetBundle", path, asset.name);
+			file.close();
+			return false;
+		}
+	}
+	LOG_INFO("Mapped {}: {} assets, {} KB", path, count, file.size() / 1024);
+	return true;
+}
+
+const AssetEntry* AssetBundle::find(AssetType type, const char* name) const
+{
+	if (!file.isOpen())
+		return nullptr;
+	for (uint32_t i = 0; i < count; i++) {
+		if (entries[i].type == type && !std::strncmp(entries[i].name, name, asset_name_size))
+			return &entries[i];
+	}
+	return nullptr;
+}
+
+// "" for the working directory, else ends in a slash
+static std::string asset_directory;
+
+static bool HasAssets(const std::string& directory)
+{
+	return std::ifstream(directory + asset_bundle_name) || std::ifstream(directory + "Map.txt");
+}
+
+static std::string ExecutableDirectory(const char* argv0)
+{
+	std::string path = argv0 ? argv0 : "";
+#ifdef _WIN32
+	char module[MAX_PATH];
+	DWORD length = GetModuleFileNameA(NULL, module, MAX_PATH);
+	if (length > 0 && length < MAX_PATH)
+		path.assign(module, length);
+#else
+	// argv[0] is just the name when it was found on PATH
+	char link[4096];
+	ssize_t length = readlink("/proc/self/exe", link, sizeof(link));
+	if (length > 0 && length < (ssize_t)sizeof(link))
+		path.assign(link, (size_t)length);
+#endif
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+void FindAssetDirectory(const char* argv0)
+{
+	const char* configured = std::getenv("BUZZY_ASSETS");
+	if (configured && *configured) {
+		asset_directory = configured;
+		if (asset_directory.back() != '/' && asset_directory.back() != '\\')
+			asset_directory += '/';
+	}
+	else if (!HasAssets("")) {
+		std::string directory = ExecutableDirectory(argv0);
+		if (!directory.empty() && HasAssets(directory))
+			asset_directory = directory;
+		else
+			LOG_WARN("No game files in the working directory or next to the executable, set BUZZY_ASSETS");
+	}
+	if (!asset_directory.empty())
+		LOG_INFO("Game files from {}", asset_directory);
+}
+
+std::string AssetPath(const char* path)
+{
+	return asset_directory + path;
+}
+
+const AssetBundle& Assets()
+{
+	static AssetBundle bundle;
+	static bool opened = bundle.open(AssetPath(asset_bundle_name));
+	(void)opened;
+	return bundle;
+}
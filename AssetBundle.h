@@ -0,0 +1,99 @@
+#ifndef ASSETBUNDLE_H
+#define ASSETBUNDLE_H
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+
+// Everything the game reads at startup, prepared by tools/MakeAssetBundle.cpp
+// into one file: textures as raw RGBA, sounds as 16 bit PCM at the mixer's
+// rate, the maze as text and the compiled trivia questions. The game maps it
+// once and uses the bytes where they are. Textures are uploaded straight from
+// the mapping and the mixer plays from it, so nothing is decoded and there's
+// one file to open instead of one per asset. Without a bundle, or with one
+// from another version, the loose files in bundle_assets are loaded instead.
+//
+// Layout, little endian: AssetBundleHeader, header.count AssetEntry, then each
+// asset's data starting on a 16 byte boundary.
+
+const char asset_bundle_magic[4] = { 'B', 'Z', 'A', 'B' };
+const uint32_t asset_bundle_version = 2;
+const char* const asset_bundle_name = "buzzy.assets";
+const int asset_name_size = 24;
+
+enum AssetType : uint16_t
+{
+	ASSET_TEXTURE = 1,			// width * height RGBA pixels
+	ASSET_SOUND = 2,			// frames * channels int16, interleaved
+	ASSET_TEXT = 3,				// lines end in '\n', no '\r'
+	ASSET_TRIVIA = 4,			// a compiled trivia bank, see TriviaBank.h
+};
+
+struct AssetBundleHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t sound_rate;		// mixer_rate when it was built
+};
+
+struct AssetEntry
+{
+	char name[asset_name_size];	// zero padded
+	uint16_t type;				// AssetType
+	uint16_t channels;			// sounds: 1 or 2
+	uint32_t width;				// textures, frames for sounds, questions for trivia
+	uint32_t height;
+	uint32_t reserved;
+	uint64_t offset;			// from the start of the file
+	uint64_t size;				// in bytes
+};
+
+// An asset the game uses and the file it comes from, relative to the game's
+// directory. Optional ones have no file yet and are left out until someone
+// adds one.
+struct Asset
+{
+	const char* name;
+	AssetType type;
+	const char* path;
+	bool optional;
+};
+
+extern const Asset bundle_assets[];
+extern const int bundle_asset_count;
+const Asset* FindAsset(AssetType type, const char* name);
+
+class AssetBundle
+{
+public:
+	// False, and logged, if it's missing, damaged, from another version or
+	// lacks an asset that isn't optional
+	bool open(const std::string& path);
+	bool isOpen() const { return file.isOpen(); }
+
+	// nullptr if the bundle doesn't have it
+	const AssetEntry* find(AssetType type, const char* name) const;
+	const uint8_t* data(const AssetEntry& entry) const { return file.data() + entry.offset; }
+	uint32_t soundRate() const { return sound_rate; }
+
+private:
+	MappedFile file;
+	const AssetEntry* entries = nullptr;
+	uint32_t count = 0;
+	uint32_t sound_rate = 0;
+};
+
+// Sets where the game's files are, before anything is loaded: $BUZZY_ASSETS
+// if it's set, else the working directory if the bundle or Map.txt is there,
+// else the directory the executable is in
+void FindAssetDirectory(const char* argv0);
+
+// A file in the game's directory. Only for what ships with the game, high
+// scores and logs stay in the working directory.
+std::string AssetPath(const char* path);
+
+// The bundle in the game's directory, opened on first use from any thread.
+// Not open if there isn't a usable one.
+const AssetBundle& Assets();
+
+#endif // !ASSETBUNDLE_H
@@ -2,7 +2,9 @@
 #define BUZZY_H
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <SFML/Graphics.hpp>
+#include "StationPtr.h"
 #include "Trivia.h"
 
 enum Dir
@@ -99,7 +101,8 @@ struct Player
 	sf::Vector2f pos;
 	Dir cur_dir;
 	Dir correction;
-	Dir try_dir;
+	Dir try_dir;		// buffered turn, taken at the next opening
+	int try_time = 0;	// ms until try_dir is forgotten
 
 	bool stopped;
 	bool cornering;
@@ -117,6 +120,7 @@ struct GameState
 	int high_score;
 	int wave_counter = 0;
 	int flowersCollected = 0;
+	unsigned flower_leds = 0;	// lit on the Arduino's strip, see FlowerLed
 
 	bool pellet_eaten = false;
 
@@ -138,12 +142,13 @@ struct GameState
 	bool buttonProcessed;
 	unsigned long lastButtonPressTime;
 	bool canAdvanceScreen;
-	unsigned long screenChangeTime;
+	uint64_t screenChangeTime;	// MonotonicMs()
 
 	// Trivia-related fields
 	int selected_trivia_answer;
+	// a view into the trivia bank, render snapshots copy it for free
 	TriviaQuestion current_trivia_question;
-	std::string current_explanation; 
+	int current_explanation = -1;	// the answer whose explanation is shown
 	bool last_answer_was_correct;
 
 	bool can_interact_with_flower;
@@ -154,10 +159,12 @@ struct GameState
 	int pause_time = 0;
 	int wave_time = 0;
 
+	// the station's, drawn from the worker pool, see RenderStation
 	sf::RenderWindow* window;
 };
 
-extern GameState gState;
+// The station this thread is working for, see Station.h
+extern thread_local StationPtr<GameState> gState;
 
 //
 // General Functions
@@ -178,18 +185,18 @@ inline bool InTunnel(sf::Vector2f pos)
 inline char GetTile(int x, int y)
 {
 	// for tunnel, / not used for anything
-	if (x < 0 || x >= gState.board.at(y).size())
+	if (x < 0 || x >= gState->board.at(y).size())
 		return '/';
 
-	return gState.board.at(y).at(x);
+	return gState->board.at(y).at(x);
 }
 inline void SetTile(int x, int y, char new_c)
 {
 	// for tunnel, / not used for anything
-	if (x < 0 || x >= gState.board.at(y).size())
+	if (x < 0 || x >= gState->board.at(y).size())
 		return;
 
-	gState.board.at(y).at(x) = new_c;
+	gState->board.at(y).at(x) = new_c;
 }
 inline sf::Vector2f operator * (sf::Vector2f vec, float num)
 {
@@ -198,15 +205,15 @@ inline sf::Vector2f operator * (sf::Vector2f vec, float num)
 
 inline TargetState GetGlobalTarget()
 {
-	if (gState.wave_counter >= 7)
+	if (gState->wave_counter >= 7)
 		return CHASE;
 
-	return (gState.wave_counter % 2) ? CHASE : CORNER;
+	return (gState->wave_counter % 2) ? CHASE : CORNER;
 }
 inline bool GhostRetreating()
 {
 	for (int i = 0; i < 4; i++) {
-		if (gState.ghosts[i]->target_state == GOHOME)
+		if (gState->ghosts[i]->target_state == GOHOME)
 			return true;
 	}
 
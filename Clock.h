@@ -0,0 +1,21 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+#include <chrono>
+#include <cstdint>
+
+// Milliseconds on a monotonic clock, for timing screens and input. Replaces
+// GetTickCount, which is Windows only and wraps after 49 days.
+inline uint64_t MonotonicMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Microseconds on the same clock, for serial capture timestamps
+inline uint64_t MonotonicUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // !CLOCK_H
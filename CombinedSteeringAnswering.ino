@@ -13,18 +13,28 @@ const int Rpin = 12; // Right direction pin
 const int button = 9; // Button pin
 const int buttonLED = 3; // LED pin
 
+// Build with ANALOG_STICK 1 for an analog stick on A0 (x) and A1 (y) instead
+// of the four direction switches
+#ifndef ANALOG_STICK
+#define ANALOG_STICK 0
+#endif
+const int stickXPin = A0;
+const int stickYPin = A1;
+
 // Operational mode
 bool answeringMode = false; // false = steering mode, true = answering mode
 
-// Button and joystick states
-int L, U, R, D;
-int buttonState;
+// Button and joystick states, as sampled by sampleInputs()
+int L = HIGH, U = HIGH, R = HIGH, D = HIGH;
+int buttonState = HIGH;
 int lastButtonState = HIGH;
 int lastU = HIGH;
 int lastD = HIGH;
 
 // Game state
 int direction = 0;
+unsigned long directionSince = 0; // when the sketch first saw the current direction
+uint8_t directionSeq = 0;         // numbers direction frames so the game can spot gaps
 int answer = 1; // default first answer (1-4)
 bool gameStarted = false;
 
@@ -42,13 +52,164 @@ unsigned long lastButtonDebounceTime = 0;
 const int debounceDelay = 150; // Milliseconds to wait for debounce
 const int buttonDebounceDelay = 300; // Longer debounce for button
 
-// Serial command processing
-String inputString = "";
-bool stringComplete = false;
+// Input sampling. Every pin is polled each millisecond. A change counts
+// straight away, then the pin keeps its new level for PIN_SETTLE_TIME so
+// contact bounce can't read as more presses.
+const unsigned long INPUT_POLL_INTERVAL = 1;
+const unsigned long PIN_SETTLE_TIME = 5;
+struct InputPin {
+  int pin;
+  int level;
+  unsigned long changedAt;
+};
+InputPin inputPins[] = {
+  { Lpin, HIGH, 0 },
+  { Upin, HIGH, 0 },
+  { Rpin, HIGH, 0 },
+  { Dpin, HIGH, 0 },
+  { button, HIGH, 0 }
+};
+const int INPUT_PIN_COUNT = sizeof(inputPins) / sizeof(inputPins[0]);
+
+// Stick position, -127..127 with right and down positive. Sampled every
+// STICK_SAMPLE_INTERVAL and, to a game that speaks protocol version 4, sent
+// by axis when it moved plus both every STICK_REFRESH_INTERVAL.
+const unsigned long STICK_SAMPLE_INTERVAL = 4;
+const unsigned long STICK_REFRESH_INTERVAL = 100;
+const int STICK_MAX = 127;
+const int STICK_MIN_CHANGE = 3;   // smaller moves of an analog stick are noise
+const int STICK_CENTER_SNAP = 4;  // the pots never rest at exactly the middle
+const int STICK_SWITCH_LEVEL = 64; // an analog stick past half way counts as that switch
+int stickX = 0, stickY = 0;
+int sentX = 0, sentY = 0;
+unsigned long lastStickSend = 0;
+bool stickResend = false;
+
+// Text commands from the game are collected here up to the newline
+const int LINE_MAX = 24;
+char lineBuffer[LINE_MAX + 1];
+int lineLength = 0;
+bool lineOverflow = false;
+const int RX_BUDGET = 32; // bytes handled per loop() pass, the rest wait for the next
 
 int count = 0;
 bool buttonStateSent = false; // Flag to ensure we only send button state once per press
 
+// Binary protocol, keep in sync with SerialProtocol.h on the game side.
+// Frames are 4 bytes: FRAME_SYNC, type, value, CRC-8 of type and value.
+const unsigned long TEXT_BAUD = 9600;
+const unsigned long BINARY_BAUD = 115200;
+const uint8_t PROTOCOL_VERSION = 4;
+const uint8_t FRAME_SYNC = 0xA5;
+const int FRAME_SIZE = 4;
+const uint8_t FRAME_HELLO = 0x01;
+const uint8_t FRAME_MODE = 0x02;
+const uint8_t FRAME_GAME_RESET = 0x03;
+const uint8_t FRAME_FLOWER = 0x04;
+const uint8_t FRAME_LEDS = 0x05;
+const uint8_t FRAME_DIRECTION = 0x10;
+const uint8_t FRAME_BUTTON = 0x11;
+const uint8_t FRAME_SELECTED = 0x12;
+const uint8_t FRAME_RESET_GAME = 0x13;
+const uint8_t FRAME_READY = 0x14;
+const uint8_t FRAME_FLOWER_SET = 0x15;
+const uint8_t FRAME_INPUT_AGE = 0x16;
+const uint8_t FRAME_LEDS_SET = 0x17;
+const uint8_t FRAME_STICK_X = 0x18;
+const uint8_t FRAME_STICK_Y = 0x19;
+const unsigned long HELLO_INTERVAL = 100;
+const unsigned long NEGOTIATION_TIMEOUT = 1500;
+
+bool binaryProtocol = false;
+bool helloConfirmed = false;
+uint8_t hostVersion = 0; // from the game's HELLO
+unsigned long negotiationStart = 0;
+unsigned long lastHelloTime = 0;
+uint8_t rxFrame[FRAME_SIZE];
+int rxLength = 0;
+
+// Flower segments on the strip, bit 0 is flower 1. renderStrip() draws
+// flowersWanted a segment per pass and shows it once, at most every
+// STRIP_SHOW_INTERVAL: show() holds interrupts off for about 1 ms.
+const unsigned long STRIP_SHOW_INTERVAL = 10;
+uint8_t flowersWanted = 0;
+uint8_t flowersShown = 0;
+uint8_t flowersDrawing = 0;
+int drawSegment = -1;          // next segment to draw, -1 while idle
+bool stripDirty = false;       // pixels outside the flowers changed too
+unsigned long lastShowTime = 0;
+int flowerAck = 0;             // flower number to acknowledge once shown, 0 for none
+bool ledsAck = false;          // FRAME_LEDS to acknowledge once shown
+
+// Power-on test of the strip, one color step every STARTUP_STEP_TIME, then
+// a step to turn it off again
+const unsigned long STARTUP_STEP_TIME = 100;
+const int STARTUP_STEPS = 9;
+const int STARTUP_DONE = STARTUP_STEPS + 1;
+int startupStep = 0;
+
+// Button LED blinking
+const unsigned long FLASH_INTERVAL = 100;
+int flashToggles = 0;
+unsigned long flashInterval = FLASH_INTERVAL;
+unsigned long lastFlashTime = 0;
+
+// Prototypes. The Arduino IDE generates these itself, they're written out so
+// the sketch also builds as plain C++ for tools/ArduinoEmulator.cpp
+void sampleInputs(unsigned long now);
+void sampleStick(unsigned long now);
+int readStickAxis(int pin);
+bool stickStreaming();
+void streamStick(unsigned long now);
+void readSerial(unsigned long now);
+void receiveTextByte(char c);
+void handleLine(const char* line);
+void receiveFrameByte(uint8_t b);
+void handleFrame(uint8_t type, uint8_t value);
+void startBinaryProtocol();
+void updateNegotiation(unsigned long now);
+void updateButton(unsigned long now);
+void updateControls(unsigned long now);
+uint8_t frameCrc(uint8_t type, uint8_t value);
+void sendFrame(uint8_t type, uint8_t value);
+void sendReady();
+void sendSelected();
+void sendDirection();
+void setColorBasedOnFlower(int flowerNum);
+void showFlowers(uint8_t mask);
+uint32_t flowerColor(int flower);
+void renderStrip(unsigned long now);
+void sendFlowerAcks();
+void updateStartupShow(unsigned long now);
+void endStartupShow();
+void setAllPixels(uint32_t color);
+void setAnsweringMode();
+void setSteeringMode();
+void resetGame();
+void flashLED(int n, unsigned long interval = FLASH_INTERVAL);
+void updateFlash(unsigned long now);
+
+// loop() never waits. Each pass runs the tasks that are due, every one of
+// them short, so the pins are read and commands answered within a
+// millisecond whatever else is going on. Nothing here may call delay().
+struct Task {
+  void (*run)(unsigned long now);
+  unsigned long interval; // ms between runs, 0 for every pass
+  unsigned long lastRun;
+};
+Task tasks[] = {
+  { sampleInputs, INPUT_POLL_INTERVAL, 0 },
+  { sampleStick, STICK_SAMPLE_INTERVAL, 0 },
+  { readSerial, 0, 0 },
+  { updateNegotiation, 0, 0 },
+  { updateButton, 0, 0 },
+  { updateControls, 0, 0 },
+  { updateFlash, 0, 0 },
+  { updateStartupShow, STARTUP_STEP_TIME, 0 },
+  { renderStrip, 0, 0 }
+};
+const int TASK_COUNT = sizeof(tasks) / sizeof(tasks[0]);
+
 void setup() {
   // Configure pins for joystick and button
   pinMode(Lpin, INPUT_PULLUP);
@@ -58,150 +219,216 @@ void setup() {
   pinMode(button, INPUT_PULLUP);
   pinMode(buttonLED, OUTPUT);
 
-  // Initialize LED strip
+  // Initialize LED strip, updateStartupShow() runs the test colors
   strip.begin();
   strip.show();  // Initialize all pixels to 'off'
-  
-  // Test LED strip startup sequence
-  for (int i = 0; i < 3; i++) {
-    // Flash different colors to test the strip
-    setAllPixels(strip.Color(50, 0, 0)); // Red
-    strip.show();
-    delay(100);
-    setAllPixels(strip.Color(0, 50, 0)); // Green
-    strip.show();
-    delay(100);
-    setAllPixels(strip.Color(0, 0, 50)); // Blue
-    strip.show();
-    delay(100);
-  }
-  setAllPixels(strip.Color(0, 0, 0)); // Turn off all LEDs
-  strip.show();
 
-  // Start serial communication
-  Serial.begin(9600);
-  
+  // Start serial communication, always in text until the game asks for binary
+  Serial.begin(TEXT_BAUD);
+
   // Flash LED to indicate startup
-  digitalWrite(buttonLED, HIGH);
-  delay(200);
-  digitalWrite(buttonLED, LOW);
-  delay(200);
-  digitalWrite(buttonLED, HIGH);
-  delay(200);
-  digitalWrite(buttonLED, LOW);
-  
-  // Initialize empty input string
-  inputString.reserve(50);
-  
+  flashLED(2, 200);
+
   // Default to steering mode
   answeringMode = false;
-  Serial.println("READY:STEERING");
+  sendReady();
   Serial.println("Press button to start game");
 }
 
 void loop() {
-  // Check for commands and data from the game
-  checkSerialData();
-  
-  // Read all inputs at the beginning of each loop
-  L = digitalRead(Lpin);
-  U = digitalRead(Upin);
-  R = digitalRead(Rpin);
-  D = digitalRead(Dpin);
-  buttonState = digitalRead(button);
-  
-  // Current time
-  unsigned long currentTime = millis();
-  
+  unsigned long now = millis();
+  for (int i = 0; i < TASK_COUNT; i++) {
+    Task& task = tasks[i];
+    if (task.interval == 0 || now - task.lastRun >= task.interval) {
+      task.lastRun = now;
+      task.run(now);
+    }
+  }
+}
+
+// Poll the joystick and button
+void sampleInputs(unsigned long now) {
+  for (int i = 0; i < INPUT_PIN_COUNT; i++) {
+    InputPin& input = inputPins[i];
+    int level = digitalRead(input.pin);
+    if (level != input.level && now - input.changedAt >= PIN_SETTLE_TIME) {
+      input.level = level;
+      input.changedAt = now;
+    }
+  }
+#if !ANALOG_STICK
+  L = inputPins[0].level;
+  U = inputPins[1].level;
+  R = inputPins[2].level;
+  D = inputPins[3].level;
+#endif
+  buttonState = inputPins[4].level;
+}
+
+void sampleStick(unsigned long now) {
+#if ANALOG_STICK
+  stickX = readStickAxis(stickXPin);
+  stickY = readStickAxis(stickYPin);
+
+  // Answering mode and older games go by the switches
+  L = stickX <= -STICK_SWITCH_LEVEL ? LOW : HIGH;
+  R = stickX >= STICK_SWITCH_LEVEL ? LOW : HIGH;
+  U = stickY <= -STICK_SWITCH_LEVEL ? LOW : HIGH;
+  D = stickY >= STICK_SWITCH_LEVEL ? LOW : HIGH;
+#else
+  stickX = (R == LOW ? STICK_MAX : 0) - (L == LOW ? STICK_MAX : 0);
+  stickY = (D == LOW ? STICK_MAX : 0) - (U == LOW ? STICK_MAX : 0);
+#endif
+  streamStick(now);
+}
+
+// analogRead is 0..1023 with the stick centered around 512. Swap the sign
+// here if the stick is mounted the other way round.
+int readStickAxis(int pin) {
+  long value = (long)(analogRead(pin) - 512) * STICK_MAX / 511;
+  if (value > -STICK_CENTER_SNAP && value < STICK_CENTER_SNAP) {
+    return 0;
+  }
+  return value > STICK_MAX ? STICK_MAX : (value < -STICK_MAX ? -STICK_MAX : (int)value);
+}
+
+// Protocol version 4 at both ends: the position instead of direction words
+bool stickStreaming() {
+  return binaryProtocol && helloConfirmed && hostVersion >= 4;
+}
+
+void streamStick(unsigned long now) {
+  if (!stickStreaming() || !gameStarted || answeringMode) {
+    return;
+  }
+
+  bool refresh = stickResend || now - lastStickSend >= STICK_REFRESH_INTERVAL;
+  if (refresh || (stickX != sentX && (abs(stickX - sentX) >= STICK_MIN_CHANGE || stickX == 0))) {
+    sendFrame(FRAME_STICK_X, (uint8_t)(int8_t)stickX);
+    sentX = stickX;
+  }
+  if (refresh || (stickY != sentY && (abs(stickY - sentY) >= STICK_MIN_CHANGE || stickY == 0))) {
+    sendFrame(FRAME_STICK_Y, (uint8_t)(int8_t)stickY);
+    sentY = stickY;
+  }
+  if (refresh) {
+    lastStickSend = now;
+    stickResend = false;
+  }
+}
+
+void updateButton(unsigned long currentTime) {
   // Process button state changes with proper debouncing
-  if (buttonState == LOW && lastButtonState == HIGH && 
+  if (buttonState == LOW && lastButtonState == HIGH &&
       (currentTime - lastButtonDebounceTime > buttonDebounceDelay)) {
     // Button was just pressed
     lastButtonState = LOW;
     lastButtonDebounceTime = currentTime;
     buttonPressStartTime = currentTime;
     buttonStateSent = false; // Reset this flag on new press
-    
+
     // Visual feedback
     digitalWrite(buttonLED, HIGH);
-    
+
     // Handle immediate button press actions
     if (!gameStarted && count == 4) {
       // Game start button press
       gameStarted = true;
-      Serial.println("NextScreen (GameStart)");
-      Serial.println("Button"); // Also send "Button" keyword for more reliable detection
-    } 
+      if (binaryProtocol) {
+        sendFrame(FRAME_BUTTON, 0);
+      } else {
+        Serial.println("NextScreen (GameStart)");
+        Serial.println("Button"); // Also send "Button" keyword for more reliable detection
+      }
+    }
     else if (answeringMode) {
       // Answering mode button press
-      Serial.print("Button pressed in answering mode: ");
-      Serial.println(answer);
-      
-      // Send multiple forms for redundancy
-      Serial.println("Button");
-      Serial.print("Selected: ");
-      Serial.println(answer);
-      Serial.println("Answering");
-      
+      if (binaryProtocol) {
+        sendFrame(FRAME_SELECTED, answer);
+        sendFrame(FRAME_BUTTON, answer);
+      } else {
+        Serial.print("Button pressed in answering mode: ");
+        Serial.println(answer);
+
+        // Send multiple forms for redundancy
+        Serial.println("Button");
+        Serial.print("Selected: ");
+        Serial.println(answer);
+        Serial.println("Answering");
+      }
+
       buttonStateSent = true;
     }
     else {
       // Regular button press (for navigating instruction screens)
-      Serial.println("NextScreen");
-      Serial.println("Button"); // Also send "Button" for more reliable detection
+      if (binaryProtocol) {
+        sendFrame(FRAME_BUTTON, 0);
+      } else {
+        Serial.println("NextScreen");
+        Serial.println("Button"); // Also send "Button" for more reliable detection
+      }
       count++;
     }
   }
   // Button is held down - check for reset
   else if (buttonState == LOW && lastButtonState == LOW) {
-    // Keep LED on while button is held
-    digitalWrite(buttonLED, HIGH);
-    
+    // Keep LED on while button is held, unless it is flashing
+    if (flashToggles == 0) {
+      digitalWrite(buttonLED, HIGH);
+    }
+
     // Check if button has been held for the reset time (5 seconds)
     if ((currentTime - buttonPressStartTime >= BUTTON_RESET_TIME) && !buttonHeldDown) {
       // Button has been held for 5 seconds - trigger game reset
       buttonHeldDown = true; // Flag to prevent multiple resets while button is held
-      
+
       // Visual feedback - rapid flashing of LED
-      for (int i = 0; i < 5; i++) {
-        digitalWrite(buttonLED, HIGH);
-        delay(50);
-        digitalWrite(buttonLED, LOW);
-        delay(50);
-      }
-      
+      flashLED(5, 50);
+
       // Send reset command to the game
-      Serial.println("RESET_GAME");
-      
+      if (binaryProtocol) {
+        sendFrame(FRAME_RESET_GAME, 0);
+      } else {
+        Serial.println("RESET_GAME");
+      }
+
       // Reset game state variables
       gameStarted = false;
       answeringMode = false;
       count = 0;
     }
-    
+
     // In answering mode, repeatedly send button state while held
-    if (answeringMode && !buttonStateSent && 
-        (currentTime - buttonPressStartTime > 150) && 
+    if (answeringMode && !buttonStateSent &&
+        (currentTime - buttonPressStartTime > 150) &&
         (currentTime - buttonPressStartTime < 800)) {
       // Send multiple forms for redundancy
-      Serial.println("Button");
-      Serial.print("Button pressed in answering mode: ");
-      Serial.println(answer);
+      if (binaryProtocol) {
+        sendFrame(FRAME_BUTTON, answer);
+      } else {
+        Serial.println("Button");
+        Serial.print("Button pressed in answering mode: ");
+        Serial.println(answer);
+      }
       buttonStateSent = true; // Set flag to avoid flooding
     }
-  } 
+  }
   // Button released
   else if (buttonState == HIGH && lastButtonState == LOW) {
     // Button was just released
     lastButtonState = HIGH;
     buttonHeldDown = false; // Reset the held flag when button is released
-    digitalWrite(buttonLED, LOW); // Turn off LED
+    if (flashToggles == 0) {
+      digitalWrite(buttonLED, LOW); // Turn off LED
+    }
   }
-  
-  // Handle input based on current mode
+}
+
+// Handle input based on current mode
+void updateControls(unsigned long currentTime) {
   if (answeringMode) {
     // ANSWERING MODE
-    
+
     // Handle Down press to cycle through answers - with better debouncing
     if (D == LOW && lastD == HIGH && (currentTime - lastDebounceTime > debounceDelay)) {
       lastDebounceTime = currentTime; // Reset debounce timer
@@ -210,19 +437,16 @@ void loop() {
       } else {
         answer = 1;
       }
-      Serial.print("Selected: ");
-      Serial.println(answer);
+      sendSelected();
       lastD = LOW;
-      
+
       // Flash LED briefly to confirm
-      digitalWrite(buttonLED, HIGH);
-      delay(50);
-      digitalWrite(buttonLED, LOW);
-    } 
+      flashLED(1, 50);
+    }
     else if (D == HIGH && lastD == LOW) {
       lastD = HIGH;
     }
-    
+
     // Handle Up press to cycle answers backwards - with better debouncing
     if (U == LOW && lastU == HIGH && (currentTime - lastDebounceTime > debounceDelay)) {
       lastDebounceTime = currentTime; // Reset debounce timer
@@ -231,32 +455,29 @@ void loop() {
       } else {
         answer = 4;
       }
-      Serial.print("Selected: ");
-      Serial.println(answer);
+      sendSelected();
       lastU = LOW;
-      
+
       // Flash LED briefly to confirm
-      digitalWrite(buttonLED, HIGH);
-      delay(50);
-      digitalWrite(buttonLED, LOW);
-    } 
+      flashLED(1, 50);
+    }
     else if (U == HIGH && lastU == LOW) {
       lastU = HIGH;
     }
-    
+
     // Send periodic updates of current selection
     if (currentTime - lastUpdateTime >= updateInterval) {
       // Repeatedly send the current answer selection to ensure it's received
-      Serial.print("Selected: ");
-      Serial.println(answer);
+      sendSelected();
       lastUpdateTime = currentTime;
     }
-    
+
   } else {
     // STEERING MODE
-    
-    // Only process movement if game has started
-    if (gameStarted) {
+
+    // Only process movement if game has started, streamStick() sends it to
+    // a game that takes the stick position
+    if (gameStarted && !stickStreaming()) {
       // Determine current direction
       int newDirection = 0;
       if (L == LOW) {
@@ -271,136 +492,355 @@ void loop() {
       else if (D == LOW) {
         newDirection = 3; // Down
       }
-      
+
       // Send direction on change immediately
       if (newDirection != direction) {
         direction = newDirection;
-        
+        directionSince = currentTime;
+
         // Only send if a direction is active
         if (direction != 0) {
-          switch (direction) {
-            case 1:
-              Serial.println("Up");
-              break;
-            case 2:
-              Serial.println("Right");
-              break;
-            case 3:
-              Serial.println("Down");
-              break;
-            case 4:
-              Serial.println("Left");
-              break;
-          }
+          sendDirection();
         }
       }
-      
+
       // Send periodic updates while direction is held
       if (direction != 0 && currentTime - lastUpdateTime >= updateInterval) {
-        switch (direction) {
-          case 1:
-            Serial.println("Up");
-            break;
-          case 2:
-            Serial.println("Right");
-            break;
-          case 3:
-            Serial.println("Down");
-            break;
-          case 4:
-            Serial.println("Left");
-            break;
-        }
-        
+        sendDirection();
+
         lastUpdateTime = currentTime;
       }
     }
   }
-  
-  // Small delay to avoid serial flooding
-  delay(10);
 }
 
-// Process serial input for commands and data from the game
-void checkSerialData() {
-  while (Serial.available()) {
-    // Try to parse a flower number first
-    if (Serial.peek() >= '0' && Serial.peek() <= '9') {
-      int flowerNum = Serial.parseInt();
-      if (flowerNum >= 1 && flowerNum <= 5) {
-        setColorBasedOnFlower(flowerNum);
-        return;
-      }
+// Take what the game sent, in whichever protocol is active
+void readSerial(unsigned long /* now */) {
+  for (int n = 0; n < RX_BUDGET && Serial.available() > 0; n++) {
+    uint8_t b = Serial.read();
+    if (binaryProtocol) {
+      receiveFrameByte(b);
+    } else {
+      receiveTextByte((char)b);
     }
-    
-    // If not a number, read as a command
-    char inChar = (char)Serial.read();
-    
-    // Add to the input string if not a newline
-    if (inChar != '\n') {
-      inputString += inChar;
+  }
+}
+
+// Text protocol: collect a line, act on it at the newline
+void receiveTextByte(char c) {
+  if (c == '\r') {
+    return;
+  }
+  if (c != '\n') {
+    if (lineLength < LINE_MAX) {
+      lineBuffer[lineLength++] = c;
+    } else {
+      lineOverflow = true;
     }
-    // If the incoming character is a newline, set a flag
-    else {
-      stringComplete = true;
+    return;
+  }
+
+  lineBuffer[lineLength] = '\0';
+  if (!lineOverflow) {
+    handleLine(lineBuffer);
+  }
+  lineLength = 0;
+  lineOverflow = false;
+}
+
+void handleLine(const char* line) {
+  // A flower number
+  if (line[0] >= '0' && line[0] <= '9') {
+    int flowerNum = atoi(line);
+    if (flowerNum >= 1 && flowerNum <= 5) {
+      setColorBasedOnFlower(flowerNum);
     }
-    
-    // Process the command if complete
-    if (stringComplete) {
-      // Check for mode switching commands
-      if (inputString.indexOf("MODE:ANSWERING") >= 0) {
+  }
+  // Check for mode switching commands
+  else if (strstr(line, "MODE:ANSWERING")) {
+    setAnsweringMode();
+  }
+  else if (strstr(line, "MODE:STEERING")) {
+    setSteeringMode();
+  }
+  else if (strstr(line, "GAME:RESET")) {
+    resetGame();
+  }
+  else if (strstr(line, "PROTO:BINARY")) {
+    startBinaryProtocol();
+  }
+}
+
+// Binary protocol: collect 4 byte frames and act on the ones with a good CRC
+void receiveFrameByte(uint8_t b) {
+  if (rxLength == 0 && b != FRAME_SYNC) {
+    return;
+  }
+  rxFrame[rxLength++] = b;
+  if (rxLength < FRAME_SIZE) {
+    return;
+  }
+
+  if (frameCrc(rxFrame[1], rxFrame[2]) == rxFrame[3]) {
+    rxLength = 0;
+    handleFrame(rxFrame[1], rxFrame[2]);
+  } else {
+    // The sync byte was data, start again from the next one
+    int next = 1;
+    while (next < FRAME_SIZE && rxFrame[next] != FRAME_SYNC) {
+      next++;
+    }
+    rxLength = FRAME_SIZE - next;
+    memmove(rxFrame, rxFrame + next, rxLength);
+  }
+}
+
+void handleFrame(uint8_t type, uint8_t value) {
+  switch (type) {
+    case FRAME_HELLO:
+      helloConfirmed = true;
+      hostVersion = value;
+      break;
+    case FRAME_MODE:
+      if (value) {
         setAnsweringMode();
-      }
-      else if (inputString.indexOf("MODE:STEERING") >= 0) {
+      } else {
         setSteeringMode();
       }
-      else if (inputString.indexOf("GAME:RESET") >= 0) {
-        resetGame();
+      break;
+    case FRAME_GAME_RESET:
+      resetGame();
+      break;
+    case FRAME_FLOWER:
+      if (value >= 1 && value <= 5) {
+        setColorBasedOnFlower(value);
       }
-      
-      // Clear the string for the next command
-      inputString = "";
-      stringComplete = false;
+      break;
+    case FRAME_LEDS:
+      showFlowers(value & 0x0F);
+      ledsAck = true;
+      break;
+  }
+}
+
+// The game asked for binary, answer in text then switch baud rate
+void startBinaryProtocol() {
+  Serial.println("PROTO:BINARY OK");
+  Serial.flush();
+  Serial.end();
+  Serial.begin(BINARY_BAUD);
+
+  binaryProtocol = true;
+  helloConfirmed = false;
+  hostVersion = 0;
+  negotiationStart = millis();
+  lastHelloTime = 0;
+  rxLength = 0;
+}
+
+// Repeat HELLO until the game answers, fall back to text if it never does
+void updateNegotiation(unsigned long now) {
+  if (!binaryProtocol || helloConfirmed) {
+    return;
+  }
+
+  if (now - negotiationStart > NEGOTIATION_TIMEOUT) {
+    Serial.flush();
+    Serial.end();
+    Serial.begin(TEXT_BAUD);
+    binaryProtocol = false;
+    lineLength = 0;
+    lineOverflow = false;
+    return;
+  }
+  if (lastHelloTime == 0 || now - lastHelloTime >= HELLO_INTERVAL) {
+    sendFrame(FRAME_HELLO, PROTOCOL_VERSION);
+    lastHelloTime = now;
+  }
+}
+
+// CRC-8, polynomial 0x07, initial value 0
+uint8_t frameCrc(uint8_t type, uint8_t value) {
+  uint8_t crc = 0;
+  uint8_t bytes[2] = { type, value };
+  for (int i = 0; i < 2; i++) {
+    crc ^= bytes[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
     }
   }
+  return crc;
 }
 
-// Set colors on LED strip based on flower number
-void setColorBasedOnFlower(int flowerNum) {
-  //green,red, purple, blue
-  uint32_t color;
-  
-  if (flowerNum == 1) {
-    color = strip.Color(0, 128, 0);  //green
-    for (int i = 1; i < 4; i++) {
-      strip.setPixelColor(i, color);
+void sendFrame(uint8_t type, uint8_t value) {
+  uint8_t frame[FRAME_SIZE] = { FRAME_SYNC, type, value, frameCrc(type, value) };
+  Serial.write(frame, FRAME_SIZE);
+}
+
+// Messages to the game, in whichever protocol is active
+void sendReady() {
+  // The game centers its copy of the stick on READY, send it all again
+  stickResend = true;
+  if (binaryProtocol) {
+    sendFrame(FRAME_READY, answeringMode ? 1 : 0);
+  } else {
+    Serial.println(answeringMode ? "READY:ANSWERING" : "READY:STEERING");
+  }
+}
+
+void sendSelected() {
+  if (binaryProtocol) {
+    sendFrame(FRAME_SELECTED, answer);
+  } else {
+    Serial.print("Selected: ");
+    Serial.println(answer);
+  }
+}
+
+void sendDirection() {
+  if (binaryProtocol) {
+    // A version 1 game reads the whole value as the direction and doesn't
+    // know INPUT_AGE
+    if (hostVersion < 2) {
+      sendFrame(FRAME_DIRECTION, direction);
+      return;
     }
-  } else if (flowerNum == 2) {
-    color = strip.Color(160, 32, 240);  //purple
-    for (int i = 5; i < 8; i++) {
-      strip.setPixelColor(i, color);
+    // How long this direction has been known here, for the game's latency stats
+    unsigned long age = millis() - directionSince;
+    sendFrame(FRAME_INPUT_AGE, age > 255 ? 255 : age);
+    sendFrame(FRAME_DIRECTION, direction | (directionSeq << 3));
+    directionSeq = (directionSeq + 1) & 0x1F;
+    return;
+  }
+  switch (direction) {
+    case 1:
+      Serial.println("Up");
+      break;
+    case 2:
+      Serial.println("Right");
+      break;
+    case 3:
+      Serial.println("Down");
+      break;
+    case 4:
+      Serial.println("Left");
+      break;
+  }
+}
+
+// Set colors on LED strip based on flower number. Games before protocol
+// version 3 send one flower at a time, they add up and 5 turns them all off.
+void setColorBasedOnFlower(int flowerNum) {
+  if (flowerNum == 5) {
+    showFlowers(0);
+  } else {
+    showFlowers(flowersWanted | (1 << (flowerNum - 1)));
+  }
+
+  // Acknowledged once the strip shows it
+  flowerAck = flowerNum;
+}
+
+// Light the segments of the flowers in mask and turn the others off.
+// renderStrip() puts it on the strip, one show() however many changed.
+void showFlowers(uint8_t mask) {
+  endStartupShow();
+  flowersWanted = mask;
+}
+
+//green, purple, red, blue
+uint32_t flowerColor(int flower) {
+  switch (flower) {
+    case 0:
+      return strip.Color(0, 128, 0);
+    case 1:
+      return strip.Color(160, 32, 240);
+    case 2:
+      return strip.Color(255, 0, 0);
+    default:
+      return strip.Color(0, 0, 255);
+  }
+}
+
+void renderStrip(unsigned long now) {
+  if (startupStep != STARTUP_DONE) {
+    return;
+  }
+  if (drawSegment < 0) {
+    if (flowersWanted == flowersShown && !stripDirty) {
+      sendFlowerAcks();
+      return;
     }
-  } else if (flowerNum == 3) {
-    color = strip.Color(255, 0, 0);  //red
-    for (int i = 9; i < 12; i++) {
-      strip.setPixelColor(i, color);
+    if (now - lastShowTime < STRIP_SHOW_INTERVAL) {
+      return;
     }
-  } else if (flowerNum == 4) {
-    color = strip.Color(0, 0, 255);  //blue
-    for (int i = 13; i < 16; i++) {
+    flowersDrawing = flowersWanted;
+    drawSegment = 0;
+  }
+
+  // A segment per pass, then the show on a pass of its own
+  if (drawSegment < 4) {
+    uint32_t color = (flowersDrawing & (1 << drawSegment)) ? flowerColor(drawSegment) : strip.Color(0, 0, 0);
+    for (int i = drawSegment * 4 + 1; i < drawSegment * 4 + 4; i++) {
       strip.setPixelColor(i, color);
     }
-  } else { //turns off strip when end game
-    for (int i = 0; i < LED_COUNT; i++) {
-      strip.setPixelColor(i, strip.Color(0, 0, 0));  
+    drawSegment++;
+    return;
+  }
+  strip.show();
+  lastShowTime = now;
+  flowersShown = flowersDrawing;
+  stripDirty = false;
+  drawSegment = -1;
+}
+
+// The flower commands the strip has caught up with
+void sendFlowerAcks() {
+  if (flowerAck) {
+    if (binaryProtocol) {
+      sendFrame(FRAME_FLOWER_SET, flowerAck);
+    } else {
+      Serial.print("Set flower: ");
+      Serial.println(flowerAck);
     }
+    flowerAck = 0;
+  }
+  if (ledsAck) {
+    sendFrame(FRAME_LEDS_SET, flowersShown);
+    ledsAck = false;
+  }
+}
+
+// Test LED strip startup sequence: red, green, blue three times
+void updateStartupShow(unsigned long /* now */) {
+  if (startupStep == STARTUP_DONE) {
+    return;
+  }
+  if (startupStep == STARTUP_STEPS) {
+    endStartupShow();
+    return;
+  }
+
+  if (startupStep % 3 == 0) {
+    setAllPixels(strip.Color(50, 0, 0)); // Red
+  } else if (startupStep % 3 == 1) {
+    setAllPixels(strip.Color(0, 50, 0)); // Green
+  } else {
+    setAllPixels(strip.Color(0, 0, 50)); // Blue
   }
-  
   strip.show();
-  
-  // Acknowledge receipt of flower command
-  Serial.print("Set flower: ");
-  Serial.println(flowerNum);
+  startupStep++;
+}
+
+// Done with the test, or cut it short because the game wants the strip.
+// renderStrip() shows the cleared pixels along with the flowers.
+void endStartupShow() {
+  if (startupStep == STARTUP_DONE) {
+    return;
+  }
+  setAllPixels(strip.Color(0, 0, 0)); // Turn off all LEDs
+  startupStep = STARTUP_DONE;
+  stripDirty = true;
 }
 
 // Set all pixels to a specific color
@@ -412,46 +852,51 @@ void setAllPixels(uint32_t color) {
 
 // Switch to answering mode
 void setAnsweringMode() {
-  if (!answeringMode) {
-    answeringMode = true;
-    
-    // Reset answer to 1 when entering answering mode
-    answer = 1;
-    
-    // Visual feedback (flash LED)
-    flashLED(3);
-    
-    // Inform the game
-    Serial.println("READY:ANSWERING");
-    
-    // Ensure initial selection is sent multiple times
-    Serial.print("Selected: ");
-    Serial.println(answer);
-    delay(50);
-    Serial.print("Selected: ");
-    Serial.println(answer);
-    
-    // Reset button state
-    lastButtonState = HIGH;
-    buttonStateSent = false;
+  if (answeringMode) {
+    // Already there, still acknowledge - the game resends commands it got no answer to
+    sendReady();
+    return;
   }
+
+  answeringMode = true;
+
+  // Reset answer to 1 when entering answering mode
+  answer = 1;
+
+  // Visual feedback (flash LED)
+  flashLED(3);
+
+  // Inform the game
+  sendReady();
+
+  // Initial selection, updateControls() repeats it every updateInterval
+  sendSelected();
+  lastUpdateTime = millis();
+
+  // Reset button state
+  lastButtonState = HIGH;
+  buttonStateSent = false;
 }
 
 // Switch to steering mode
 void setSteeringMode() {
-  if (answeringMode) {
-    answeringMode = false;
-    
-    // Visual feedback (flash LED)
-    flashLED(2);
-    
-    // Inform the game
-    Serial.println("READY:STEERING");
-    
-    // Reset states
-    lastButtonState = HIGH;
-    buttonStateSent = false;
+  if (!answeringMode) {
+    // Already there, still acknowledge - the game resends commands it got no answer to
+    sendReady();
+    return;
   }
+
+  answeringMode = false;
+
+  // Visual feedback (flash LED)
+  flashLED(2);
+
+  // Inform the game
+  sendReady();
+
+  // Reset states
+  lastButtonState = HIGH;
+  buttonStateSent = false;
 }
 
 // Reset the game state
@@ -460,29 +905,35 @@ void resetGame() {
   direction = 0;
   answeringMode = false;
   answer = 1;
-  
+
   // Turn off all LEDs on the strip
-  setAllPixels(strip.Color(0, 0, 0));
-  strip.show();
-  
+  showFlowers(0);
+
   // Visual feedback
   flashLED(5);
-  
+
   // Inform the game
-  Serial.println("READY:STEERING");
-  Serial.println("Press button to start game");
-  
+  sendReady();
+  if (!binaryProtocol) {
+    Serial.println("Press button to start game");
+  }
+
   // Reset states
   lastButtonState = HIGH;
   buttonStateSent = false;
 }
 
-// Flash the LED n times
-void flashLED(int n) {
-  for (int i = 0; i < n; i++) {
-    digitalWrite(buttonLED, HIGH);
-    delay(100);
-    digitalWrite(buttonLED, LOW);
-    delay(100);
+// Flash the LED n times, updateFlash() does the blinking
+void flashLED(int n, unsigned long interval) {
+  flashToggles = 2 * n;
+  flashInterval = interval;
+  lastFlashTime = millis() - interval;
+}
+
+void updateFlash(unsigned long now) {
+  if (flashToggles > 0 && now - lastFlashTime >= flashInterval) {
+    flashToggles--;
+    digitalWrite(buttonLED, (flashToggles % 2) ? HIGH : LOW);
+    lastFlashTime = now;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,462 @@
+#include "FrameCapture.h"
+#include <SFML/OpenGL.hpp>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <exception>
+#include "Log.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// GL 2.1 pixel buffer objects aren't in the 1.1 headers every platform ships
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+typedef void (APIENTRY* GenBuffersFn)(GLsizei, GLuint*);
+typedef void (APIENTRY* DeleteBuffersFn)(GLsizei, const GLuint*);
+typedef void (APIENTRY* BindBufferFn)(GLenum, GLuint);
+typedef void (APIENTRY* BufferDataFn)(GLenum, std::ptrdiff_t, const void*, GLenum);
+typedef void* (APIENTRY* MapBufferFn)(GLenum, GLenum);
+typedef GLboolean(APIENTRY* UnmapBufferFn)(GLenum);
+
+struct PboFunctions
+{
+	GenBuffersFn genBuffers = nullptr;
+	DeleteBuffersFn deleteBuffers = nullptr;
+	BindBufferFn bindBuffer = nullptr;
+	BufferDataFn bufferData = nullptr;
+	MapBufferFn mapBuffer = nullptr;
+	UnmapBufferFn unmapBuffer = nullptr;
+};
+
+const int pbo_count = 3;
+// raw frames waiting for the worker, more than this and we start dropping
+const int slot_count = 4;
+
+struct CaptureState
+{
+	bool requested = false;		// between InitFrameCapture and ShutdownFrameCapture
+	bool enabled = false;		// and the window is big enough to capture
+	unsigned width = 0, height = 0;		// window pixels read back
+	unsigned out_w = 0, out_h = 0;		// encoded size after downscaling
+	size_t frame_bytes = 0;			// one RGBA readback
+	size_t yuv_bytes = 0;			// one encoded YUV 4:2:0 frame
+
+	PboFunctions gl;
+	GLuint pbos[pbo_count] = {};
+	int pbo_index = 0;
+	int pbo_filled = 0;
+	sf::Clock interval_clock;
+
+	// render thread -> worker, single producer single consumer
+	std::vector<unsigned char> slots[slot_count];
+	std::atomic<unsigned> slot_head{ 0 };	// written by render thread
+	std::atomic<unsigned> slot_tail{ 0 };	// written by worker
+	unsigned dropped = 0;
+
+	// worker only
+	std::vector<unsigned char> history;
+	int history_next = 0;
+	int history_count = 0;
+	std::vector<unsigned char> scaled_rgb;
+	FILE* record_file = nullptr;
+
+	std::thread worker;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> dump_requested{ false };
+	std::atomic<bool> record_toggle{ false };
+	std::atomic<bool> dump_done{ false };
+};
+
+static CaptureState cap;
+
+static std::string CaptureFileName(const char* prefix)
+{
+	char stamp[32];
+	std::time_t now = std::time(nullptr);
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+	return std::string(prefix) + "_" + stamp + ".y4m";
+}
+
+static FILE* OpenY4M(const std::string& name)
+{
+	FILE* file = std::fopen(name.c_str(), "wb");
+	if (file)
+		std::fprintf(file, "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C420jpeg\n", cap.out_w, cap.out_h, capture_fps);
+	else
+		LOG_ERROR("Failed to open capture file: {}", name);
+	return file;
+}
+
+static void WriteY4MFrame(FILE* file, const unsigned char* yuv)
+{
+	std::fputs("FRAME\n", file);
+	std::fwrite(yuv, 1, cap.yuv_bytes, file);
+}
+
+// Box-filter the bottom-up RGBA readback down to out_w x out_h and flip it,
+// then convert to full range BT.601 YUV 4:2:0 planes.
+static void EncodeFrame(const unsigned char* rgba, unsigned char* yuv)
+{
+	const int s = capture_scale;
+	unsigned char* rgb = cap.scaled_rgb.data();
+
+	for (unsigned y = 0; y < cap.out_h; y++) {
+		for (unsigned x = 0; x < cap.out_w; x++) {
+			unsigned r = 0, g = 0, b = 0;
+			for (int dy = 0; dy < s; dy++) {
+				// GL rows start at the bottom of the window
+				const unsigned char* row = rgba + (size_t)(cap.height - 1 - (y * s + dy)) * cap.width * 4;
+				for (int dx = 0; dx < s; dx++) {
+					const unsigned char* px = row + (x * s + dx) * 4;
+					r += px[0];
+					g += px[1];
+					b += px[2];
+				}
+			}
+			unsigned char* out = rgb + (y * cap.out_w + x) * 3;
+			out[0] = r / (s * s);
+			out[1] = g / (s * s);
+			out[2] = b / (s * s);
+		}
+	}
+
+	unsigned char* y_plane = yuv;
+	unsigned char* u_plane = yuv + cap.out_w * cap.out_h;
+	unsigned char* v_plane = u_plane + (cap.out_w / 2) * (cap.out_h / 2);
+
+	for (unsigned i = 0; i < cap.out_w * cap.out_h; i++) {
+		const unsigned char* px = rgb + i * 3;
+		y_plane[i] = (77 * px[0] + 150 * px[1] + 29 * px[2]) >> 8;
+	}
+
+	for (unsigned y = 0; y < cap.out_h / 2; y++) {
+		for (unsigned x = 0; x < cap.out_w / 2; x++) {
+			int r = 0, g = 0, b = 0;
+			for (int dy = 0; dy < 2; dy++) {
+				for (int dx = 0; dx < 2; dx++) {
+					const unsigned char* px = rgb + ((y * 2 + dy) * cap.out_w + x * 2 + dx) * 3;
+					r += px[0];
+					g += px[1];
+					b += px[2];
+				}
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+			int u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+			int v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+			u_plane[y * (cap.out_w / 2) + x] = u < 0 ? 0 : (u > 255 ? 255 : u);
+			v_plane[y * (cap.out_w / 2) + x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+		}
+	}
+}
+
+static void DumpHistory()
+{
+	std::string name = CaptureFileName("dump");
+	FILE* file = OpenY4M(name);
+	if (!file)
+		return;
+
+	// oldest frame first
+	int history_frames = capture_fps * capture_history_seconds;
+	int first = (cap.history_next - cap.history_count + history_frames) % history_frames;
+	for (int i = 0; i < cap.history_count; i++) {
+		int idx = (first + i) % history_frames;
+		WriteY4MFrame(file, cap.history.data() + idx * cap.yuv_bytes);
+	}
+	std::fclose(file);
+	LOG_INFO("Dumped last {} captured frames to {}", cap.history_count, name);
+}
+
+static void CaptureWorkerMain()
+{
+	int history_frames = capture_fps * capture_history_seconds;
+
+	while (cap.running) {
+		{
+			std::unique_lock<std::mutex> lock(cap.wake_mutex);
+			cap.wake.wait_for(lock, std::chrono::milliseconds(20), [] {
+				return cap.slot_tail.load() != cap.slot_head.load() || cap.dump_requested || cap.record_toggle || !cap.running;
+			});
+		}
+
+		while (cap.slot_tail.load(std::memory_order_relaxed) != cap.slot_head.load(std::memory_order_acquire)) {
+			unsigned tail = cap.slot_tail.load(std::memory_order_relaxed);
+			unsigned char* yuv = cap.history.data() + cap.history_next * cap.yuv_bytes;
+			EncodeFrame(cap.slots[tail % slot_count].data(), yuv);
+			cap.slot_tail.store(tail + 1, std::memory_order_release);
+
+			cap.history_next = (cap.history_next + 1) % history_frames;
+			if (cap.history_count < history_frames)
+				cap.history_count++;
+
+			if (cap.record_file)
+				WriteY4MFrame(cap.record_file, yuv);
+		}
+
+		if (cap.record_toggle.exchange(false)) {
+			if (cap.record_file) {
+				std::fclose(cap.record_file);
+				cap.record_file = nullptr;
+				LOG_INFO("Capture recording stopped");
+			}
+			else {
+				std::string name = CaptureFileName("capture");
+				cap.record_file = OpenY4M(name);
+				if (cap.record_file)
+					LOG_INFO("Capture recording to {}", name);
+			}
+		}
+
+		if (cap.dump_requested.exchange(false)) {
+			DumpHistory();
+			cap.dump_done = true;
+		}
+	}
+
+	if (cap.record_file) {
+		std::fclose(cap.record_file);
+		cap.record_file = nullptr;
+	}
+}
+
+// Last chance to keep the clip leading up to a crash, give the worker a
+// moment to dump it. Nothing here is safe in a signal handler and the worker
+// may be what crashed, so it's a best effort on the way down.
+static void DumpBeforeCrash()
+{
+	static std::atomic<bool> dumping{ false };
+	if (!cap.running || dumping.exchange(true))
+		return;
+	cap.dump_done = false;
+	RequestCaptureDump();
+	for (int i = 0; i < 200 && !cap.dump_done; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+static void OnTerminate()
+{
+	DumpBeforeCrash();
+	std::abort();
+}
+
+// then crash the way it would have without us
+static void OnCrashSignal(int signal)
+{
+	DumpBeforeCrash();
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
+
+#ifdef _WIN32
+// access violations and the like never reach a signal handler on Windows
+static LONG WINAPI OnUnhandledException(EXCEPTION_POINTERS*)
+{
+	DumpBeforeCrash();
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+
+static void InstallCrashHandlers()
+{
+	std::set_terminate(OnTerminate);
+	const int signals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+	for (int signal : signals)
+		std::signal(signal, OnCrashSignal);
+#ifdef _WIN32
+	SetUnhandledExceptionFilter(OnUnhandledException);
+#endif
+}
+
+// Buffers and the worker for the window's current size. Too small to
+// downscale leaves the capture off until the next resize.
+static void StartCapture(const sf::RenderWindow& window)
+{
+	sf::Vector2u size = window.getSize();
+	cap.width = size.x;
+	cap.height = size.y;
+	cap.out_w = (size.x / capture_scale) & ~1u;
+	cap.out_h = (size.y / capture_scale) & ~1u;
+	if (cap.out_w == 0 || cap.out_h == 0)
+		return;
+
+	cap.frame_bytes = (size_t)cap.width * cap.height * 4;
+	cap.yuv_bytes = (size_t)cap.out_w * cap.out_h * 3 / 2;
+
+	for (int i = 0; i < slot_count; i++)
+		cap.slots[i].resize(cap.frame_bytes);
+	cap.history.resize(cap.yuv_bytes * capture_fps * capture_history_seconds);
+	cap.scaled_rgb.resize((size_t)cap.out_w * cap.out_h * 3);
+
+	cap.gl.genBuffers = (GenBuffersFn)sf::Context::getFunction("glGenBuffers");
+	cap.gl.deleteBuffers = (DeleteBuffersFn)sf::Context::getFunction("glDeleteBuffers");
+	cap.gl.bindBuffer = (BindBufferFn)sf::Context::getFunction("glBindBuffer");
+	cap.gl.bufferData = (BufferDataFn)sf::Context::getFunction("glBufferData");
+	cap.gl.mapBuffer = (MapBufferFn)sf::Context::getFunction("glMapBuffer");
+	cap.gl.unmapBuffer = (UnmapBufferFn)sf::Context::getFunction("glUnmapBuffer");
+
+	bool have_pbo = cap.gl.genBuffers && cap.gl.deleteBuffers && cap.gl.bindBuffer &&
+		cap.gl.bufferData && cap.gl.mapBuffer && cap.gl.unmapBuffer;
+	if (have_pbo) {
+		cap.gl.genBuffers(pbo_count, cap.pbos);
+		for (int i = 0; i < pbo_count; i++) {
+			cap.gl.bindBuffer(GL_PIXEL_PACK_BUFFER, cap.pbos[i]);
+			cap.gl.bufferData(GL_PIXEL_PACK_BUFFER, cap.frame_bytes, nullptr, GL_STREAM_READ);
+		}
+		cap.gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	else {
+		cap.gl = PboFunctions();
+		LOG_INFO("Pixel buffer objects unavailable, capture will read back synchronously");
+	}
+
+	cap.pbo_index = 0;
+	cap.pbo_filled = 0;
+	cap.slot_head = 0;
+	cap.slot_tail = 0;
+	cap.history_next = 0;
+	cap.history_count = 0;
+
+	cap.enabled = true;
+	cap.running = true;
+	cap.worker = std::thread(CaptureWorkerMain);
+}
+
+// Joins the worker, which closes a recording, and frees the PBOs
+static void StopCapture()
+{
+	if (!cap.enabled)
+		return;
+	cap.enabled = false;
+
+	cap.running = false;
+	cap.wake.notify_one();
+	if (cap.worker.joinable())
+		cap.worker.join();
+
+	if (cap.gl.deleteBuffers)
+		cap.gl.deleteBuffers(pbo_count, cap.pbos);
+}
+
+void InitFrameCapture(const sf::RenderWindow& window)
+{
+	cap.requested = true;
+	StartCapture(window);
+	InstallCrashHandlers();
+}
+
+// Hands the next free slot to the worker, or drops the frame if it's behind
+static unsigned char* AcquireSlot()
+{
+	unsigned head = cap.slot_head.load(std::memory_order_relaxed);
+	if (head - cap.slot_tail.load(std::memory_order_acquire) >= slot_count) {
+		cap.dropped++;
+		return nullptr;
+	}
+	return cap.slots[head % slot_count].data();
+}
+static void SubmitSlot()
+{
+	cap.slot_head.fetch_add(1, std::memory_order_release);
+	cap.wake.notify_one();
+}
+
+void CaptureFrame(const sf::RenderWindow& window)
+{
+	if (!cap.requested)
+		return;
+	// A .y4m has one frame size, so a resize starts over with an empty
+	// history. A recording in progress ends, F11 starts a new one.
+	sf::Vector2u size = window.getSize();
+	if (size.x != cap.width || size.y != cap.height) {
+		LOG_INFO("Window resized to {}x{}, frame capture starts over", size.x, size.y);
+		StopCapture();
+		StartCapture(window);
+	}
+	if (!cap.enabled)
+		return;
+	if (cap.interval_clock.getElapsedTime() < sf::seconds(1.f / capture_fps))
+		return;
+	cap.interval_clock.restart();
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	if (!cap.gl.bindBuffer) {
+		unsigned char* slot = AcquireSlot();
+		if (!slot)
+			return;
+		glReadPixels(0, 0, cap.width, cap.height, GL_RGBA, GL_UNSIGNED_BYTE, slot);
+		SubmitSlot();
+		return;
+	}
+
+	// Queue this frame's readback, it completes asynchronously on the GPU
+	cap.gl.bindBuffer(GL_PIXEL_PACK_BUFFER, cap.pbos[cap.pbo_index]);
+	glReadPixels(0, 0, cap.width, cap.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	// then collect the oldest one, which has had pbo_count - 1 frames to finish
+	int oldest = (cap.pbo_index + 1) % pbo_count;
+	cap.pbo_index = oldest;
+	if (cap.pbo_filled < pbo_count - 1) {
+		cap.pbo_filled++;
+	}
+	else {
+		cap.gl.bindBuffer(GL_PIXEL_PACK_BUFFER, cap.pbos[oldest]);
+		const void* pixels = cap.gl.mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+		if (pixels) {
+			unsigned char* slot = AcquireSlot();
+			if (slot) {
+				std::memcpy(slot, pixels, cap.frame_bytes);
+				SubmitSlot();
+			}
+			cap.gl.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+	}
+	cap.gl.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ShutdownFrameCapture()
+{
+	if (!cap.requested)
+		return;
+	cap.requested = false;
+	StopCapture();
+
+	if (cap.dropped > 0)
+		LOG_INFO("Frame capture dropped {} frames", cap.dropped);
+}
+
+void RequestCaptureDump()
+{
+	cap.dump_requested = true;
+	cap.wake.notify_one();
+}
+
+void ToggleCaptureRecording()
+{
+	cap.record_toggle = true;
+	cap.wake.notify_one();
+}
@@ -0,0 +1,31 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+#include <SFML/Graphics.hpp>
+
+// Gameplay capture for attract-mode clips and bug reports.
+// Whoever draws the frame reads it back through a ring of pixel buffer
+// objects and hands it to a worker thread, which downscales, converts to
+// YUV 4:2:0 and keeps a rolling history that can be dumped as a .y4m file.
+// Neither the renderer nor the sim ever waits on the encoder, if the
+// worker falls behind frames are dropped instead. One window at a time, with
+// several stations only station 1 is captured.
+
+const int capture_fps = 30;
+const int capture_history_seconds = 30;
+// the window is drawn at 2x the original arcade resolution
+const int capture_scale = 2;
+
+// while drawing, with the window's GL context active. Also dumps the history
+// on a crash: an uncaught exception, a fatal signal or, on Windows, an
+// unhandled SEH exception. Best effort, a crash in the driver or the
+// encoder itself, or a kill, leaves nothing.
+void InitFrameCapture(const sf::RenderWindow& window);
+// starts over at the new size when the window was resized
+void CaptureFrame(const sf::RenderWindow& window);
+void ShutdownFrameCapture();
+
+// any thread
+void RequestCaptureDump();
+void ToggleCaptureRecording();
+
+#endif // !FRAMECAPTURE_H
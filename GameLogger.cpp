@@ -1,8 +1,8 @@
 #include "GameLogger.h"
-#include <iostream>
+#include "Log.h"
 
 // Global instance
-GameLogger gGameLogger;
+thread_local StationPtr<GameLogger> gGameLogger;
 
 GameLogger::GameLogger() :
     isExplanationActive(false),
@@ -22,11 +22,11 @@ bool GameLogger::initialize(const std::string& filename) {
     logFile.open(fileName, std::ios::app);
 
     if (!logFile.is_open()) {
-        std::cerr << "Failed to open log file: " << fileName << std::endl;
+        LOG_ERROR("Failed to open log file: {}", fileName);
         return false;
     }
 
-    std::cout << "Game logger initialized with file: " << fileName << std::endl;
+    LOG_INFO("Game logger initialized with file: {}", fileName);
     return true;
 }
 
@@ -43,7 +43,7 @@ void GameLogger::logGameStart() {
     roundNumber = 1;
 
     logFile.flush(); // Ensure it's written to disk
-    std::cout << "Logged game start time" << std::endl;
+    LOG_DEBUG("Logged game start time");
 }
 
 void GameLogger::logTriviaAnswer(const std::string& question, int selectedAnswer, bool wasCorrect) {
@@ -55,7 +55,7 @@ void GameLogger::logTriviaAnswer(const std::string& question, int selectedAnswer
     logFile << std::endl;
 
     logFile.flush();
-    std::cout << "Logged trivia answer" << std::endl;
+    LOG_DEBUG("Logged trivia answer");
 }
 
 void GameLogger::logNewRound() {
@@ -65,13 +65,13 @@ void GameLogger::logNewRound() {
 
     logFile << "\nROUND " << roundNumber << " START" << std::endl;
     logFile.flush();
-    std::cout << "Logged new round" << std::endl;
+    LOG_DEBUG("Logged new round");
 }
 
 void GameLogger::startExplanationTimer() {
     explanationStartTime = std::chrono::system_clock::now();
     isExplanationActive = true;
-    std::cout << "Started explanation timer" << std::endl;
+    LOG_DEBUG("Started explanation timer");
 }
 
 void GameLogger::endExplanationTimer() {
@@ -85,7 +85,7 @@ void GameLogger::endExplanationTimer() {
 
     logFile.flush();
     isExplanationActive = false;
-    std::cout << "Logged explanation time: " << durationToString(duration) << std::endl;
+    LOG_DEBUG("Logged explanation time: {}", durationToString(duration));
 }
 
 void GameLogger::logGameScore(int score) {
@@ -95,7 +95,7 @@ void GameLogger::logGameScore(int score) {
 
     logFile << "Final Game Score: " << score << " points" << std::endl;
     logFile.flush();
-    std::cout << "Logged game score: " << score << std::endl;
+    LOG_DEBUG("Logged game score: {}", score);
 }
 
 void GameLogger::logGameOver() {
@@ -111,7 +111,7 @@ void GameLogger::logGameOver() {
     addSessionSeparator();
 
     logFile.flush();
-    std::cout << "Logged game over time" << std::endl;
+    LOG_DEBUG("Logged game over time");
 }
 
 std::string GameLogger::getCurrentTimestamp() {
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include "StationPtr.h"
 
 class GameLogger {
 private:
@@ -53,5 +54,5 @@ public:
     void addSessionSeparator();
 };
 
-// Global instance
-extern GameLogger gGameLogger;
\ No newline at end of file
+// The current station's, see Station.h
+extern thread_local StationPtr<GameLogger> gGameLogger;
\ No newline at end of file
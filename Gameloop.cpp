@@ -1,139 +1,103 @@
 #include "Gameloop.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <cmath>
-#include <iostream>
+#include "AssetBundle.h"
 #include "SerialController.h"
-#include <chrono>
-#include <thread>
 #include "GameLogger.h"
+#include "Log.h"
+#include "Clock.h"
+#include "InputLatency.h"
+#include "InputSnapshot.h"
+#include "Station.h"
 
-GameState gState;
+thread_local StationPtr<GameState> gState;
 
-SerialController gSerialController;
-
-bool DebugArduinoCommunication(const char* portName, int durationSeconds) {
-	std::cout << "\n=== ARDUINO DEBUG MODE ACTIVATED ===\n";
-	std::cout << "Listening to Arduino on " << portName << " for " << durationSeconds << " seconds\n";
-	std::cout << "Move joystick and press button to see raw output\n";
-
-	// Open serial connection
-	std::string fullPortName = std::string("\\\\.\\") + portName;
-	HANDLE hSerial = CreateFileA(fullPortName.c_str(),
-		GENERIC_READ | GENERIC_WRITE,
-		0,
-		NULL,
-		OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL,
-		NULL);
-
-	if (hSerial == INVALID_HANDLE_VALUE) {
-		std::cerr << "Failed to open port for debugging\n";
-		return false;
-	}
-
-	// Set up port parameters
-	DCB dcbSerialParams = { 0 };
-	dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
-	GetCommState(hSerial, &dcbSerialParams);
-	dcbSerialParams.BaudRate = CBR_9600;
-	dcbSerialParams.ByteSize = 8;
-	dcbSerialParams.StopBits = ONESTOPBIT;
-	dcbSerialParams.Parity = NOPARITY;
-	SetCommState(hSerial, &dcbSerialParams);
-
-	// Set timeouts
-	COMMTIMEOUTS timeouts = { 0 };
-	timeouts.ReadIntervalTimeout = MAXDWORD;
-	timeouts.ReadTotalTimeoutMultiplier = 0;
-	timeouts.ReadTotalTimeoutConstant = 0;
-	SetCommTimeouts(hSerial, &timeouts);
-
-	// Clear buffer
-	PurgeComm(hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
-
-	// Listen for data
-	auto startTime = std::chrono::steady_clock::now();
-	auto endTime = startTime + std::chrono::seconds(durationSeconds);
-
-	while (std::chrono::steady_clock::now() < endTime) {
-		char buffer[256] = { 0 };
-		DWORD bytesRead = 0;
-
-		if (ReadFile(hSerial, buffer, sizeof(buffer) - 1, &bytesRead, NULL) && bytesRead > 0) {
-			buffer[bytesRead] = '\0';
-			std::string input(buffer);
-
-			if (!input.empty()) {
-				std::cout << "RAW DATA: [" << input << "]\n";
-
-				// Print each character code for detailed debugging
-				std::cout << "CHAR CODES: ";
-				for (size_t i = 0; i < input.length(); i++) {
-					std::cout << static_cast<int>(input[i]) << " ";
-				}
-				std::cout << std::endl;
-			}
-		}
-
-		// Brief pause to avoid CPU spinning
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
-	}
-
-	CloseHandle(hSerial);
-	std::cout << "=== DEBUG MODE COMPLETED ===\n";
-	return true;
-}
+thread_local StationPtr<SerialController> gSerialController;
 
 bool InitializeSerialController() {
-	// Debug mode flag - set to true to activate debug mode
-	bool debugMode = false;
-
-	if (debugMode) {
-		// Listen for 30 seconds in debug mode
-		DebugArduinoCommunication("COM3", 30);
+	// The station's port, found by SerialSupervisor unless BUZZY_SERIAL_PORT or
+	// --station names one. Raw traffic is recorded with BUZZY_SERIAL_CAPTURE,
+	// see tools/SerialReplay.cpp.
+	const std::string& port = gStation->port;
+	if (port == "none") {
+		LOG_INFO("No Arduino for this station. Using keyboard.");
+		return false;
 	}
-
-	// Try to connect to Arduino
-	const char* portName = "COM3";
-	if (gSerialController.initialize(portName)) {
-		std::cout << "Arduino controller connected successfully!" << std::endl;
+	if (gSerialController->initialize(port.c_str())) {
+		LOG_INFO("Arduino controller connected successfully!");
 		return true;
 	}
 
-	std::cout << "Failed to connect to Arduino controller. Using keyboard fallback." << std::endl;
+	if (gSerialController->isConnected())
+		LOG_INFO("Arduino not there yet. Using keyboard until it is.");
+	else
+		LOG_INFO("Failed to connect to Arduino controller. Using keyboard fallback.");
 	return false;
 }
 
-void OnStart()
+static void InitFiles()
 {
-	// Initialize existing game components
-	Init();
 	LoadHighScore();
 
 	// Initialize the game logger
-	gGameLogger.initialize("game_log.txt");
+	gGameLogger->initialize(gStation->log_file);
+}
 
-	// Initialize serial controller for Arduino inputs
+static void StartSerial()
+{
+	// Initialize serial controller for Arduino inputs, it logs how that went
 	if (InitializeSerialController()) {
-		std::cout << "Arduino controller connected successfully!" << std::endl;
-
 		// Reset the Arduino to ensure it's in the correct initial state
-		gSerialController.resetGame();
-	}
-	else {
-		std::cout << "Failed to connect to Arduino controller. Using keyboard fallback." << std::endl;
+		gSerialController->resetGame();
 	}
 }
 
-void OnQuit()
+static void InitTrivia()
 {
+	gTriviaManager->Load();
+	InitTriviaLayouts();
+}
+
+// Each step binds the station on whichever of the plan's threads runs it.
+// The steps only share the station where they touch different parts of it,
+// or where one waits for the other: Init plays the instruction screens'
+// ambient, so game waits for sounds to be set up. The log thread is main's.
+StationStartup OnStart(Station& station, StartupPlan& plan, const TextureSteps& textures)
+{
+	std::string name = "station " + std::to_string(station.index + 1) + " ";
+	auto bound = [&station](void (*step)()) {
+		return [&station, step] {
+			StationBinding binding(station);
+			step();
+		};
+	};
+
+	int sounds = plan.add(name + "sounds", [&station] { InitSounds(station); });
+	int game = plan.add(name + "game", bound(Init), { sounds });
+	int files = plan.add(name + "files", bound(InitFiles));
+	int screen = plan.add(name + "first screen", bound(InitFirstScreen), { textures.first_screen });
+	int render = plan.add(name + "render", bound(InitRender), { game, textures.all });
+	int trivia = plan.add(name + "trivia", bound(InitTrivia));
+	int serial = plan.add(name + "serial", bound(StartSerial));
+
+	StationStartup startup;
+	startup.first_screen = plan.add(name + "first frame", [] {}, { game, files, screen });
+	startup.ready = plan.add(name + "ready", [] {}, { startup.first_screen, render, trivia, serial });
+	return startup;
+}
+
+void OnQuit(Station& station)
+{
+	StationBinding bound(station);
 	SaveHighScore();
+	QuitSounds(station);
 
 	// Disconnect from Arduino if connected
-	if (gSerialController.isConnected()) {
-		gSerialController.disconnect();
+	if (gSerialController->isConnected()) {
+		gSerialController->disconnect();
 	}
 }
 
@@ -143,35 +107,47 @@ void LoadHighScore()
 	std::stringstream ss;
 	std::string line;
 	int hs = 0;
-	infile.open("highscore.txt");
+	infile.open(gStation->highscore_file);
 	if (!infile) {
-		gState.high_score = 0;
+		gState->high_score = 0;
 		return;
 	}
 	getline(infile, line);
 	ss << line;
 	ss >> hs;
 
-	gState.high_score = hs;
+	gState->high_score = hs;
 }
 void SaveHighScore()
 {
-	std::ofstream outfile("highscore.txt");
+	std::ofstream outfile(gStation->highscore_file);
 	if (!outfile.is_open())
-		printf("Cant open file!");
+		LOG_ERROR("Cant open file!");
 
-	outfile << gState.high_score;
+	outfile << gState->high_score;
 	outfile.close();
 }
 void InitBoard()
 {
+	const AssetEntry* maze = Assets().find(ASSET_TEXT, "maze");
+	if (maze) {
+		const char* text = (const char*)Assets().data(*maze);
+		const char* end = text + maze->size;
+		while (text < end) {
+			const char* line_end = std::find(text, end, '\n');
+			gState->board.emplace_back(text, line_end);
+			text = line_end + 1;
+		}
+		return;
+	}
+
 	std::string line;
-	std::ifstream infile("Map.txt");
+	std::ifstream infile(AssetPath("Map.txt"));
 	if (!infile)
 		return;
 	while (getline(infile, line))
 	{
-		gState.board.push_back(line);
+		gState->board.push_back(line);
 	}
 
 	infile.close();
@@ -183,182 +159,144 @@ void Init()
 	pl->cur_dir = UP;
 	pl->pos = { 14,23.5 };
 	pl->stopped = true;
-	gState.player = pl;
+	gState->player = pl;
 
 	// Ghosts init
 	Ghost* temp = new Ghost();
 	temp->type = RED;
-	gState.ghosts.push_back(temp);
+	gState->ghosts.push_back(temp);
 
 	temp = new Ghost();
 	temp->type = PINK;
-	gState.ghosts.push_back(temp);
+	gState->ghosts.push_back(temp);
 
 	temp = new Ghost();
 	temp->type = BLUE;
-	gState.ghosts.push_back(temp);
+	gState->ghosts.push_back(temp);
 
 	temp = new Ghost();
 	temp->type = ORANGE;
-	gState.ghosts.push_back(temp);
+	gState->ghosts.push_back(temp);
 
 	InitBoard();
-	InitRender();
 	ResetGhostsAndPlayer();
 
-	InitSounds();
-
 	// Initialize trivia-related variables
-	gState.selected_trivia_answer = 0;
-	gState.last_answer_was_correct = false;
-	gState.current_explanation = "";
+	gState->selected_trivia_answer = 0;
+	gState->last_answer_was_correct = false;
+	gState->current_explanation = -1;
 
 	SetupMenu();
-	gState.game_state = MENU;
-	gState.pause_time = 2000;
+	gState->game_state = MENU;
+	gState->pause_time = 2000;
 
-	gState.button_released = true;
-	gState.lastButtonPressTime = 0;
-	gState.lastButtonMessage = "";
-	gState.buttonProcessed = false;
-	gState.canAdvanceScreen = false;
-	gState.screenChangeTime = 0;
+	gState->button_released = true;
+	gState->lastButtonPressTime = 0;
+	gState->lastButtonMessage = "";
+	gState->buttonProcessed = false;
+	gState->canAdvanceScreen = false;
+	gState->screenChangeTime = 0;
 
 	SetupMenu(); // Will now redirect to instruction screens
-	gState.game_state = INSTR_SCREEN1;
-	gState.pause_time = 2000;
+	gState->game_state = INSTR_SCREEN1;
+	gState->pause_time = 2000;
 
-	gState.can_interact_with_flower = true;
-	gState.flower_interaction_cooldown = 0.0f;
+	gState->can_interact_with_flower = true;
+	gState->flower_interaction_cooldown = 0.0f;
 }
 
 void AnswerTriviaQuestion(int selected_index)
 {
-	bool correct = gTriviaManager.CheckAnswer(gState.current_trivia_question, selected_index);
-	gState.last_answer_was_correct = correct;
+	const TriviaQuestion& question = gState->current_trivia_question;
+	bool correct = gTriviaManager->CheckAnswer(question, selected_index);
+	gState->last_answer_was_correct = correct;
 
-	// Get the explanation based on the selected answer
-	gState.current_explanation = gTriviaManager.GetExplanation(gState.current_trivia_question, selected_index);
+	// The explanation for the selected answer, the render side looks it up
+	gState->current_explanation = selected_index;
 
 	// Log the trivia answer
-	gGameLogger.logTriviaAnswer(gState.current_trivia_question.question, selected_index, correct);
+	gGameLogger->logTriviaAnswer(question.IsValid() ? std::string(question.Text()) : std::string(), selected_index, correct);
 
 	// Start timing the explanation screen
-	gGameLogger.startExplanationTimer();
+	gGameLogger->startExplanationTimer();
 
 	if (correct) {
 		PlayCorrectAnswerSound();
 		// Add points and activate power-up only if answer is correct
-		gState.game_score += gState.current_trivia_question.points_reward;
-		gState.energizer_time = fright_time * 1000;
+		gState->game_score += question.Points();
+		gState->energizer_time = fright_time * 1000;
 		SetAllGhostState(FRIGHTENED);
-		gState.ghosts_eaten_in_powerup = 0; // Reset ghost eaten counter for new power session
+		gState->ghosts_eaten_in_powerup = 0; // Reset ghost eaten counter for new power session
 
 		// Increment flowers collected only when correct (cycle between 1-4)
-		gState.flowersCollected = (gState.flowersCollected % 4) + 1;
+		gState->flowersCollected = (gState->flowersCollected % 4) + 1;
 
-		// Update LED strip on Arduino to show flower was collected
-		if (gSerialController.isConnected()) {
-			std::cout << "Setting flower collected: " << gState.flowersCollected << std::endl;
-			gSerialController.setFlowerCollected(gState.flowersCollected);
-		}
+		// Light it on the Arduino's strip, GameLoop sends it
+		gState->flower_leds |= FlowerLed(gState->flowersCollected);
 
 		// Go to correct explanation screen
-		gState.game_state = TRIVIA_CORRECT_EXPLANATION;
+		gState->game_state = TRIVIA_CORRECT_EXPLANATION;
 	}
 	else {
 		PlayWrongAnswerSound();
 		// Go to incorrect explanation screen
-		gState.game_state = TRIVIA_INCORRECT_EXPLANATION;
+		gState->game_state = TRIVIA_INCORRECT_EXPLANATION;
 	}
 
 	// Switch back to steering mode when leaving trivia mode
-	if (gSerialController.isConnected()) {
-		gSerialController.setSteeringMode();
+	if (gSerialController->isConnected()) {
+		gSerialController->setSteeringMode();
 	}
 }
 
 void HandleTriviaMode(int ms_elapsed)
 {
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
-
-	// Get current keyboard state
-	bool upKeyPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Up);
-	bool downKeyPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Down);
-	bool enterKeyPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter);
-
-	// Static variables to track previous key states
-	static bool upKeyWasPressed = false;
-	static bool downKeyWasPressed = false;
-	static bool enterKeyWasPressed = false;
-
-	// Store the selection value at beginning of frame
-	int startingSelection = gState.selected_trivia_answer;
-
 	// Flag to track if selection was changed this frame
 	bool selectionChanged = false;
 
+	// A question has 2 to 4 answers, only those shown can be picked
+	const TriviaQuestion& question = gState->current_trivia_question;
+	int answers = question.IsValid() ? question.AnswerCount() : trivia_max_answers;
+
 	// Simple debug output
-	std::cout << "Trivia Mode - current selection: " << gState.selected_trivia_answer << std::endl;
-
-	// Look for "Selected:" in the last message from Arduino
-	if (gSerialController.isConnected()) {
-		std::string lastMsg = gSerialController.getLastMessage();
-		size_t selectedPos = lastMsg.find("Selected: ");
-		if (selectedPos != std::string::npos && selectedPos + 10 < lastMsg.length()) {
-			char answerChar = lastMsg[selectedPos + 10];
-			if (answerChar >= '1' && answerChar <= '4') {
-				int newSelection = answerChar - '0' - 1; // Convert to 0-3 range
-				if (newSelection != gState.selected_trivia_answer) {
-					gState.selected_trivia_answer = newSelection;
-					std::cout << "Arduino selection changed to: " << gState.selected_trivia_answer << std::endl;
-					selectionChanged = true;
-				}
-			}
+	LOG_DEBUG("Trivia Mode - current selection: {}", gState->selected_trivia_answer);
+
+	// Arduino reported a new selection this tick
+	if (gInput->selection_changed) {
+		// The sketch always counts to 4, past the last answer stays on it
+		int newSelection = std::min(std::max(gInput->selected_answer - 1, 0), answers - 1);
+		if (newSelection != gState->selected_trivia_answer) {
+			gState->selected_trivia_answer = newSelection;
+			LOG_DEBUG("Arduino selection changed to: {}", gState->selected_trivia_answer);
+			selectionChanged = true;
 		}
 	}
 
 	// Handle keyboard Up input (only if not already changed by Arduino)
-	if (!selectionChanged && upKeyPressed && !upKeyWasPressed) {
-		gState.selected_trivia_answer = (gState.selected_trivia_answer > 0) ?
-			gState.selected_trivia_answer - 1 : 3;
+	if (!selectionChanged && gInput->key_up_pressed) {
+		gState->selected_trivia_answer = (gState->selected_trivia_answer > 0) ?
+			gState->selected_trivia_answer - 1 : answers - 1;
 		selectionChanged = true;
 	}
 
 	// Handle keyboard Down input (only if not already changed by Arduino)
-	if (!selectionChanged && downKeyPressed && !downKeyWasPressed) {
-		gState.selected_trivia_answer = (gState.selected_trivia_answer < 3) ?
-			gState.selected_trivia_answer + 1 : 0;
+	if (!selectionChanged && gInput->key_down_pressed) {
+		gState->selected_trivia_answer = (gState->selected_trivia_answer < answers - 1) ?
+			gState->selected_trivia_answer + 1 : 0;
 		selectionChanged = true;
 	}
 
-	gSerialController.update();
-
 	// Handle button press for submitting answer - use either keyboard or Arduino
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed();
-
-	if (buttonPressed) {
-		std::cout << "Button press detected - submitting answer " << gState.selected_trivia_answer << std::endl;
-		AnswerTriviaQuestion(gState.selected_trivia_answer);
-	}
-
-	// Force a redraw if selection changed
-	if (selectionChanged) {
-		DrawFrame();
+	if (gInput->button_pressed) {
+		LOG_INFO("Button press detected - submitting answer {}", gState->selected_trivia_answer);
+		AnswerTriviaQuestion(gState->selected_trivia_answer);
 	}
-
-	// Update previous key states for next frame - combine keyboard and Arduino inputs
-	upKeyWasPressed = upKeyPressed;
-	downKeyWasPressed = downKeyPressed;
-	enterKeyWasPressed = buttonPressed;
 }
 
 
 void ResetGhostsAndPlayer()
 {
-	Ghost* temp = gState.ghosts[0];
+	Ghost* temp = gState->ghosts[0];
 	temp->pos = { 14, 11.5 };
 	temp->cur_dir = LEFT;
 	temp->target_state = CORNER;
@@ -367,7 +305,7 @@ void ResetGhostsAndPlayer()
 	//temp->dot_counter = 0;
 	temp->enable_draw = true;
 
-	temp = gState.ghosts[1];
+	temp = gState->ghosts[1];
 	temp->pos = { 14, 14.5 };
 	temp->cur_dir = UP;
 	temp->target_state = HOMEBASE;
@@ -376,7 +314,7 @@ void ResetGhostsAndPlayer()
 	//temp->dot_counter = 0;
 	temp->enable_draw = true;
 
-	temp = gState.ghosts[2];
+	temp = gState->ghosts[2];
 	temp->pos = { 12, 14.5 };
 	temp->cur_dir = DOWN;
 	temp->target_state = HOMEBASE;
@@ -385,7 +323,7 @@ void ResetGhostsAndPlayer()
 	//temp->dot_counter = 0;
 	temp->enable_draw = true;
 
-	temp = gState.ghosts[3];
+	temp = gState->ghosts[3];
 	temp->pos = { 16, 14.5 };
 	temp->cur_dir = DOWN;
 	temp->target_state = HOMEBASE;
@@ -394,103 +332,98 @@ void ResetGhostsAndPlayer()
 	//temp->dot_counter = 0;
 	temp->enable_draw = true;
 
-	gState.player->cur_dir = UP;
-	gState.player->pos = { 14,23.5 };
-	gState.player->stopped = true;
-	gState.player->enable_draw = true;
+	gState->player->cur_dir = UP;
+	gState->player->pos = { 14,23.5 };
+	gState->player->stopped = true;
+	gState->player->try_dir = NONE;
+	gState->player->enable_draw = true;
 
 	ResetAnimation();
-	gState.energizer_time = 0;
-	gState.wave_counter = 0;
-	gState.wave_time = 0;
-
-	ResetPPelletFlash();
+	gState->energizer_time = 0;
+	gState->wave_counter = 0;
+	gState->wave_time = 0;
 
-	if (!gState.first_life)
-		gState.using_global_counter = true;
+	if (!gState->first_life)
+		gState->using_global_counter = true;
 
-	gState.global_dot_counter = 0;
+	gState->global_dot_counter = 0;
 }
 void ResetBoard()
 {
-	gState.board.clear();
+	gState->board.clear();
 	InitBoard();
 
-	gState.pellets_left = 244;
-	gState.flowersCollected = 0; // Reset flower collection count
+	gState->pellets_left = 244;
+	gState->flowersCollected = 0; // Reset flower collection count
 
-	gState.first_life = true;
-	gState.using_global_counter = false;
+	gState->first_life = true;
+	gState->using_global_counter = false;
 	for (int i = 0; i < 4; i++)
-		gState.ghosts[i]->dot_counter = 0;
+		gState->ghosts[i]->dot_counter = 0;
 
 	// Reset all LEDs
-	if (gSerialController.isConnected()) {
-		gSerialController.resetLEDs();
-	}
+	gState->flower_leds = 0;
 }
 
 void IncrementGhostHouse()
 {
 	Ghost* first_ghost = nullptr;
 	// using global counter, increment it
-	if (gState.using_global_counter) {
-		gState.global_dot_counter++;
+	if (gState->using_global_counter) {
+		gState->global_dot_counter++;
 	}
 	for (int i = 0; i < 4; i++) {
-		if (gState.ghosts[i]->target_state == HOMEBASE) {
-			first_ghost = gState.ghosts[i];
+		if (gState->ghosts[i]->target_state == HOMEBASE) {
+			first_ghost = gState->ghosts[i];
 			break;
 		}
 	}
 	if (first_ghost == nullptr) {
 		// no more ghosts in house, switch back to local counters
-		if (gState.using_global_counter) {
-			gState.using_global_counter = false;
+		if (gState->using_global_counter) {
+			gState->using_global_counter = false;
 		}
 	}
 	// if not using global and ghost is in house, use local counter
-	else if (!gState.using_global_counter) {
+	else if (!gState->using_global_counter) {
 		first_ghost->dot_counter++;
 	}
 }
 void CheckPelletCollision()
 {
 	// Skip collision check during cooldown
-	if (!gState.can_interact_with_flower) {
+	if (!gState->can_interact_with_flower) {
 		return;
 	}
 
-	char tile = GetTile(gState.player->pos.x, gState.player->pos.y);
+	char tile = GetTile(gState->player->pos.x, gState->player->pos.y);
 	bool collided = false;
 
 	if (tile == '.') {
 		collided = true;
-		gState.game_score += 10;
+		gState->game_score += 10;
 		PlayMunch();
 
-		RemovePellet(gState.player->pos.x, gState.player->pos.y);
-		SetTile(gState.player->pos.x, gState.player->pos.y, ' ');
+		SetTile(gState->player->pos.x, gState->player->pos.y, ' ');
 		IncrementGhostHouse();
-		gState.pellet_eaten = true;
-		gState.pellets_left--;
+		gState->pellet_eaten = true;
+		gState->pellets_left--;
 	}
 	else if (tile == 'o') {
 		// This is a flower (power pellet)
 		collided = true;
 
 		// Switch to answering mode when entering trivia mode
-		if (gSerialController.isConnected()) {
-			gSerialController.setAnsweringMode();
+		if (gSerialController->isConnected()) {
+			gSerialController->setAnsweringMode();
 		}
 
 		// Get a new random question
-		TriviaQuestion currentQuestion = gTriviaManager.GetRandomQuestion();
-		gState.current_trivia_question = currentQuestion;
-		gState.game_state = TRIVIA_MODE;
-		gState.selected_trivia_answer = 0; // Reset selected answer
+		gState->current_trivia_question = gTriviaManager->GetRandomQuestion();
+		gState->game_state = TRIVIA_MODE;
+		gState->selected_trivia_answer = 0; // Reset selected answer
 
-		gState.energizer_time = 0; // Pause energizer until question is answered
+		gState->energizer_time = 0; // Pause energizer until question is answered
 
 		// Don't remove the flower yet - we'll only remove it if answered correctly
 		return;
@@ -498,34 +431,34 @@ void CheckPelletCollision()
 }
 void CheckGhostCollision()
 {
-	int px = (int)gState.player->pos.x;
-	int py = (int)gState.player->pos.y;
+	int px = (int)gState->player->pos.x;
+	int py = (int)gState->player->pos.y;
 
 	for (int i = 0; i < 4; i++) {
-		if ((int)gState.ghosts[i]->pos.x == px && (int)gState.ghosts[i]->pos.y == py) {
-			if (gState.ghosts[i]->target_state == FRIGHTENED) {
-				SetGhostState(*gState.ghosts[i], GOHOME);
-				gState.recent_eaten = gState.ghosts[i];
-				gState.ghosts_eaten_in_powerup++;
-				gState.game_score += (pow(2, gState.ghosts_eaten_in_powerup) * 100);
+		if ((int)gState->ghosts[i]->pos.x == px && (int)gState->ghosts[i]->pos.y == py) {
+			if (gState->ghosts[i]->target_state == FRIGHTENED) {
+				SetGhostState(*gState->ghosts[i], GOHOME);
+				gState->recent_eaten = gState->ghosts[i];
+				gState->ghosts_eaten_in_powerup++;
+				gState->game_score += (pow(2, gState->ghosts_eaten_in_powerup) * 100);
 
-				gState.player_eat_ghost = true;
-				gState.pause_time = 500;
+				gState->player_eat_ghost = true;
+				gState->pause_time = 500;
 
-				gState.ghosts[i]->enable_draw = false;
-				gState.player->enable_draw = false;
+				gState->ghosts[i]->enable_draw = false;
+				gState->player->enable_draw = false;
 
 				PlayEatGhost();
 			}
-			else if (gState.ghosts[i]->target_state != GOHOME) {
-				gState.game_state = GAMELOSE;
-				gState.pause_time = 2000;
-				gState.player_lives -= 1;
-				gState.first_life = false;
+			else if (gState->ghosts[i]->target_state != GOHOME) {
+				gState->game_state = GAMELOSE;
+				gState->pause_time = 2000;
+				gState->player_lives -= 1;
+				gState->first_life = false;
 				StartPacManDeath();
 				StopSounds();
 				PlayDeathSound();
-				printf("RESET\n");
+				LOG_INFO("RESET");
 			}
 		}
 	}
@@ -533,44 +466,44 @@ void CheckGhostCollision()
 void UpdateWave(int ms_elapsed)
 {
 	// indefinte chase mode
-	if (gState.wave_counter >= 7)
+	if (gState->wave_counter >= 7)
 		return;
 
-	gState.wave_time += ms_elapsed;
-	if (gState.wave_time / 1000 >= wave_times[gState.wave_counter]) {
-		gState.wave_counter++;
-		printf("New wave\n");
-		if (gState.energizer_time <= 0)
+	gState->wave_time += ms_elapsed;
+	if (gState->wave_time / 1000 >= wave_times[gState->wave_counter]) {
+		gState->wave_counter++;
+		LOG_DEBUG("New wave");
+		if (gState->energizer_time <= 0)
 			SetAllGhostState(GetGlobalTarget());
-		gState.wave_time = 0;
+		gState->wave_time = 0;
 	}
 
 }
 void UpdateEnergizerTime(int ms_elasped)
 {
-	if (gState.energizer_time <= 0)
+	if (gState->energizer_time <= 0)
 		return;
 
-	gState.energizer_time -= ms_elasped;
-	if (gState.energizer_time <= 0) {
+	gState->energizer_time -= ms_elasped;
+	if (gState->energizer_time <= 0) {
 		SetAllGhostState(GetGlobalTarget());
-		gState.ghosts_eaten_in_powerup = 0; // Reset the counter when power mode ends
+		gState->ghosts_eaten_in_powerup = 0; // Reset the counter when power mode ends
 	}
 }
 void CheckHighScore()
 {
-	if (gState.game_score > gState.high_score)
-		gState.high_score = gState.game_score;
+	if (gState->game_score > gState->high_score)
+		gState->high_score = gState->game_score;
 }
 void CheckWin()
 {
-	if (gState.pellets_left <= 0) {
-		gState.game_state = GAMEWIN;
+	if (gState->pellets_left <= 0) {
+		gState->game_state = GAMEWIN;
 		for (int i = 0; i < 4; i++) {
-			gState.ghosts[i]->enable_draw = false;
+			gState->ghosts[i]->enable_draw = false;
 		}
-		gState.player->stopped = true;
-		gState.pause_time = 2000;
+		gState->player->stopped = true;
+		gState->pause_time = 2000;
 		StopSounds();
 		SetPulseFrequency(200);
 	}
@@ -580,23 +513,25 @@ void MainLoop(int ms_elapsed)
 {
 	UpdateFlowerInteractionCooldown(ms_elapsed);
 
-	if (gState.player_eat_ghost) {
-		gState.pause_time -= ms_elapsed;
-		if (gState.pause_time < 0) {
-			gState.recent_eaten->enable_draw = true;
-			gState.player->enable_draw = true;
-			gState.player_eat_ghost = false;
+	if (gState->player_eat_ghost) {
+		gState->pause_time -= ms_elapsed;
+		if (gState->pause_time < 0) {
+			gState->recent_eaten->enable_draw = true;
+			gState->player->enable_draw = true;
+			gState->player_eat_ghost = false;
 		}
-		DrawFrame();
 
 		return;
 	}
 
+	// a turn asked for on a skipped frame still counts
+	BufferTurn(ms_elapsed);
+
 	// pacman doesnt move for one frame if he eats a pellet
 	// from the original game
-	if (!gState.pellet_eaten)
+	if (!gState->pellet_eaten)
 		PlayerMovement();
-	else gState.pellet_eaten = false;
+	else gState->pellet_eaten = false;
 	// check collision first so less funny stuff
 	CheckGhostCollision();
 	CheckPelletCollision();
@@ -608,77 +543,71 @@ void MainLoop(int ms_elapsed)
 	UpdateGameSounds(ms_elapsed);
 
 	AnimateUpdate(ms_elapsed);
-	DrawFrame();
 }
 void GameStart(int ms_elasped)
 {
-	gState.pause_time -= ms_elasped;
-	if (gState.pause_time <= 0) {
-		gState.game_state = MAINLOOP;
+	gState->pause_time -= ms_elasped;
+	if (gState->pause_time <= 0) {
+		gState->game_state = MAINLOOP;
 		SetPulseFrequency(150);
 
 		// Log the game start
-		gGameLogger.logGameStart();
+		gGameLogger->logGameStart();
 	}
-
-	DrawFrame();
 }
 void GameLose(int ms_elapsed)
 {
-	gState.pause_time -= ms_elapsed;
-	if (gState.pause_time <= 0) {
-		if (gState.player_lives == 0) {
-			gState.game_state = GAMEOVER;
-			gState.pause_time = 5000;
+	gState->pause_time -= ms_elapsed;
+	if (gState->pause_time <= 0) {
+		if (gState->player_lives == 0) {
+			gState->game_state = GAMEOVER;
+			gState->pause_time = 5000;
 			for (int i = 0; i < 4; i++)
-				gState.ghosts[i]->enable_draw = false;
-			gState.player->enable_draw = false;
+				gState->ghosts[i]->enable_draw = false;
+			gState->player->enable_draw = false;
 
 			// Log the final score and game over time
-			gGameLogger.logGameScore(gState.game_score);
-			gGameLogger.logGameOver();
+			gGameLogger->logGameScore(gState->game_score);
+			gGameLogger->logGameOver();
 		}
 		else {
-			gState.game_state = GAMESTART;
-			gState.pause_time = 2000;
+			gState->game_state = GAMESTART;
+			gState->pause_time = 2000;
 
 			ResetGhostsAndPlayer();
 		}
 	}
 	UpdateGameSounds(ms_elapsed);
 	AnimateUpdate(ms_elapsed);
-	DrawFrame();
 }
 void GameWin(int ms_elapsed)
 {
-	gState.pause_time -= ms_elapsed;
-	if (gState.pause_time <= 0) {
+	gState->pause_time -= ms_elapsed;
+	if (gState->pause_time <= 0) {
 		// Log the final score and game over time before resetting
-		gGameLogger.logGameScore(gState.game_score);
-		gGameLogger.logNewRound();
+		gGameLogger->logGameScore(gState->game_score);
+		gGameLogger->logNewRound();
 
-		ResetPellets();
 		ResetBoard();
 		ResetGhostsAndPlayer();
-		gState.pause_time = 2000;
-		gState.game_state = GAMESTART;
+		gState->pause_time = 2000;
+		gState->game_state = GAMESTART;
 	}
 	AnimateUpdate(ms_elapsed);
-	DrawFrame();
 }
 void SetupMenu()
 {
     // Original menu setup
     for (int i = 0; i < 4; i++) {
-        gState.ghosts[i]->enable_draw = true;
-        gState.ghosts[i]->pos = { 6, 5.5f + i * 3.f };
-        gState.ghosts[i]->cur_dir = RIGHT;
-        gState.ghosts[i]->target_state = CHASE;
-        gState.ghosts[i]->in_house = false;
+        gState->ghosts[i]->enable_draw = true;
+        gState->ghosts[i]->pos = { 6, 5.5f + i * 3.f };
+        gState->ghosts[i]->cur_dir = RIGHT;
+        gState->ghosts[i]->target_state = CHASE;
+        gState->ghosts[i]->in_house = false;
     }
-    gState.player->enable_draw = true;
-    gState.player->pos = { 6, 17.5f };
-    gState.player->cur_dir = RIGHT;
+    gState->player->enable_draw = true;
+    gState->player->pos = { 6, 17.5f };
+    gState->player->cur_dir = RIGHT;
     SetPacManMenuFrame();
     SetPulseFrequency(200);
     
@@ -687,58 +616,54 @@ void SetupMenu()
 }
 void Menu(int ms_elapsed)
 {
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
-
 	PulseUpdate(ms_elapsed);
 
 	// Check for Enter key or Arduino button press to start the game
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) || gSerialController.isGameStartPressed())
+	if (gInput->button_pressed)
 	{
-		ResetPellets();
 		ResetBoard();
 		ResetGhostsAndPlayer();
-		gState.game_score = 0;
-		gState.player_lives = 3;
+		gState->game_score = 0;
+		gState->player_lives = 3;
 		PlayGameStart();
-		gState.pause_time = 4000;
-		gState.game_state = GAMESTART;
+		gState->pause_time = 4000;
+		gState->game_state = GAMESTART;
 	}
 }
-void GameLoop(int ms_elapsed)
+void GameLoop(Station& station, int ms_elapsed)
 {
+	StationBinding bound(station);
+	// SampleInput ran right before this, the handlers below only look at gInput
+	CheckSoundsLoaded();
+
 	// Check for reset request from controller first
-	gSerialController.update();
-	if (gSerialController.isResetRequested()) {
+	if (gInput->reset_requested) {
 		// Perform full game reset
-		std::cout << "Resetting game due to button hold request" << std::endl;
+		LOG_INFO("Resetting game due to button hold request");
 
 		// Reset game variables
-		gState.game_score = 0;
-		gState.player_lives = 3;
+		gState->game_score = 0;
+		gState->player_lives = 3;
 
 		// Reset board and game elements
-		ResetPellets();
 		ResetBoard();
 		ResetGhostsAndPlayer();
 
-		// Reset Arduino controller
-		if (gSerialController.isConnected()) {
-			gSerialController.resetLEDs();
-			gSerialController.resetGame();
+		// Reset Arduino controller, ResetBoard turned the LEDs off
+		if (gSerialController->isConnected()) {
+			gSerialController->resetGame();
 		}
+		gSerialController->setFlowerLeds(gState->flower_leds);
 
-		// Go back to instruction screens
+		// Go back to instruction screens. Arduino input is ignored until it
+		// acknowledges GAME:RESET, so the held button can't skip a screen.
 		SetupInstructionScreens();
-		gState.game_state = INSTR_SCREEN1;
-
-		// Add a small delay to prevent immediately processing another input
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		gState->game_state = INSTR_SCREEN1;
 
 		return; // Skip the rest of the game loop for this frame
 	}
 
-	switch (gState.game_state)
+	switch (gState->game_state)
 	{
 	case MAINLOOP:
 		MainLoop(ms_elapsed);
@@ -750,18 +675,17 @@ void GameLoop(int ms_elapsed)
 		GameLose(ms_elapsed);
 		break;
 	case GAMEOVER:
-		gState.pause_time -= ms_elapsed;
-		if (gState.pause_time < 0) {
+		gState->pause_time -= ms_elapsed;
+		if (gState->pause_time < 0) {
 			// Turn off all LEDs when game over
-			if (gSerialController.isConnected()) {
-				gSerialController.resetLEDs();
-				gSerialController.resetGame();
+			gState->flower_leds = 0;
+			if (gSerialController->isConnected()) {
+				gSerialController->resetGame();
 			}
 
 			SetupMenu();
-			gState.game_state = INSTR_SCREEN1;
+			gState->game_state = INSTR_SCREEN1;
 		}
-		DrawFrame();
 		break;
 	case GAMEWIN:
 		GameWin(ms_elapsed);
@@ -794,73 +718,44 @@ void GameLoop(int ms_elapsed)
 		HandleFinalInstructionScreen(ms_elapsed);
 		break;
 	}
+
+	// Whatever this tick did to the flowers goes out as one update, if any
+	gSerialController->setFlowerLeds(gState->flower_leds);
 }
 
 bool CheckButtonPress()
 {
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
-
-	bool keyboardEnter = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter);
-
-	// Get button press from serial controller
-	bool arduinoButton = false;
-
-	// Instead of using the built-in functions, check the raw serial data
-	static bool buttonReceived = false;
-
-	// If we've just received a "Button" message from the Arduino, set the flag
-	if (!buttonReceived && gSerialController.getLastMessage().find("Button") != std::string::npos) {
-		buttonReceived = true;
-		arduinoButton = true;
-		std::cout << "Raw button message detected in CheckButtonPress" << std::endl;
-	}
-	else if (gSerialController.isButtonPressed() || gSerialController.isGameStartPressed()) {
-		arduinoButton = true;
-	}
-
-	// Reset the flag if no button message in the last message
-	if (gSerialController.getLastMessage().find("Button") == std::string::npos) {
-		buttonReceived = false;
-	}
-
-	// Return true if either input is detected
-	return keyboardEnter || arduinoButton;
+	// Enter or the Arduino button, the serial reader already merges the lines
+	// the Arduino sends per press
+	return gInput->button_pressed;
 }
 
 void HandleInstructionScreen1(int ms_elapsed)
 {
 	// Get current time
-	unsigned long currentTime = GetTickCount();
-
-	// Draw the instruction screen
-	DrawInstructionScreen1();
+	uint64_t currentTime = MonotonicMs();
 
 	// Only allow screen advance after a delay from screen load
-	if (currentTime - gState.screenChangeTime > 100) {
-		gState.canAdvanceScreen = true;
+	if (currentTime - gState->screenChangeTime > 100) {
+		gState->canAdvanceScreen = true;
 	}
 
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
 
 	// Check for button or key press
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed() ||
-		gSerialController.isGameStartPressed();
+	bool buttonPressed = gInput->button_pressed;
 
 	// Only advance if we're allowed and a button is pressed
-	if (gState.canAdvanceScreen && buttonPressed) {
+	if (gState->canAdvanceScreen && buttonPressed) {
 		PlayButtonSound();
 
 		// Advance to next screen
-		gState.game_state = INSTR_SCREEN2;
+		gState->game_state = INSTR_SCREEN2;
 
 		// Reset states for next screen
-		gState.canAdvanceScreen = false;
-		gState.screenChangeTime = currentTime;
+		gState->canAdvanceScreen = false;
+		gState->screenChangeTime = currentTime;
 
-		std::cout << "Advanced to screen 2" << std::endl;
+		LOG_DEBUG("Advanced to screen 2");
 	}
 
 	// Update pulse effect
@@ -869,26 +764,20 @@ void HandleInstructionScreen1(int ms_elapsed)
 
 void HandleInstructionScreen2(int ms_elapsed)
 {
-	unsigned long currentTime = GetTickCount();
-
-	DrawInstructionScreen2();
+	uint64_t currentTime = MonotonicMs();
 
-	if (currentTime - gState.screenChangeTime > 100) {
-		gState.canAdvanceScreen = true;
+	if (currentTime - gState->screenChangeTime > 100) {
+		gState->canAdvanceScreen = true;
 	}
 
-	gSerialController.update();
-
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed() ||
-		gSerialController.isGameStartPressed();
+	bool buttonPressed = gInput->button_pressed;
 
-	if (gState.canAdvanceScreen && buttonPressed) {
+	if (gState->canAdvanceScreen && buttonPressed) {
 		PlayButtonSound();
-		gState.game_state = INSTR_SCREEN3;
-		gState.canAdvanceScreen = false;
-		gState.screenChangeTime = currentTime;
-		std::cout << "Advanced to screen 3" << std::endl;
+		gState->game_state = INSTR_SCREEN3;
+		gState->canAdvanceScreen = false;
+		gState->screenChangeTime = currentTime;
+		LOG_DEBUG("Advanced to screen 3");
 	}
 
 	PulseUpdate(ms_elapsed);
@@ -896,26 +785,20 @@ void HandleInstructionScreen2(int ms_elapsed)
 
 void HandleInstructionScreen3(int ms_elapsed)
 {
-	unsigned long currentTime = GetTickCount();
+	uint64_t currentTime = MonotonicMs();
 
-	DrawInstructionScreen3();
-
-	if (currentTime - gState.screenChangeTime > 100) {
-		gState.canAdvanceScreen = true;
+	if (currentTime - gState->screenChangeTime > 100) {
+		gState->canAdvanceScreen = true;
 	}
 
-	gSerialController.update();
-
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed() ||
-		gSerialController.isGameStartPressed();
+	bool buttonPressed = gInput->button_pressed;
 
-	if (gState.canAdvanceScreen && buttonPressed) {
+	if (gState->canAdvanceScreen && buttonPressed) {
 		PlayButtonSound();
-		gState.game_state = INSTR_SCREEN4;
-		gState.canAdvanceScreen = false;
-		gState.screenChangeTime = currentTime;
-		std::cout << "Advanced to screen 4" << std::endl;
+		gState->game_state = INSTR_SCREEN4;
+		gState->canAdvanceScreen = false;
+		gState->screenChangeTime = currentTime;
+		LOG_DEBUG("Advanced to screen 4");
 	}
 
 	PulseUpdate(ms_elapsed);
@@ -923,26 +806,20 @@ void HandleInstructionScreen3(int ms_elapsed)
 
 void HandleInstructionScreen4(int ms_elapsed)
 {
-	unsigned long currentTime = GetTickCount();
+	uint64_t currentTime = MonotonicMs();
 
-	DrawInstructionScreen4();
-
-	if (currentTime - gState.screenChangeTime > 100) {
-		gState.canAdvanceScreen = true;
+	if (currentTime - gState->screenChangeTime > 100) {
+		gState->canAdvanceScreen = true;
 	}
 
-	gSerialController.update();
-
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed() ||
-		gSerialController.isGameStartPressed();
+	bool buttonPressed = gInput->button_pressed;
 
-	if (gState.canAdvanceScreen && buttonPressed) {
+	if (gState->canAdvanceScreen && buttonPressed) {
 		PlayButtonSound();
-		gState.game_state = INSTR_FINAL_SCREEN;
-		gState.canAdvanceScreen = false;
-		gState.screenChangeTime = currentTime;
-		std::cout << "Advanced to final screen" << std::endl;
+		gState->game_state = INSTR_FINAL_SCREEN;
+		gState->canAdvanceScreen = false;
+		gState->screenChangeTime = currentTime;
+		LOG_DEBUG("Advanced to final screen");
 	}
 
 	PulseUpdate(ms_elapsed);
@@ -950,31 +827,32 @@ void HandleInstructionScreen4(int ms_elapsed)
 
 void HandleFinalInstructionScreen(int ms_elapsed)
 {
-	unsigned long currentTime = GetTickCount();
-
-	DrawFinalInstructionScreen();
+	uint64_t currentTime = MonotonicMs();
 
-	if (currentTime - gState.screenChangeTime > 100) {
-		gState.canAdvanceScreen = true;
+	// Line the hornets and the bee up next to their names
+	for (int i = 0; i < 4; i++) {
+		gState->ghosts[i]->enable_draw = true;
+		gState->ghosts[i]->pos = { 8, 5.5f + i * 3.f + (float) 4.2};
 	}
+	gState->player->enable_draw = true;
+	gState->player->pos = { 8, 17.5f + 4.2};
 
-	gSerialController.update();
+	if (currentTime - gState->screenChangeTime > 100) {
+		gState->canAdvanceScreen = true;
+	}
 
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed() ||
-		gSerialController.isGameStartPressed();
+	bool buttonPressed = gInput->button_pressed;
 
-	if (gState.canAdvanceScreen && buttonPressed) {
+	if (gState->canAdvanceScreen && buttonPressed) {
 		PlayButtonSound();
-		std::cout << "Starting game from final screen" << std::endl;
-		ResetPellets();
+		LOG_INFO("Starting game from final screen");
 		ResetBoard();
 		ResetGhostsAndPlayer();
-		gState.game_score = 0;
-		gState.player_lives = 3;
+		gState->game_score = 0;
+		gState->player_lives = 3;
 		PlayGameStart();
-		gState.pause_time = 4000;
-		gState.game_state = GAMESTART;
+		gState->pause_time = 4000;
+		gState->game_state = GAMESTART;
 	}
 
 	PulseUpdate(ms_elapsed);
@@ -984,54 +862,41 @@ void HandleFinalInstructionScreen(int ms_elapsed)
 void SetupInstructionScreens()
 {
 	PlayInstructionAmbient();
-	gState.game_state = INSTR_SCREEN1;
-	gState.canAdvanceScreen = false;
-	gState.screenChangeTime = GetTickCount();
+	gState->game_state = INSTR_SCREEN1;
+	gState->canAdvanceScreen = false;
+	gState->screenChangeTime = MonotonicMs();
 
 	// Position ghosts off-screen during instructions
 	for (int i = 0; i < 4; i++) {
-		gState.ghosts[i]->enable_draw = false;
+		gState->ghosts[i]->enable_draw = false;
 	}
 
 	// Hide player during first instruction (we use custom sprite)
-	gState.player->enable_draw = false;
+	gState->player->enable_draw = false;
 
 	// Set pulsing effect for button prompt
 	SetPulseFrequency(400);
 }
 void HandleTriviaCorrectExplanation(int ms_elapsed)
 {
-	// Draw the explanation screen
-	DrawTriviaExplanationScreen(true);
-
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
 
 	// Check for button press to continue
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed();
+	bool buttonPressed = gInput->button_pressed;
 
 	// If button is pressed, return to main game
 	if (buttonPressed) {
 		// End explanation timer
-		gGameLogger.endExplanationTimer();
-		// Make sure LED is updated one more time before leaving screen
-		if (gSerialController.isConnected()) {
-			std::cout << "Confirmation LED update for flower: " << gState.flowersCollected << std::endl;
-			gSerialController.setFlowerCollected(gState.flowersCollected);
-		}
-
+		gGameLogger->endExplanationTimer();
 		// Since the answer was correct, now we can remove the flower
-		RemovePellet(gState.player->pos.x, gState.player->pos.y);
-		SetTile(gState.player->pos.x, gState.player->pos.y, ' ');
+		SetTile(gState->player->pos.x, gState->player->pos.y, ' ');
 		IncrementGhostHouse();
-		gState.pellet_eaten = true;
-		gState.pellets_left--;
+		gState->pellet_eaten = true;
+		gState->pellets_left--;
 
-		gState.game_state = MAINLOOP;
+		gState->game_state = MAINLOOP;
 
 		// Reset the selected answer for next trivia question
-		gState.selected_trivia_answer = 0;
+		gState->selected_trivia_answer = 0;
 	}
 
 	// Update pulse effect
@@ -1040,29 +905,23 @@ void HandleTriviaCorrectExplanation(int ms_elapsed)
 
 void HandleTriviaIncorrectExplanation(int ms_elapsed)
 {
-	// Draw the explanation screen
-	DrawTriviaExplanationScreen(false);
-
-	// Update Arduino controller to get latest inputs
-	gSerialController.update();
 
 	// Check for button press to continue
-	bool buttonPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) ||
-		gSerialController.isButtonPressed();
+	bool buttonPressed = gInput->button_pressed;
 
 	// If button is pressed, return to main game
 	if (buttonPressed) {
 		// End explanation timer
-		gGameLogger.endExplanationTimer();
+		gGameLogger->endExplanationTimer();
 
-		gState.game_state = MAINLOOP;
+		gState->game_state = MAINLOOP;
 
 		// Reset the selected answer for next trivia question
-		gState.selected_trivia_answer = 0;
+		gState->selected_trivia_answer = 0;
 
 		// Disable flower interaction temporarily to let player move away
-		gState.can_interact_with_flower = false;
-		gState.flower_interaction_cooldown = 1.0f; // Half-second cooldown
+		gState->can_interact_with_flower = false;
+		gState->flower_interaction_cooldown = 1.0f; // Half-second cooldown
 
 		// The flower remains on the board for future attempts
 		// When the player returns, they'll get a different question
@@ -1074,12 +933,12 @@ void HandleTriviaIncorrectExplanation(int ms_elapsed)
 
 void UpdateFlowerInteractionCooldown(int ms_elapsed)
 {
-	if (!gState.can_interact_with_flower) {
-		gState.flower_interaction_cooldown -= ms_elapsed / 1000.0f;
+	if (!gState->can_interact_with_flower) {
+		gState->flower_interaction_cooldown -= ms_elapsed / 1000.0f;
 
-		if (gState.flower_interaction_cooldown <= 0.0f) {
-			gState.can_interact_with_flower = true;
-			gState.flower_interaction_cooldown = 0.0f;
+		if (gState->flower_interaction_cooldown <= 0.0f) {
+			gState->can_interact_with_flower = true;
+			gState->flower_interaction_cooldown = 0.0f;
 		}
 	}
 }
\ No newline at end of file
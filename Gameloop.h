@@ -8,12 +8,19 @@
 #include "Sound.h"
 #include "SerialController.h"
 
-// Global controller instance - declaration with extern keyword
-extern SerialController gSerialController;
+// The current station's controller, see Station.h
+extern thread_local StationPtr<SerialController> gSerialController;
 
-void OnStart();
-void OnQuit();
-void GameLoop(int ms_elapsed);
+// The station's startup as steps on plan, see StartupPlan.h. Its first
+// frame can be published once first_screen is done, it ticks once ready is.
+struct StationStartup
+{
+	int first_screen;
+	int ready;
+};
+StationStartup OnStart(Station& station, StartupPlan& plan, const TextureSteps& textures);
+void OnQuit(Station& station);
+void GameLoop(Station& station, int ms_elapsed);
 
 void Init();
 void InitBoard();
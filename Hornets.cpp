@@ -1,4 +1,5 @@
 #include "Hornets.h"
+#include "Log.h"
 
 bool InMiddleTile(sf::Vector2f pos, sf::Vector2f prev, Dir dir)
 {
@@ -58,7 +59,7 @@ Dir GetShortestDir(const std::vector<Dir>& squares, const Ghost& ghost, sf::Vect
 	int min_dist = 20000000;
 	Dir min_dir = NONE;
 	if (squares.size() == 0)
-		printf("EMPTY\n");
+		LOG_WARN("EMPTY");
 
 	for (auto dir : squares) {
 		sf::Vector2f square = ghost.pos + dir_addition[dir];
@@ -73,25 +74,25 @@ Dir GetShortestDir(const std::vector<Dir>& squares, const Ghost& ghost, sf::Vect
 }
 sf::Vector2f BlinkyUpdate(Ghost& ghost)
 {
-	return gState.player->pos;
+	return gState->player->pos;
 }
 sf::Vector2f PinkyUpdate(Ghost& ghost)
 {
-	return gState.player->pos + dir_addition[gState.player->cur_dir] * 4;
+	return gState->player->pos + dir_addition[gState->player->cur_dir] * 4;
 }
 sf::Vector2f InkyUpdate(Ghost& ghost)
 {
-	sf::Vector2f target = gState.player->pos + dir_addition[gState.player->cur_dir] * 2;
-	sf::Vector2f offset = gState.ghosts[RED]->pos - target;
+	sf::Vector2f target = gState->player->pos + dir_addition[gState->player->cur_dir] * 2;
+	sf::Vector2f offset = gState->ghosts[RED]->pos - target;
 	target = target + offset * -1;
 	return target;
 }
 sf::Vector2f ClydeUpdate(Ghost& ghost)
 {
-	sf::Vector2f target = gState.player->pos;
+	sf::Vector2f target = gState->player->pos;
 
 	// if clyde is 8 tiles away, target player, else target corner
-	if (Distance(ghost.pos.x, ghost.pos.y, gState.player->pos.x, gState.player->pos.y) < 64)
+	if (Distance(ghost.pos.x, ghost.pos.y, gState->player->pos.x, gState->player->pos.y) < 64)
 		target = { 0,31 };
 	return target;
 }
@@ -189,8 +190,8 @@ void HouseUpdate(Ghost& ghost)
 		ghost.move_speed = inhome_speed;
 
 		// check timer if its time to leave
-		if (gState.using_global_counter) {
-			if (gState.global_dot_counter >= global_dot_limit[ghost.type])
+		if (gState->using_global_counter) {
+			if (gState->global_dot_counter >= global_dot_limit[ghost.type])
 				ghost.target_state = LEAVEHOME;
 		}
 		else if (ghost.dot_counter >= dot_counters[ghost.type])
@@ -210,7 +211,7 @@ void HouseUpdate(Ghost& ghost)
 void UpdateGhosts()
 {
 	for (int i = 0; i < 4; i++) {
-		Ghost* ghost = gState.ghosts[i];
+		Ghost* ghost = gState->ghosts[i];
 		sf::Vector2f prev_pos = ghost->pos;
 
 		ghost->pos += dir_addition[ghost->cur_dir] * ghost->move_speed;
@@ -266,7 +267,7 @@ Dir GetOppositeTile(Ghost& ghost)
 void SetAllGhostState(TargetState new_state)
 {
 	for (int i = 0; i < 4; i++) {
-		SetGhostState(*gState.ghosts[i], new_state);
+		SetGhostState(*gState->ghosts[i], new_state);
 	}
 }
 
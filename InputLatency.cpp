@@ -0,0 +1,157 @@
+#include "InputLatency.h"
+#include "Log.h"
+#include "Station.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+struct LatencyHistogram
+{
+	std::atomic<uint32_t> buckets[latency_bucket_count];
+	std::atomic<uint32_t> count;
+	std::atomic<uint64_t> sum_us;
+	std::atomic<uint64_t> max_us;
+};
+
+// A turn waiting for the render thread to show it
+struct PendingTurn
+{
+	uint32_t id;
+	uint64_t start_us;	// read_us minus what the sketch and the wire took
+	uint64_t turn_us;
+};
+
+static const char* const stage_names[LATENCY_STAGE_COUNT] = { "sketch", "wire", "read", "turn", "present", "total" };
+
+// Histograms are shared by all stations, the turns waiting to be shown are
+// per station. Counters are bumped from several sims and renderers at once.
+static LatencyHistogram histograms[LATENCY_STAGE_COUNT];
+static PendingTurn pending[max_stations][latency_pending_turns];
+static std::atomic<uint32_t> latest_turn[max_stations];
+static std::atomic<unsigned> seq_gaps[max_stations];
+static uint32_t last_presented[max_stations];	// whichever thread draws the station
+
+static void Record(LatencyStage stage, uint64_t us)
+{
+	LatencyHistogram& h = histograms[stage];
+	uint64_t bucket = us / latency_bucket_us;
+	if (bucket >= latency_bucket_count)
+		bucket = latency_bucket_count - 1;
+	h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	h.count.fetch_add(1, std::memory_order_relaxed);
+	h.sum_us.fetch_add(us, std::memory_order_relaxed);
+	uint64_t max_us = h.max_us.load(std::memory_order_relaxed);
+	while (us > max_us && !h.max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed)) {
+	}
+}
+
+uint32_t LatencyTurn(const InputTiming& timing)
+{
+	uint64_t now = LogTimestamp();
+	uint64_t before_read = timing.wire_us;
+	if (timing.sketch_ms >= 0) {
+		Record(LATENCY_SKETCH, (uint64_t)timing.sketch_ms * 1000);
+		before_read += (uint64_t)timing.sketch_ms * 1000;
+	}
+	Record(LATENCY_WIRE, timing.wire_us);
+	Record(LATENCY_READ, timing.drained_us - timing.read_us);
+	Record(LATENCY_TURN, now - timing.drained_us);
+	int station = gStation->index;
+	seq_gaps[station].store(timing.seq_gaps, std::memory_order_relaxed);
+
+	uint32_t id = latest_turn[station].load(std::memory_order_relaxed) + 1;
+	PendingTurn& turn = pending[station][id % latency_pending_turns];
+	turn.id = id;
+	turn.start_us = timing.read_us > before_read ? timing.read_us - before_read : 0;
+	turn.turn_us = now;
+	// the frame buffer's publish orders this before the render thread reads it
+	latest_turn[station].store(id, std::memory_order_relaxed);
+	return id;
+}
+
+uint32_t LatestLatencyTurn()
+{
+	return latest_turn[gStation->index].load(std::memory_order_relaxed);
+}
+
+void LatencyPresented(uint32_t turn_id)
+{
+	int station = gStation->index;
+	if (turn_id <= last_presented[station])
+		return;
+
+	uint64_t now = LogTimestamp();
+	// frames the triple buffer skipped still count, on this frame
+	for (uint32_t id = last_presented[station] + 1; id <= turn_id; id++) {
+		const PendingTurn& turn = pending[station][id % latency_pending_turns];
+		if (turn.id != id)
+			continue;	// overwritten, the render thread was stalled for a long time
+		Record(LATENCY_PRESENT, now - turn.turn_us);
+		Record(LATENCY_TOTAL, now - turn.start_us);
+	}
+	last_presented[station] = turn_id;
+}
+
+static uint64_t Percentile(const LatencyHistogram& h, uint32_t count, double fraction)
+{
+	uint32_t target = (uint32_t)(count * fraction);
+	uint32_t seen = 0;
+	for (int i = 0; i < latency_bucket_count; i++) {
+		seen += h.buckets[i].load(std::memory_order_relaxed);
+		if (seen > target)
+			return (uint64_t)(i + 1) * latency_bucket_us;
+	}
+	return (uint64_t)latency_bucket_count * latency_bucket_us;
+}
+
+void DumpInputLatency()
+{
+	uint32_t turns = histograms[LATENCY_TURN].count.load(std::memory_order_relaxed);
+	unsigned lost = 0;
+	for (const auto& gaps : seq_gaps)
+		lost += gaps.load(std::memory_order_relaxed);
+	LOG_INFO("Input latency over {} joystick turns, {} direction messages lost", turns, lost);
+	if (turns == 0)
+		return;
+
+	char line[96];
+	std::snprintf(line, sizeof(line), "%-8s %6s %8s %8s %8s %8s", "stage", "count", "mean ms", "p50", "p95", "max");
+	LOG_INFO("{}", line);
+	for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+		const LatencyHistogram& h = histograms[s];
+		uint32_t count = h.count.load(std::memory_order_relaxed);
+		if (count == 0)
+			continue;
+		// percentiles are bucket upper bounds, never past the slowest one seen
+		uint64_t max_us = h.max_us.load(std::memory_order_relaxed);
+		std::snprintf(line, sizeof(line), "%-8s %6u %8.2f %8.2f %8.2f %8.2f", stage_names[s], count,
+			h.sum_us.load(std::memory_order_relaxed) / 1000.0 / count,
+			std::min(Percentile(h, count, 0.5), max_us) / 1000.0,
+			std::min(Percentile(h, count, 0.95), max_us) / 1000.0, max_us / 1000.0);
+		LOG_INFO("{}", line);
+	}
+
+	// Coarse histograms, counts per power of two milliseconds
+	std::snprintf(line, sizeof(line), "%-8s %5s %5s %5s %5s %5s %5s %5s %5s %5s %5s", "ms", "<1", "<2", "<4",
+		"<8", "<16", "<32", "<64", "<128", "<256", "more");
+	LOG_INFO("{}", line);
+	for (int s = 0; s < LATENCY_STAGE_COUNT; s++) {
+		const LatencyHistogram& h = histograms[s];
+		if (h.count.load(std::memory_order_relaxed) == 0)
+			continue;
+		uint32_t bins[10] = {};
+		for (int i = 0; i < latency_bucket_count; i++) {
+			uint64_t ms = (uint64_t)i * latency_bucket_us / 1000;
+			int bin = 0;
+			while (bin < 9 && ms >= (1u << bin))
+				bin++;
+			// the last bucket also holds everything past 250 ms
+			if (i == latency_bucket_count - 1)
+				bin = 9;
+			bins[bin] += h.buckets[i].load(std::memory_order_relaxed);
+		}
+		std::snprintf(line, sizeof(line), "%-8s %5u %5u %5u %5u %5u %5u %5u %5u %5u %5u", stage_names[s],
+			bins[0], bins[1], bins[2], bins[3], bins[4], bins[5], bins[6], bins[7], bins[8], bins[9]);
+		LOG_INFO("{}", line);
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef INPUTLATENCY_H
+#define INPUTLATENCY_H
+#include <cstdint>
+#include "SerialController.h"
+
+// Where the time goes between a joystick move and the frame that shows the bee
+// turning. Every turn made on a joystick message is split into stages:
+//	sketch	the sketch had the direction before sending it (protocol version 2),
+//			plus up to 1 ms before it polled the pin, which it can't see
+//	wire	bytes on the UART, computed from message size and baud rate
+//	read	reader thread parsed it until update() handed it to the game
+//	turn	update() until PlayerMovement turned the bee, including any wait in
+//			the turn buffer for an opening
+//	present	turn until display() returned for the first frame showing it
+//	total	all of the above
+// Histograms are kept from startup, across all stations, and logged by
+// DumpInputLatency (F10).
+
+enum LatencyStage
+{
+	LATENCY_SKETCH,
+	LATENCY_WIRE,
+	LATENCY_READ,
+	LATENCY_TURN,
+	LATENCY_PRESENT,
+	LATENCY_TOTAL,
+	LATENCY_STAGE_COUNT
+};
+
+const int latency_bucket_us = 250;
+const int latency_bucket_count = 1000;	// up to 250 ms, anything slower goes in the last one
+const int latency_pending_turns = 64;	// turns the render thread may fall behind by
+
+// sim side of the current station: the bee turned on this joystick message.
+// Returns the id that PublishFrame puts in the snapshot.
+uint32_t LatencyTurn(const InputTiming& timing);
+uint32_t LatestLatencyTurn();
+
+// render side of the current station, after display(): every turn up to
+// turn_id is on screen now
+void LatencyPresented(uint32_t turn_id);
+
+// any thread
+void DumpInputLatency();
+
+#endif // !INPUTLATENCY_H
@@ -0,0 +1,138 @@
+#include "InputSnapshot.h"
+#include "Clock.h"
+#include "Gameloop.h"
+#include "Joystick.h"
+#include "Player.h"
+#include "Station.h"
+
+thread_local StationPtr<InputSnapshot> gInput;
+
+static Dir ArrowDir(sf::Keyboard::Key key)
+{
+	switch (key)
+	{
+	case sf::Keyboard::Up:
+		return UP;
+	case sf::Keyboard::Down:
+		return DOWN;
+	case sf::Keyboard::Left:
+		return LEFT;
+	case sf::Keyboard::Right:
+		return RIGHT;
+	default:
+		return NONE;
+	}
+}
+
+static void ReleaseAllKeys(KeyState& keys)
+{
+	for (bool& held : keys.arrow_held)
+		held = false;
+	keys.latest_arrow = NONE;
+	keys.enter_held = false;
+}
+
+void InputWindowEvent(Station& station, const sf::Event& event)
+{
+	KeyState& keys = station.keys;
+	switch (event.type)
+	{
+	case sf::Event::KeyPressed: {
+		// key repeat sends more KeyPressed while held, only the first one counts
+		Dir dir = ArrowDir(event.key.code);
+		if (dir != NONE && !keys.arrow_held[dir]) {
+			keys.arrow_held[dir] = true;
+			keys.latest_arrow = dir;
+			keys.tapped_arrow = dir;
+			keys.up_pressed |= dir == UP;
+			keys.down_pressed |= dir == DOWN;
+		}
+		else if (event.key.code == sf::Keyboard::Enter && !keys.enter_held) {
+			keys.enter_held = true;
+			keys.enter_pressed = true;
+		}
+		break;
+	}
+	case sf::Event::KeyReleased: {
+		Dir dir = ArrowDir(event.key.code);
+		if (dir != NONE) {
+			keys.arrow_held[dir] = false;
+			if (keys.latest_arrow == dir) {
+				// fall back to another arrow that's still down
+				keys.latest_arrow = NONE;
+				for (Dir other : { UP, DOWN, RIGHT, LEFT }) {
+					if (keys.arrow_held[other]) {
+						keys.latest_arrow = other;
+						break;
+					}
+				}
+			}
+		}
+		else if (event.key.code == sf::Keyboard::Enter) {
+			keys.enter_held = false;
+		}
+		break;
+	}
+	// releases go to whichever window has focus now
+	case sf::Event::LostFocus:
+		ReleaseAllKeys(keys);
+		break;
+	default:
+		break;
+	}
+}
+
+void SampleInput(Station& station)
+{
+	StationBinding bound(station);
+
+	// Drain everything the serial reader queued since last tick
+	gSerialController->update();
+
+	KeyState& keys = station.keys;
+	InputSnapshot in;
+	in.sample_us = MonotonicUs();
+	in.key_dir = keys.tapped_arrow != NONE ? keys.tapped_arrow : keys.latest_arrow;
+	in.key_up_pressed = keys.up_pressed;
+	in.key_down_pressed = keys.down_pressed;
+	in.button_pressed = keys.enter_pressed;
+
+	if (gSerialController->isConnected()) {
+		if (gSerialController->hasStick()) {
+			// Held as long as the stick is, the maze only matters while playing
+			Dir before = station.stick_dir;
+			station.stick_dir = StickDirection(gSerialController->getStickX(), gSerialController->getStickY(),
+				before, gState->game_state == MAINLOOP ? TurnOpeningAhead : nullptr);
+			if (station.stick_dir != before)
+				station.stick_timing = gSerialController->getLastDirectionTiming();
+			in.joy_dir = station.stick_dir;
+			in.joy_timing = station.stick_timing;
+		}
+		else {
+			station.stick_dir = NONE;
+			if (gSerialController->isUpPressed())
+				in.joy_dir = UP;
+			else if (gSerialController->isDownPressed())
+				in.joy_dir = DOWN;
+			else if (gSerialController->isRightPressed())
+				in.joy_dir = RIGHT;
+			else if (gSerialController->isLeftPressed())
+				in.joy_dir = LEFT;
+			if (in.joy_dir != NONE)
+				in.joy_timing = gSerialController->getLastDirectionTiming();
+		}
+		// only fresh directions next tick, the sketch repeats held ones
+		gSerialController->resetJoystickFlags();
+
+		in.selection_changed = gSerialController->isSelectionChanged();
+		in.selected_answer = gSerialController->getSelectedAnswer();
+		in.reset_requested = gSerialController->isResetRequested();
+		in.button_pressed |= gSerialController->isGameStartPressed();
+	}
+
+	*gInput = in;
+	keys.tapped_arrow = NONE;
+	keys.up_pressed = false;
+	keys.down_pressed = false;
+	keys.enter_pressed = false;
+}
@@ -0,0 +1,52 @@
+#ifndef INPUTSNAPSHOT_H
+#define INPUTSNAPSHOT_H
+#include "Buzzy.h"
+#include "SerialController.h"
+
+// All the input one simulation tick sees, sampled once by SampleInput right
+// before GameLoop. The keyboard comes from window events, not isKeyPressed
+// (a round trip to the X server per call), the Arduino from draining
+// gSerialController, which is also where a replayed capture comes in.
+struct InputSnapshot
+{
+	uint64_t sample_us = 0;			// MonotonicUs(), sounds this tick plays are timed from it
+
+	// Keyboard
+	Dir key_dir = NONE;				// last arrow pressed this tick, else the last one still held
+	bool key_up_pressed = false;	// went down this tick
+	bool key_down_pressed = false;
+
+	// Arduino
+	Dir joy_dir = NONE;				// a direction message came in this tick, or where a streamed stick points
+	InputTiming joy_timing;			// how it got here, see InputLatency.h
+	bool selection_changed = false;
+	int selected_answer = 1;		// 1-4, valid when selection_changed
+	bool reset_requested = false;	// button held down
+
+	// Enter went down or the Arduino button was pressed this tick
+	bool button_pressed = false;
+};
+
+// Keyboard state built from window events between two samples
+struct KeyState
+{
+	bool arrow_held[5] = {};		// indexed by Dir
+	Dir latest_arrow = NONE;		// most recently pressed arrow still held
+	Dir tapped_arrow = NONE;		// pressed since the last sample, even if already released
+	bool up_pressed = false;
+	bool down_pressed = false;
+	bool enter_held = false;
+	bool enter_pressed = false;
+};
+
+struct Station;
+
+extern thread_local StationPtr<InputSnapshot> gInput;	// the current station's, see Station.h
+
+// main thread, every window event of the station before SampleInput
+void InputWindowEvent(Station& station, const sf::Event& event);
+
+// right before GameLoop
+void SampleInput(Station& station);
+
+#endif // !INPUTSNAPSHOT_H
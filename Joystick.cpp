@@ -0,0 +1,62 @@
+#include "Joystick.h"
+#include "SerialProtocol.h"
+#include <algorithm>
+#include <cstdlib>
+
+static StickZones zones;
+
+void SetStickZones(const StickZones& new_zones)
+{
+	zones = new_zones;
+	zones.dead_zone = std::min(std::max(zones.dead_zone, 1), 100);
+	zones.hysteresis = std::min(std::max(zones.hysteresis, 0), zones.dead_zone - 1);
+}
+const StickZones& GetStickZones()
+{
+	return zones;
+}
+
+// How far the stick points that way, in percent, 0 if it points the other way
+static int Deflection(int x, int y, Dir dir)
+{
+	int along = 0;
+	switch (dir)
+	{
+	case UP:
+		along = -y;
+		break;
+	case DOWN:
+		along = y;
+		break;
+	case LEFT:
+		along = -x;
+		break;
+	case RIGHT:
+		along = x;
+		break;
+	default:
+		break;
+	}
+	return std::max(along, 0) * 100 / stick_max;
+}
+
+Dir StickDirection(int x, int y, Dir held, TurnCheck opening_ahead)
+{
+	int ax = std::abs(x) * 100 / stick_max;
+	int ay = std::abs(y) * 100 / stick_max;
+
+	if (held != NONE) {
+		int along = Deflection(x, y, held);
+		int across = held == UP || held == DOWN ? ax : ay;
+		if (along >= zones.dead_zone - zones.hysteresis && across <= along + zones.hysteresis)
+			return held;
+	}
+
+	Dir dir = ax >= ay ? (x < 0 ? LEFT : RIGHT) : (y < 0 ? UP : DOWN);
+	int amount = std::max(ax, ay);
+	if (amount >= zones.dead_zone)
+		return dir;
+	if (opening_ahead && amount >= zones.dead_zone / 2 && opening_ahead(dir))
+		return dir;
+	return NONE;
+}
@@ -0,0 +1,30 @@
+#ifndef JOYSTICK_H
+#define JOYSTICK_H
+#include "Buzzy.h"
+
+// Turns the stick position a protocol version 4 sketch streams into the
+// direction the player means. A direction is taken once the stick is pushed
+// past the dead zone and held until it drops back below the dead zone minus
+// the hysteresis, or the other axis overtakes it by the hysteresis, so a
+// stick resting near the edge doesn't flicker between directions.
+// A switch joystick is always at full deflection and never in between.
+
+// Percent of full deflection, set with --stick
+struct StickZones
+{
+	int dead_zone = 40;
+	int hysteresis = 10;
+};
+
+void SetStickZones(const StickZones& zones);
+const StickZones& GetStickZones();
+
+// Is a turn that way possible just ahead of the player, see TurnOpeningAhead
+typedef bool (*TurnCheck)(Dir dir);
+
+// x and y as SerialController reports them, held is what this returned last
+// time. With opening_ahead, a push towards an opening just ahead counts from
+// half the dead zone: it's the turn the player is lining up for.
+Dir StickDirection(int x, int y, Dir held, TurnCheck opening_ahead = nullptr);
+
+#endif // !JOYSTICK_H
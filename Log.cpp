@@ -0,0 +1,192 @@
+#include "Log.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+
+// Bounded multi-producer queue (Vyukov). Each cell carries a sequence number
+// that tells producers and the consumer whether it's theirs to use, so pushing
+// is one CAS and a copy, and a full queue drops the record instead of blocking.
+struct LogCell
+{
+	std::atomic<size_t> sequence;
+	LogRecord record;
+};
+
+static LogCell log_cells[log_queue_size];
+static std::atomic<size_t> log_enqueue_pos(0);
+static size_t log_dequeue_pos = 0;	// only the log thread reads
+static std::atomic<unsigned> log_dropped(0);
+
+static std::thread log_thread;
+static std::atomic<bool> log_running(false);
+static const auto log_epoch = std::chrono::steady_clock::now();
+
+thread_local uint8_t log_station = 0;
+
+static bool InitLogCells()
+{
+	for (size_t i = 0; i < log_queue_size; i++)
+		log_cells[i].sequence.store(i, std::memory_order_relaxed);
+	return true;
+}
+static const bool log_cells_ready = InitLogCells();
+
+uint64_t LogTimestamp()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - log_epoch).count();
+}
+
+void PushLogRecord(const LogRecord& record)
+{
+	size_t pos = log_enqueue_pos.load(std::memory_order_relaxed);
+	for (;;) {
+		LogCell& cell = log_cells[pos & (log_queue_size - 1)];
+		size_t seq = cell.sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (log_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				cell.record = record;
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return;
+			}
+		}
+		else if (diff < 0) {
+			// full, the log thread is behind
+			log_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else {
+			pos = log_enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+static bool PopLogRecord(LogRecord& out)
+{
+	LogCell& cell = log_cells[log_dequeue_pos & (log_queue_size - 1)];
+	size_t seq = cell.sequence.load(std::memory_order_acquire);
+	if ((intptr_t)seq - (intptr_t)(log_dequeue_pos + 1) < 0)
+		return false;
+
+	out = cell.record;
+	cell.sequence.store(log_dequeue_pos + log_queue_size, std::memory_order_release);
+	log_dequeue_pos++;
+	return true;
+}
+
+static void FormatLogArg(std::string& out, const LogRecord& rec, const LogArg& arg)
+{
+	char buf[32];
+	switch (arg.type)
+	{
+	case LogArg::INT:
+		std::snprintf(buf, sizeof(buf), "%lld", arg.i);
+		out += buf;
+		break;
+	case LogArg::UINT:
+		std::snprintf(buf, sizeof(buf), "%llu", arg.u);
+		out += buf;
+		break;
+	case LogArg::FLOAT:
+		std::snprintf(buf, sizeof(buf), "%g", arg.f);
+		out += buf;
+		break;
+	case LogArg::BOOL:
+		out += arg.i ? "true" : "false";
+		break;
+	case LogArg::CHAR:
+		out += (char)arg.i;
+		break;
+	case LogArg::TEXT:
+		out.append(rec.text + arg.text.offset, arg.text.length);
+		break;
+	}
+}
+
+static void FormatLogRecord(std::string& out, const LogRecord& rec)
+{
+	static const char* level_names[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+	uint64_t ms = rec.time_us / 1000;
+	char prefix[40];
+	std::snprintf(prefix, sizeof(prefix), "[%3llu:%02llu.%03llu] %s ",
+		(unsigned long long)(ms / 60000), (unsigned long long)(ms / 1000 % 60),
+		(unsigned long long)(ms % 1000), level_names[rec.level]);
+	out += prefix;
+	if (rec.station) {
+		std::snprintf(prefix, sizeof(prefix), "#%u ", (unsigned)rec.station);
+		out += prefix;
+	}
+
+	int next_arg = 0;
+	for (const char* c = rec.fmt; *c != '\0'; c++) {
+		if (c[0] == '{' && c[1] == '}' && next_arg < rec.arg_count) {
+			FormatLogArg(out, rec, rec.args[next_arg++]);
+			c++;
+		}
+		else {
+			out += *c;
+		}
+	}
+	out += '\n';
+}
+
+// Drains whatever is queued, writes it with one call per stream and one flush
+static void DrainLog(std::string& out, std::string& err)
+{
+	LogRecord rec;
+	while (PopLogRecord(rec)) {
+		FormatLogRecord(rec.level >= LOGLVL_WARN ? err : out, rec);
+	}
+
+	unsigned dropped = log_dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0) {
+		char msg[64];
+		std::snprintf(msg, sizeof(msg), "[log] dropped %u records, queue full\n", dropped);
+		err += msg;
+	}
+
+	if (!out.empty()) {
+		std::fwrite(out.data(), 1, out.size(), stdout);
+		std::fflush(stdout);
+		out.clear();
+	}
+	if (!err.empty()) {
+		std::fwrite(err.data(), 1, err.size(), stderr);
+		std::fflush(stderr);
+		err.clear();
+	}
+}
+
+static void LogThreadMain()
+{
+	std::string out, err;
+	out.reserve(16 * 1024);
+	err.reserve(1024);
+
+	while (log_running.load(std::memory_order_relaxed)) {
+		DrainLog(out, err);
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	// whatever was logged during shutdown
+	DrainLog(out, err);
+}
+
+void StartLog()
+{
+	if (log_running)
+		return;
+	log_running = true;
+	log_thread = std::thread(LogThreadMain);
+}
+
+void StopLog()
+{
+	if (!log_running)
+		return;
+	log_running = false;
+	log_thread.join();
+}
@@ -0,0 +1,157 @@
+#ifndef LOG_H
+#define LOG_H
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Console logging that is safe to call from the game loop.
+// Callers only pack their arguments into a fixed size record and push it onto
+// a lock-free ring, a background thread does the formatting and the console
+// writes. Levels below BUZZY_LOG_LEVEL compile to nothing, so debug spam in hot
+// paths costs nothing in a kiosk build.
+//
+//	LOG_INFO("Connected to {} at {} baud", port_name, baud);
+//
+// Each {} is replaced by the next argument. Integers, floats, bools, chars,
+// C strings, std::strings and string_views are supported, strings are copied
+// into the record.
+
+enum LogLevel
+{
+	LOGLVL_DEBUG,
+	LOGLVL_INFO,
+	LOGLVL_WARN,
+	LOGLVL_ERROR,
+	LOGLVL_OFF,
+};
+
+// compile-time filter, e.g. -DBUZZY_LOG_LEVEL=0 to get debug output back
+#ifndef BUZZY_LOG_LEVEL
+#define BUZZY_LOG_LEVEL 1
+#endif
+
+const int log_max_args = 6;
+const int log_text_size = 96;	// room for copied string arguments
+const int log_queue_size = 1024;	// records, must be a power of two
+
+struct LogArg
+{
+	enum Type : uint8_t { INT, UINT, FLOAT, BOOL, CHAR, TEXT };
+	Type type;
+	union
+	{
+		long long i;
+		unsigned long long u;
+		double f;
+		struct { uint16_t offset, length; } text;
+	};
+};
+
+struct LogRecord
+{
+	uint64_t time_us;
+	const char* fmt;	// must be a string literal
+	LogLevel level;
+	uint8_t station;	// 1-based, 0 when not running several stations
+	uint8_t arg_count;
+	uint16_t text_used;
+	LogArg args[log_max_args];
+	char text[log_text_size];
+};
+
+void StartLog();
+void StopLog();
+void PushLogRecord(const LogRecord& record);
+uint64_t LogTimestamp();
+
+// Records from this thread are tagged with the station it is working for,
+// see Station.h. 0 leaves them untagged.
+extern thread_local uint8_t log_station;
+inline void SetLogStation(int station) { log_station = (uint8_t)station; }
+
+//
+// Argument packing, all inline so a disabled level leaves no code behind
+//
+inline void PackLogText(LogRecord& rec, LogArg& arg, const char* str, size_t len)
+{
+	size_t room = log_text_size - rec.text_used;
+	if (len > room)
+		len = room;
+	std::memcpy(rec.text + rec.text_used, str, len);
+	arg.type = LogArg::TEXT;
+	arg.text.offset = rec.text_used;
+	arg.text.length = (uint16_t)len;
+	rec.text_used += (uint16_t)len;
+}
+inline void PackLogArg(LogRecord& rec, LogArg& arg, const std::string& v) { PackLogText(rec, arg, v.data(), v.size()); }
+inline void PackLogArg(LogRecord& rec, LogArg& arg, std::string_view v) { PackLogText(rec, arg, v.data(), v.size()); }
+inline void PackLogArg(LogRecord& rec, LogArg& arg, const char* v) { PackLogText(rec, arg, v ? v : "(null)", v ? std::strlen(v) : 6); }
+inline void PackLogArg(LogRecord&, LogArg& arg, bool v) { arg.type = LogArg::BOOL; arg.i = v; }
+inline void PackLogArg(LogRecord&, LogArg& arg, char v) { arg.type = LogArg::CHAR; arg.i = v; }
+template <typename T>
+inline typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+PackLogArg(LogRecord&, LogArg& arg, T v)
+{
+	if (std::is_floating_point<T>::value) {
+		arg.type = LogArg::FLOAT;
+		arg.f = (double)v;
+	}
+	else if (std::is_signed<T>::value || std::is_enum<T>::value) {
+		arg.type = LogArg::INT;
+		arg.i = (long long)v;
+	}
+	else {
+		arg.type = LogArg::UINT;
+		arg.u = (unsigned long long)v;
+	}
+}
+
+inline void PackLogArgs(LogRecord&) {}
+template <typename T, typename... Rest>
+inline void PackLogArgs(LogRecord& rec, const T& first, const Rest&... rest)
+{
+	if (rec.arg_count < log_max_args) {
+		PackLogArg(rec, rec.args[rec.arg_count], first);
+		rec.arg_count++;
+	}
+	PackLogArgs(rec, rest...);
+}
+
+template <typename... Args>
+inline void WriteLog(LogLevel level, const char* fmt, const Args&... args)
+{
+	LogRecord rec;
+	rec.time_us = LogTimestamp();
+	rec.fmt = fmt;
+	rec.level = level;
+	rec.station = log_station;
+	rec.arg_count = 0;
+	rec.text_used = 0;
+	PackLogArgs(rec, args...);
+	PushLogRecord(rec);
+}
+
+#if BUZZY_LOG_LEVEL <= 0
+#define LOG_DEBUG(...) WriteLog(LOGLVL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+#if BUZZY_LOG_LEVEL <= 1
+#define LOG_INFO(...) WriteLog(LOGLVL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+#if BUZZY_LOG_LEVEL <= 2
+#define LOG_WARN(...) WriteLog(LOGLVL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+#if BUZZY_LOG_LEVEL <= 3
+#define LOG_ERROR(...) WriteLog(LOGLVL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif // !LOG_H
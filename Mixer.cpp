@@ -0,0 +1,430 @@
+#include "Mixer.h"
+#include "Clock.h"
+#include "Log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2 1
+#endif
+
+const int stream_buffer_frames = 4096;
+const float min_pitch = 0.25f;
+const float max_pitch = 4;
+
+// Ambient tracks drop to this while an effect plays, and fade back after
+const float duck_level = 0.35f;
+const float duck_attack_ms = 40;
+const float duck_release_ms = 400;
+
+const int64_t chunk_us = int64_t(mixer_chunk_frames) * 1000000 / mixer_rate;
+// SFML keeps three buffers queued, the one filled now plays after the other two
+const int64_t queued_us = 2 * chunk_us;
+// Further off than this, the audio thread stalled and the clock starts over
+const int64_t clock_reset_us = 100000;
+
+static int64_t FramesToUs(uint64_t frames)
+{
+	return int64_t(frames * 1000000 / mixer_rate);
+}
+
+// out (stereo) += gain * src, frames of mono or interleaved stereo
+static void AccumulateStereo(float* out, const int16_t* src, int frames, float gain)
+{
+	int samples = frames * 2;
+	int i = 0;
+#ifdef MIXER_SSE2
+	__m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= samples; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		// each 16 bit sample into the top of a 32 bit lane, then sign extended
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(lo, g)));
+		_mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(hi, g)));
+	}
+#endif
+	for (; i < samples; i++)
+		out[i] += src[i] * gain;
+}
+static void AccumulateMono(float* out, const int16_t* src, int frames, float gain)
+{
+	int i = 0;
+#ifdef MIXER_SSE2
+	__m128 g = _mm_set1_ps(gain);
+	for (; i + 4 <= frames; i += 4) {
+		__m128i s = _mm_loadl_epi64((const __m128i*)(src + i));
+		__m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)), g);
+		float* o = out + 2 * i;
+		_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_unpacklo_ps(v, v)));
+		_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_unpackhi_ps(v, v)));
+	}
+#endif
+	for (; i < frames; i++) {
+		float x = src[i] * gain;
+		out[2 * i] += x;
+		out[2 * i + 1] += x;
+	}
+}
+static void Accumulate(float* out, const int16_t* src, unsigned channels, int frames, float gain)
+{
+	if (channels == 2)
+		AccumulateStereo(out, src, frames, gain);
+	else
+		AccumulateMono(out, src, frames, gain);
+}
+
+// Rounded and clamped to 16 bits
+static void ConvertToPcm(int16_t* out, const float* mix, int samples)
+{
+	int i = 0;
+#ifdef MIXER_SSE2
+	for (; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_cvtps_epi32(_mm_loadu_ps(mix + i));
+		__m128i b = _mm_cvtps_epi32(_mm_loadu_ps(mix + i + 4));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < samples; i++)
+		out[i] = (int16_t)std::lrint(std::min(std::max(mix[i], -32768.f), 32767.f));
+}
+
+bool MixerStream::open(const std::string& path)
+{
+	if (!file.openFromFile(path))
+		return false;
+	channel_count = file.getChannelCount();
+	sample_rate = file.getSampleRate();
+	if (channel_count < 1 || channel_count > 2 || file.getSampleCount() == 0)
+		return false;
+	buffer.assign(size_t(stream_buffer_frames) * channel_count, 0);
+	restart();
+	return true;
+}
+void MixerStream::restart()
+{
+	file.seek(0);
+	buffer_start = 0;
+	buffer_frames = 0;
+}
+const int16_t* MixerStream::frames(uint64_t from, int count)
+{
+	// let go of what's been played
+	if (from >= buffer_start + buffer_frames) {
+		buffer_start = from;
+		buffer_frames = 0;
+	}
+	else if (from > buffer_start) {
+		int drop = int(from - buffer_start);
+		std::memmove(buffer.data(), buffer.data() + drop * channel_count,
+			(buffer_frames - drop) * channel_count * sizeof(int16_t));
+		buffer_frames -= drop;
+		buffer_start = from;
+	}
+
+	count = std::min(count, stream_buffer_frames);
+	bool wrapped = false;
+	while (buffer_frames < count) {
+		uint64_t room = uint64_t(stream_buffer_frames - buffer_frames) * channel_count;
+		int got = int(file.read(buffer.data() + buffer_frames * channel_count, room) / channel_count);
+		if (got > 0) {
+			buffer_frames += got;
+			wrapped = false;
+		}
+		else if (!wrapped) {
+			// the end, round again
+			file.seek(0);
+			wrapped = true;
+		}
+		else {
+			// unreadable after all, silence rather than spinning
+			std::fill(buffer.begin() + buffer_frames * channel_count, buffer.begin() + count * channel_count, 0);
+			buffer_frames = count;
+		}
+	}
+	return buffer.data();
+}
+
+Mixer::Mixer()
+{
+	initialize(mixer_channels, mixer_rate);
+}
+
+void Mixer::startVoice(int voice, uint16_t generation, const MixerSource& source, uint64_t at_us,
+	bool loop, bool ducked, bool ducking, float pitch)
+{
+	MixerCommand command;
+	command.type = MixerCommand::START;
+	command.voice = (uint8_t)voice;
+	command.generation = generation;
+	command.source = source;
+	command.at_us = at_us;
+	command.loop = loop;
+	command.ducked = ducked;
+	command.ducking = ducking;
+	command.pitch = pitch;
+	push(command);
+}
+void Mixer::stopVoice(int voice, uint16_t generation, uint64_t at_us)
+{
+	MixerCommand command;
+	command.type = MixerCommand::STOP;
+	command.voice = (uint8_t)voice;
+	command.generation = generation;
+	command.at_us = at_us;
+	push(command);
+}
+void Mixer::glidePitch(int voice, uint16_t generation, float pitch, int ramp_ms)
+{
+	MixerCommand command;
+	command.type = MixerCommand::PITCH;
+	command.voice = (uint8_t)voice;
+	command.generation = generation;
+	command.pitch = pitch;
+	command.ramp_ms = ramp_ms;
+	push(command);
+}
+
+void Mixer::push(const MixerCommand& command)
+{
+	uint32_t head = command_head.load(std::memory_order_relaxed);
+	if (head - command_tail.load(std::memory_order_acquire) >= (uint32_t)command_capacity) {
+		dropped_commands.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	commands[head % command_capacity] = command;
+	command_head.store(head + 1, std::memory_order_release);
+}
+
+void Mixer::logTiming()
+{
+	uint32_t count = starts.load(std::memory_order_relaxed);
+	uint32_t late = late_starts.load(std::memory_order_relaxed);
+	LOG_INFO("Audio: {} sounds started {} ms after their tick, {} of them late (worst by {} ms)",
+		count, mixer_latency_ms, late, max_late_us.load(std::memory_order_relaxed) / 1000.0);
+	uint32_t lead = min_lead_us.load(std::memory_order_relaxed);
+	LOG_INFO("Audio: tightest margin {} ms, {} commands dropped, {} clock resets",
+		lead == UINT32_MAX ? 0.0 : lead / 1000.0, dropped_commands.load(std::memory_order_relaxed),
+		clock_resets.load(std::memory_order_relaxed));
+}
+
+// Where the frame being rendered now will be when it comes out, smoothed
+// over many calls since SFML polls every 10 ms
+void Mixer::updateClock(uint64_t now_us)
+{
+	int64_t expected = int64_t(now_us) + queued_us - FramesToUs(rendered);
+	int64_t error = expected - clock_base_us;
+	if (!clock_set || error > clock_reset_us || error < -clock_reset_us) {
+		if (clock_set)
+			clock_resets.fetch_add(1, std::memory_order_relaxed);
+		clock_base_us = expected;
+		clock_set = true;
+	}
+	else
+		clock_base_us += error / 64;
+}
+
+uint64_t Mixer::frameAt(uint64_t at_us) const
+{
+	if (at_us == 0)
+		return rendered;
+	int64_t us = int64_t(at_us) + mixer_latency_ms * 1000 - clock_base_us;
+	return us > 0 ? uint64_t(us) * mixer_rate / 1000000 : 0;
+}
+
+void Mixer::applyCommands()
+{
+	uint32_t tail = command_tail.load(std::memory_order_relaxed);
+	uint32_t head = command_head.load(std::memory_order_acquire);
+	for (; tail != head; tail++) {
+		const MixerCommand& command = commands[tail % command_capacity];
+		Voice& voice = voices[command.voice];
+
+		switch (command.type)
+		{
+		case MixerCommand::START: {
+			voice = Voice();
+			voice.active = true;
+			voice.generation = command.generation;
+			voice.source = command.source;
+			voice.loop = command.loop;
+			voice.ducked = command.ducked;
+			voice.ducking = command.ducking;
+			voice.pitch = voice.pitch_target = std::min(std::max(command.pitch, min_pitch), max_pitch);
+			// a stream plays on one voice at a time
+			if (voice.source.stream) {
+				for (Voice& other : voices) {
+					if (&other != &voice && other.source.stream == voice.source.stream)
+						other.active = false;
+				}
+				voice.source.stream->restart();
+			}
+
+			uint64_t frame = frameAt(command.at_us);
+			if (command.at_us) {
+				starts.fetch_add(1, std::memory_order_relaxed);
+				if (frame < rendered) {
+					late_starts.fetch_add(1, std::memory_order_relaxed);
+					uint32_t late_us = (uint32_t)FramesToUs(rendered - frame);
+					if (late_us > max_late_us.load(std::memory_order_relaxed))
+						max_late_us.store(late_us, std::memory_order_relaxed);
+				}
+				else {
+					uint32_t lead_us = (uint32_t)FramesToUs(frame - rendered);
+					if (lead_us < min_lead_us.load(std::memory_order_relaxed))
+						min_lead_us.store(lead_us, std::memory_order_relaxed);
+				}
+			}
+			voice.start_frame = std::max(frame, rendered);
+			break;
+		}
+		case MixerCommand::STOP:
+			if (voice.active && voice.generation == command.generation)
+				voice.stop_frame = std::max(frameAt(command.at_us), rendered);
+			break;
+		case MixerCommand::PITCH:
+			if (voice.active && voice.generation == command.generation) {
+				voice.pitch_target = std::min(std::max(command.pitch, min_pitch), max_pitch);
+				int ramp_frames = command.ramp_ms * (int)mixer_rate / 1000;
+				voice.pitch_step = ramp_frames > 0 ? (voice.pitch_target - voice.pitch) / ramp_frames : 0;
+				if (voice.pitch_step == 0)
+					voice.pitch = voice.pitch_target;
+			}
+			break;
+		}
+	}
+	command_tail.store(tail, std::memory_order_release);
+}
+
+void Mixer::mixVoice(Voice& voice, float gain_from, float gain_to)
+{
+	uint64_t chunk_end = rendered + mixer_chunk_frames;
+	if (voice.start_frame >= chunk_end)
+		return;
+	int first = voice.start_frame > rendered ? int(voice.start_frame - rendered) : 0;
+	int last = mixer_chunk_frames;
+	bool stopping = voice.stop_frame < chunk_end;
+	if (stopping)
+		last = voice.stop_frame > rendered ? int(voice.stop_frame - rendered) : 0;
+	if (stopping)
+		voice.active = false;
+	if (last <= first)
+		return;
+
+	const MixerSource& source = voice.source;
+	unsigned channels = source.channels;
+	float* out = mix + first * mixer_channels;
+	int count = last - first;
+	float rate_ratio = float(source.rate) / mixer_rate;
+
+	// Straight copy at the source's own speed, the common case
+	if (voice.pitch == 1 && voice.pitch_step == 0 && rate_ratio == 1 && gain_from == gain_to
+		&& voice.position == std::floor(voice.position)) {
+		if (source.stream) {
+			const int16_t* src = source.stream->frames(uint64_t(voice.position), count);
+			Accumulate(out, src, channels, count, gain_to);
+			voice.position += count;
+			return;
+		}
+		while (count > 0) {
+			uint64_t at = uint64_t(voice.position);
+			if (at >= source.frames) {
+				if (!voice.loop || source.frames == 0) {
+					voice.active = false;
+					return;
+				}
+				at = 0;
+			}
+			int take = (int)std::min<uint64_t>(count, source.frames - at);
+			Accumulate(out, source.samples + at * channels, channels, take, gain_to);
+			out += take * mixer_channels;
+			count -= take;
+			voice.position = double(at + take);
+		}
+		return;
+	}
+
+	// Resampled, linear between neighbouring frames. A stream hands out at most
+	// stream_buffer_frames at a time, so a fast one is read in several windows.
+	const int16_t* window = source.samples;
+	uint64_t window_start = 0;
+	uint64_t window_end = source.stream ? 0 : UINT64_MAX;
+	float gain_step = (gain_to - gain_from) / mixer_chunk_frames;
+	for (int i = first; i < last; i++) {
+		uint64_t at = uint64_t(voice.position);
+		float frac = float(voice.position - double(at));
+		uint64_t next = at + 1;
+		if (next >= window_end) {
+			float fastest = std::max(voice.pitch, voice.pitch_target) * rate_ratio;
+			int want = (int)std::min<double>(std::ceil((last - i) * fastest) + 2, stream_buffer_frames);
+			window_start = at;
+			window_end = at + want;
+			window = source.stream->frames(window_start, want);
+		}
+		if (!source.stream) {
+			if (at >= source.frames) {
+				if (!voice.loop || source.frames == 0) {
+					voice.active = false;
+					return;
+				}
+				voice.position -= double(source.frames);
+				at -= source.frames;
+				next = at + 1;
+			}
+			if (next >= source.frames)
+				next = voice.loop ? 0 : at;
+		}
+		const int16_t* a = window + (at - window_start) * channels;
+		const int16_t* b = window + (next - window_start) * channels;
+		float gain = gain_from + gain_step * i;
+		float left = (a[0] + (b[0] - a[0]) * frac) * gain;
+		float right = channels == 2 ? (a[1] + (b[1] - a[1]) * frac) * gain : left;
+		mix[i * mixer_channels] += left;
+		mix[i * mixer_channels + 1] += right;
+
+		voice.position += voice.pitch * rate_ratio;
+		if (voice.pitch_step != 0) {
+			voice.pitch += voice.pitch_step;
+			if ((voice.pitch_step > 0) == (voice.pitch >= voice.pitch_target)) {
+				voice.pitch = voice.pitch_target;
+				voice.pitch_step = 0;
+			}
+		}
+	}
+}
+
+bool Mixer::onGetData(Chunk& data)
+{
+	updateClock(MonotonicUs());
+	applyCommands();
+
+	// Ambient tracks duck while an effect plays anywhere in this chunk
+	uint64_t chunk_end = rendered + mixer_chunk_frames;
+	bool duck = false;
+	for (const Voice& voice : voices)
+		duck = duck || (voice.active && voice.ducking && voice.start_frame < chunk_end && voice.stop_frame > rendered);
+	float chunk_ms = chunk_us / 1000.f;
+	float duck_from = duck_gain;
+	if (duck)
+		duck_gain = std::max(duck_level, duck_gain - (1 - duck_level) * chunk_ms / duck_attack_ms);
+	else
+		duck_gain = std::min(1.f, duck_gain + (1 - duck_level) * chunk_ms / duck_release_ms);
+
+	std::fill(std::begin(mix), std::end(mix), 0.f);
+	for (Voice& voice : voices) {
+		if (!voice.active)
+			continue;
+		if (voice.ducked)
+			mixVoice(voice, duck_from, duck_gain);
+		else
+			mixVoice(voice, 1, 1);
+	}
+	ConvertToPcm(pcm, mix, mixer_chunk_frames * mixer_channels);
+	rendered = chunk_end;
+
+	data.samples = pcm;
+	data.sampleCount = mixer_chunk_frames * mixer_channels;
+	return true;
+}
@@ -0,0 +1,144 @@
+#ifndef MIXER_H
+#define MIXER_H
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Every sound goes through one sf::SoundStream that adds up the voices itself
+// on SFML's audio thread. The game doesn't play anything directly, it queues
+// commands stamped with the time of the tick that played them, and the mixer
+// starts each sound mixer_latency_ms after that, to the sample. When in the
+// tick the sound was asked for and when the audio thread happens to wake
+// up no longer matter.
+//
+// Voices are numbered slots. Which sound gets which slot is up to the game
+// (see Sound.cpp), the mixer only does what the commands say. A command for
+// a generation the slot no longer plays is ignored.
+
+const unsigned mixer_rate = 44100;
+const int mixer_channels = 2;
+const int mixer_chunk_frames = 512;		// 11.6 ms per onGetData
+const int mixer_voice_count = 16;
+
+// From a tick's input sample to its sounds coming out. Has to cover the
+// tick, SFML's 10 ms polling and the buffers SFML keeps queued.
+const int mixer_latency_ms = 50;
+
+// A looping track read from disk while it plays, by one voice at a time
+class MixerStream
+{
+public:
+	bool open(const std::string& path);
+	unsigned channels() const { return channel_count; }
+	unsigned rate() const { return sample_rate; }
+
+private:
+	friend class Mixer;
+
+	// audio thread: frames [from, from + count) of the endless loop, from
+	// never goes back except through restart
+	const int16_t* frames(uint64_t from, int count);
+	void restart();
+
+	sf::InputSoundFile file;
+	std::vector<int16_t> buffer;
+	uint64_t buffer_start = 0;	// frame number of buffer[0]
+	int buffer_frames = 0;
+	unsigned channel_count = 1;
+	unsigned sample_rate = mixer_rate;
+};
+
+// What a voice plays: decoded samples, or a stream
+struct MixerSource
+{
+	const int16_t* samples = nullptr;
+	uint64_t frames = 0;
+	unsigned channels = 1;
+	unsigned rate = mixer_rate;
+	MixerStream* stream = nullptr;
+};
+
+struct MixerCommand
+{
+	enum Type : uint8_t { START, STOP, PITCH };
+
+	Type type = START;
+	uint8_t voice = 0;
+	uint16_t generation = 0;
+	bool loop = false;
+	bool ducked = false;		// quieter while something that ducks plays
+	bool ducking = false;
+	float pitch = 1;
+	int ramp_ms = 0;			// PITCH: how long the glide takes
+	MixerSource source;
+	uint64_t at_us = 0;			// MonotonicUs() of the tick, 0 for as soon as possible
+};
+
+class Mixer : public sf::SoundStream
+{
+public:
+	Mixer();
+
+	// game side, one thread at a time
+	void startVoice(int voice, uint16_t generation, const MixerSource& source, uint64_t at_us,
+		bool loop = false, bool ducked = false, bool ducking = true, float pitch = 1);
+	void stopVoice(int voice, uint16_t generation, uint64_t at_us);
+	void glidePitch(int voice, uint16_t generation, float pitch, int ramp_ms);
+
+	// How sounds met their start time, to the log
+	void logTiming();
+
+protected:
+	bool onGetData(Chunk& data) override;
+	void onSeek(sf::Time) override {}
+
+private:
+	struct Voice
+	{
+		bool active = false;
+		uint16_t generation = 0;
+		MixerSource source;
+		bool loop = false;
+		bool ducked = false;
+		bool ducking = false;
+		uint64_t start_frame = 0;
+		uint64_t stop_frame = UINT64_MAX;
+		double position = 0;	// in source frames
+		float pitch = 1;
+		float pitch_target = 1;
+		float pitch_step = 0;	// per output frame
+	};
+
+	void push(const MixerCommand& command);
+	void updateClock(uint64_t now_us);
+	uint64_t frameAt(uint64_t at_us) const;
+	void applyCommands();
+	void mixVoice(Voice& voice, float gain_from, float gain_to);
+
+	// Single producer, single consumer, so neither side ever waits
+	static const int command_capacity = 256;
+	MixerCommand commands[command_capacity];
+	std::atomic<uint32_t> command_head{ 0 };	// written by the game
+	std::atomic<uint32_t> command_tail{ 0 };	// written by the audio thread
+
+	// audio thread
+	Voice voices[mixer_voice_count];
+	uint64_t rendered = 0;		// frames handed to SFML so far
+	int64_t clock_base_us = 0;	// when frame 0 came out, as far as we can tell
+	bool clock_set = false;
+	float duck_gain = 1;
+	float mix[mixer_chunk_frames * mixer_channels];
+	int16_t pcm[mixer_chunk_frames * mixer_channels];
+
+	// for logTiming
+	std::atomic<uint32_t> starts{ 0 };
+	std::atomic<uint32_t> late_starts{ 0 };
+	std::atomic<uint32_t> max_late_us{ 0 };
+	std::atomic<uint32_t> min_lead_us{ UINT32_MAX };
+	std::atomic<uint32_t> dropped_commands{ 0 };
+	std::atomic<uint32_t> clock_resets{ 0 };
+};
+
+#endif // !MIXER_H
@@ -1,7 +1,9 @@
 #include "Player.h"
-#include "SerialController.h"
 #include "Gameloop.h"
-#include <iostream>
+#include "InputSnapshot.h"
+#include "Station.h"
+#include "Log.h"
+#include "InputLatency.h"
 
 Dir GetCorrection(Dir pdir, sf::Vector2f ppos)
 {
@@ -23,144 +25,138 @@ Dir GetCorrection(Dir pdir, sf::Vector2f ppos)
 }
 void Cornering()
 {
-	gState.player->pos += dir_addition[gState.player->correction] * player_speed;
+	gState->player->pos += dir_addition[gState->player->correction] * player_speed;
 	bool done = false;
-	switch (gState.player->correction)
+	switch (gState->player->correction)
 	{
 	case UP:
-		done = (gState.player->pos.y - (int)gState.player->pos.y <= 0.5);
+		done = (gState->player->pos.y - (int)gState->player->pos.y <= 0.5);
 		break;
 	case DOWN:
-		done = (gState.player->pos.y - (int)gState.player->pos.y >= 0.5);
+		done = (gState->player->pos.y - (int)gState->player->pos.y >= 0.5);
 		break;
 	case LEFT:
-		done = (gState.player->pos.x - (int)gState.player->pos.x <= 0.5);
+		done = (gState->player->pos.x - (int)gState->player->pos.x <= 0.5);
 		break;
 	case RIGHT:
-		done = (gState.player->pos.x - (int)gState.player->pos.x >= 0.5);
+		done = (gState->player->pos.x - (int)gState->player->pos.x >= 0.5);
 		break;
 	}
 	if (done) {
-		CenterObject(gState.player->cur_dir, gState.player->pos);
-		gState.player->cornering = false;
+		CenterObject(gState->player->cur_dir, gState->player->pos);
+		gState->player->cornering = false;
 	}
 }
 void ResolveCollision()
 {
-	switch (gState.player->cur_dir) {
+	switch (gState->player->cur_dir) {
 	case UP:
-		gState.player->pos.y = (int)gState.player->pos.y + 0.5;
+		gState->player->pos.y = (int)gState->player->pos.y + 0.5;
 		break;
 	case DOWN:
-		gState.player->pos.y = (int)gState.player->pos.y + 0.5;
+		gState->player->pos.y = (int)gState->player->pos.y + 0.5;
 		break;
 	case LEFT:
-		gState.player->pos.x = (int)gState.player->pos.x + 0.5;
+		gState->player->pos.x = (int)gState->player->pos.x + 0.5;
 		break;
 	case RIGHT:
-		gState.player->pos.x = (int)gState.player->pos.x + 0.5;
+		gState->player->pos.x = (int)gState->player->pos.x + 0.5;
 		break;
 	}
 }
+// Walks the maze from the player's tile along the current heading, up to
+// turn_predict_tiles ahead or the next wall, looking for a side opening
+bool TurnOpeningAhead(Dir turn)
+{
+	Player& player = *gState->player;
+	if (player.stopped || turn == NONE || turn == player.cur_dir || turn == opposite_dir[player.cur_dir])
+		return false;
+
+	sf::Vector2f pos = player.pos;
+	for (int tile = 0; tile <= turn_predict_tiles; tile++) {
+		if (InTunnel(pos))
+			return false;
+		if (!PlayerTileCollision(turn, pos))
+			return true;
+		if (PlayerTileCollision(player.cur_dir, pos))
+			return false;
+		pos += dir_addition[player.cur_dir];
+	}
+	return false;
+}
+void BufferTurn(int ms_elapsed)
+{
+	// The joystick overrides the keyboard
+	Dir wanted = gInput->joy_dir != NONE ? gInput->joy_dir : gInput->key_dir;
+	if (wanted != NONE) {
+		gState->player->try_dir = wanted;
+		gState->player->try_time = turn_buffer_ms;
+		gStation->turn_from_joystick = gInput->joy_dir != NONE;
+		if (gStation->turn_from_joystick)
+			gStation->turn_timing = gInput->joy_timing;
+	}
+	else if (gState->player->try_dir != NONE) {
+		gState->player->try_time -= ms_elapsed;
+		if (gState->player->try_time <= 0 && !TurnOpeningAhead(gState->player->try_dir))
+			gState->player->try_dir = NONE;
+	}
+}
 void PlayerMovement()
 {
-    // Update Arduino controller to get latest inputs FIRST
-    gSerialController.update();
-
-    Dir try_dir = NONE;
+    Dir try_dir = gState->player->try_dir;
 
     // Store current player direction to check if it changes
-    Dir old_dir = gState.player->cur_dir;
-
-    // Debug all joystick states
-    if (gSerialController.isConnected()) {
-        bool upPressed = gSerialController.isUpPressed();
-        bool downPressed = gSerialController.isDownPressed();
-        bool leftPressed = gSerialController.isLeftPressed();
-        bool rightPressed = gSerialController.isRightPressed();
-    }
-
-    // Check keyboard input
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
-        try_dir = UP;
-    else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
-        try_dir = DOWN;
-    else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
-        try_dir = RIGHT;
-    else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
-        try_dir = LEFT;
-
-    // Check Arduino joystick input (overrides keyboard)
-    if (gSerialController.isConnected()) {
-        // Reset the SerialController's joystick flags after checking, to ensure
-        // we only respond to fresh inputs each frame
-        if (gSerialController.isUpPressed()) {
-            try_dir = UP;
-            std::cout << "Setting try_dir to UP from joystick" << std::endl;
-        }
-        else if (gSerialController.isDownPressed()) {
-            try_dir = DOWN;
-            std::cout << "Setting try_dir to DOWN from joystick" << std::endl;
-        }
-        else if (gSerialController.isRightPressed()) {
-            try_dir = RIGHT;
-            std::cout << "Setting try_dir to RIGHT from joystick" << std::endl;
-        }
-        else if (gSerialController.isLeftPressed()) {
-            try_dir = LEFT;
-            std::cout << "Setting try_dir to LEFT from joystick" << std::endl;
-        }
-    }
+    Dir old_dir = gState->player->cur_dir;
 
     // If we have a direction to try, check if it's valid
     if (try_dir != NONE) {
 
         // Check if we can move in this direction
-        if (!PlayerTileCollision(try_dir, gState.player->pos) && !InTunnel(gState.player->pos)) {
+        if (!PlayerTileCollision(try_dir, gState->player->pos) && !InTunnel(gState->player->pos)) {
+
+            // A joystick turn the player can see, time it through to the screen
+            if (gStation->turn_from_joystick && (try_dir != old_dir || gState->player->stopped))
+                LatencyTurn(gStation->turn_timing);
 
             // Change direction
-            gState.player->cur_dir = try_dir;
+            gState->player->cur_dir = try_dir;
 
             // Only need to corner if not opposite direction
             if (try_dir != opposite_dir[old_dir]) {
-                gState.player->cornering = true;
-                gState.player->correction = GetCorrection(try_dir, gState.player->pos);
+                gState->player->cornering = true;
+                gState->player->correction = GetCorrection(try_dir, gState->player->pos);
             }
 
             // Ensure player is not stopped
-            gState.player->stopped = false;
-        }
-    }
+            gState->player->stopped = false;
 
-    // After handling input, reset the controller's joystick flags
-    // This ensures we only respond to fresh movements
-    if (gSerialController.isConnected()) {
-        // Send command to reset joystick flags in SerialController
-        gSerialController.resetJoystickFlags();
+            // Taken, a key or joystick still held asks again next tick
+            gState->player->try_dir = NONE;
+        }
     }
 
     // Continue with movement based on current direction
-    if (!gState.player->stopped) {
-        gState.player->pos += dir_addition[gState.player->cur_dir] * player_speed;
+    if (!gState->player->stopped) {
+        gState->player->pos += dir_addition[gState->player->cur_dir] * player_speed;
     }
 
-    if (gState.player->cornering) {
+    if (gState->player->cornering) {
         Cornering();
     }
 
     // Check for collision in the current direction
-    if (PlayerTileCollision(gState.player->cur_dir, gState.player->pos)) {
+    if (PlayerTileCollision(gState->player->cur_dir, gState->player->pos)) {
         ResolveCollision();
-        gState.player->stopped = true;
+        gState->player->stopped = true;
     }
 
     // tunneling
-    if (gState.player->pos.x < -1) {
-        gState.player->pos.x += 29;
-        std::cout << "Tunneling right to left" << std::endl;
+    if (gState->player->pos.x < -1) {
+        gState->player->pos.x += 29;
+        LOG_DEBUG("Tunneling right to left");
     }
-    else if (gState.player->pos.x >= 29) {
-        gState.player->pos.x -= 29;
-        std::cout << "Tunneling left to right" << std::endl;
+    else if (gState->player->pos.x >= 29) {
+        gState->player->pos.x -= 29;
+        LOG_DEBUG("Tunneling left to right");
     }
 }
\ No newline at end of file
@@ -2,9 +2,18 @@
 #define PLAYER_H
 #include "Buzzy.h"
 
+// How long a turn asked for before an opening waits for one. Covers the
+// sketch's 50 ms repeat of a held joystick and a keyboard tap just early.
+const int turn_buffer_ms = 250;
+// A buffered turn with an opening for it this many tiles ahead on the
+// current heading waits for it however long that takes
+const int turn_predict_tiles = 2;
+
 Dir GetCorrection(Dir pdir, sf::Vector2f ppos);
 void Cornering();
 void ResolveCollision();
+bool TurnOpeningAhead(Dir turn);
+void BufferTurn(int ms_elapsed);
 void PlayerMovement();
 
 #endif // !PLAYER_H
\ No newline at end of file
@@ -1,20 +1,38 @@
 #include "Render.h"
 #include "Animate.h"
+#include "AssetBundle.h"
+#include "Station.h"
+#include "FrameCapture.h"
+#include "InputLatency.h"
+#include "Log.h"
 #include <string>
 #include <vector>
 #include <sstream>
-#include <iostream>
+#include <mutex>
 
-static RenderItems RItems;
+// Loaded once, every station's window shares SFML's GL context
 static Textures RTextures;
 
+// Only what the first instruction screen draws, so it can be shown while the
+// rest is still being set up
+void InitFirstScreen()
+{
+	RenderItems& RItems = gStation->render.items;
+	RItems.text_va.setPrimitiveType(sf::Quads);
+
+	RItems.buzzy.setTexture(RTextures.buzzy_sprite);
+	RItems.buzzy.setScale({ 0.5, 0.5 });
+	RItems.buzzy.setOrigin({ 64, 64 });
+}
+
+// Everything else. Doesn't touch what InitFirstScreen set up, the first
+// screen may be on its way to the window meanwhile.
 void InitRender()
 {
-	InitTextures();
+	RenderItems& RItems = gStation->render.items;
 	InitWalls();
 	RItems.pellet_va.setPrimitiveType(sf::Quads);
 	RItems.sprite_va.setPrimitiveType(sf::Quads);
-	RItems.text_va.setPrimitiveType(sf::Quads);
 
 	RItems.wall_map.setTexture(RTextures.wall_map_t);
 	RItems.wall_map.setScale({ 0.5,0.5 });
@@ -36,10 +54,6 @@ void InitRender()
 	RItems.float_score.setScale({ 0.5,0.5 });
 	RItems.float_score.setOrigin({ 16,16 });
 
-	RItems.buzzy.setTexture(RTextures.buzzy_sprite);
-	RItems.buzzy.setScale({ 0.5, 0.5 });
-	RItems.buzzy.setOrigin({ 64, 64 });
-
 	RItems.buzzyfriends.setTexture(RTextures.buzzy_friends);
 	RItems.buzzyfriends.setScale({ 0.4, 0.4 });
 	RItems.buzzyfriends.setOrigin({ 256, 256 });
@@ -68,36 +82,78 @@ void MakeQuad(sf::VertexArray& va, float x, float y, int w, int h, sf::Color col
 }
 void InitWalls()
 {
+	RenderItems& RItems = gStation->render.items;
 	RItems.wall_va.setPrimitiveType(sf::Quads);
-	for (int y = 0; y < gState.board.size(); y++) {
-		for (int x = 0; x < gState.board.at(y).size(); x++) {
-			if (gState.board.at(y).at(x) == '|')
+	for (int y = 0; y < gState->board.size(); y++) {
+		for (int x = 0; x < gState->board.at(y).size(); x++) {
+			if (gState->board.at(y).at(x) == '|')
 				MakeQuad(RItems.wall_va, x * TSIZE, y * TSIZE + YOFFSET, TSIZE, TSIZE, { 150,150,150 });
 		}
 	}
 }
-void InitTextures()
+// Texture names as in bundle_assets, see AssetBundle.cpp
+struct TextureFile
+{
+	sf::Texture Textures::* texture;
+	const char* name;
+	bool first_screen;		// drawn by InitFirstScreen's sprites
+};
+
+static const TextureFile texture_files[] = {
+	{ &Textures::pellets, "dots", false },
+	{ &Textures::sprites, "sprites", false },
+	{ &Textures::wall_map_t, "map", false },
+	{ &Textures::wall_map_t_white, "map_white", false },
+	{ &Textures::font, "font", true },
+	{ &Textures::powered_pacman, "poweredbees", false },
+	{ &Textures::buzzy_sprite, "buzzy", true },
+	{ &Textures::buzzy_friends, "buzzy_and_friends", false },
+	{ &Textures::flower_t, "flower", false },
+};
+
+// Uploaded straight from the bundle's mapped pixels when there is one, no PNG
+// decoding. Any thread: SFML gives one without a GL context its own, shared
+// with the windows', and flushes the upload so they all see it.
+static void LoadTexture(sf::Texture& texture, const char* name)
 {
-	RTextures.pellets.loadFromFile("textures/dots.png");
-	RTextures.sprites.loadFromFile("textures/sprites.png");
-	RTextures.wall_map_t.loadFromFile("textures/map.png");
-	RTextures.font.loadFromFile("textures/font.png");
-	RTextures.wall_map_t_white.loadFromFile("textures/map.png");
-	RTextures.wall_map_t_white.loadFromFile("textures/map_white.png");
-	RTextures.powered_pacman.loadFromFile("textures/poweredbees.png");
-	RTextures.buzzy_sprite.loadFromFile("textures/buzzy.png");
-	RTextures.buzzy_friends.loadFromFile("textures/buzzy_and_friends.png");
-	RTextures.flower_t.loadFromFile("textures/flower.png");
+	const AssetEntry* entry = Assets().find(ASSET_TEXTURE, name);
+	if (entry && texture.create(entry->width, entry->height)) {
+		texture.update(Assets().data(*entry));
+		return;
+	}
+	std::string path = AssetPath(FindAsset(ASSET_TEXTURE, name)->path);
+	if (!texture.loadFromFile(path))
+		LOG_WARN("Couldn't load {}", path);
+}
 
+TextureSteps PlanTextures(StartupPlan& plan, int after)
+{
+	std::vector<int> first_screen;
+	std::vector<int> all;
+	for (const TextureFile& file : texture_files) {
+		int step = plan.add(std::string("texture ") + file.name, [&file] {
+			LoadTexture(RTextures.*file.texture, file.name);
+		}, { after });
+		(file.first_screen ? first_screen : all).push_back(step);
+	}
+
+	// steps to wait for the groups with
+	TextureSteps steps;
+	steps.first_screen = plan.add("first screen textures", [] {}, first_screen);
+	all.push_back(steps.first_screen);
+	steps.all = plan.add("textures", [] {}, all);
+	return steps;
 }
 
 void InitPellets()
 {
+	RenderItems& RItems = gStation->render.items;
 	RItems.pellet_va.clear();
+	RItems.pellet_va_indicies.clear();
 	int VA_Index = 0;
 	int Pow_index = 0;
-	for (int y = 0; y < gState.board.size(); y++) {
-		for (int x = 0; x < gState.board.at(y).size(); x++) {
+	for (int y = 0; y < gState->board.size(); y++) {
+		for (int x = 0; x < gState->board.at(y).size(); x++) {
 			char temp = GetTile(x, y);
 			if (temp == '.') {
 				MakeQuad(RItems.pellet_va, x * TSIZE, y * TSIZE + YOFFSET, TSIZE, TSIZE, { 255,255,255 }, pel_r);
@@ -111,172 +167,339 @@ void InitPellets()
 				Pow_index++;
 				VA_Index += 4;
 			}
+			if (temp == '.' || temp == 'o')
+				RItems.shown_pellets.set(y * 28 + x);
 		}
 	}
 }
-void ResetPellets()
+void ApplyPellets(const FrameSnapshot& snap)
 {
-	for (int i = 0; i < RItems.pellet_va.getVertexCount(); i++) {
-		RItems.pellet_va[i].color = { 255,255,255,255 };
+	RenderItems& RItems = gStation->render.items;
+	// only walk the pellet quads when something was eaten or the board was reset
+	if (snap.pellets != RItems.shown_pellets) {
+		for (const auto& pel : RItems.pellet_va_indicies) {
+			sf::Uint8 alpha = snap.pellets.test(pel.first) ? 255 : 0;
+			sf::Vertex* vert = &RItems.pellet_va[pel.second];
+			for (int i = 0; i < 4; i++)
+				vert[i].color = { 255,255,255,alpha };
+		}
+		RItems.shown_pellets = snap.pellets;
 	}
 
-	RItems.wall_map.setTexture(RTextures.wall_map_t);
+	// I am using alpha 0 to hide pellets, so for flashing, Ill just use alpha 1
+	sf::Uint8 pow_alpha = snap.pulse ? 255 : 1;
+	for (int i = 0; i < 4; i++) {
+		sf::Vertex* vert = &RItems.pellet_va[RItems.pow_indicies[i]];
+		if (vert->color.a == 0)
+			continue;
+		for (int j = 0; j < 4; j++)
+			vert[j].color.a = pow_alpha;
+	}
 }
-void RemovePellet(int x, int y)
+void PublishFrame(Station& station)
 {
-	int va_idx = RItems.pellet_va_indicies.at(y * 28 + x);
-	sf::Vertex* vert = &RItems.pellet_va[va_idx];
-	vert[0].color = { 0,0,0,0 };
-	vert[1].color = { 0,0,0,0 };
-	vert[2].color = { 0,0,0,0 };
-	vert[3].color = { 0,0,0,0 };
+	StationBinding bound(station);
+	FrameSnapshot& snap = station.render.frames.Back();
+
+	snap.game_state = gState->game_state;
+	snap.pulse = IsPulse();
+	snap.game_score = gState->game_score;
+	snap.high_score = gState->high_score;
+	snap.player_lives = gState->player_lives;
+
+	// sprite frames depend on the animation state, which only the sim may read
+	for (int i = 0; i < 4; i++) {
+		const Ghost* ghost = gState->ghosts[i];
+		snap.ghosts[i].pos = ghost->pos;
+		snap.ghosts[i].frame = GetGhostFrame(ghost->type, ghost->target_state, ghost->cur_dir);
+		snap.ghosts[i].enable_draw = ghost->enable_draw;
+	}
+
+	snap.player_powered = (gState->energizer_time > 0 && !IsDeathAnimation());
+	snap.player.pos = gState->player->pos;
+	snap.player.frame = snap.player_powered ? GetPoweredPacManFrame(gState->player->cur_dir)
+		: GetPacManFrame(gState->player->cur_dir);
+	snap.player.enable_draw = gState->player->enable_draw;
+
+	snap.player_eat_ghost = gState->player_eat_ghost;
+	snap.ghosts_eaten_in_powerup = gState->ghosts_eaten_in_powerup;
+
+	for (int y = 0; y < gState->board.size(); y++) {
+		for (int x = 0; x < gState->board.at(y).size(); x++) {
+			char tile = gState->board.at(y).at(x);
+			snap.pellets.set(y * 28 + x, tile == '.' || tile == 'o');
+		}
+	}
+
+	// a question is laid out the tick it's dealt, drawing only uses the result
+	snap.trivia_layout = FindTriviaLayout(gState->current_trivia_question);
+	snap.selected_trivia_answer = gState->selected_trivia_answer;
+	snap.explanation = gState->current_explanation;
+	snap.input_turn_id = LatestLatencyTurn();
+
+	station.render.frames.Publish();
+}
+void RenderFrame(const FrameSnapshot& snap)
+{
+	switch (snap.game_state)
+	{
+	case INSTR_SCREEN1:
+		DrawInstructionScreen1(snap);
+		break;
+	case INSTR_SCREEN2:
+		DrawInstructionScreen2(snap);
+		break;
+	case INSTR_SCREEN3:
+		DrawInstructionScreen3(snap);
+		break;
+	case INSTR_SCREEN4:
+		DrawInstructionScreen4(snap);
+		break;
+	case INSTR_FINAL_SCREEN:
+		DrawFinalInstructionScreen(snap);
+		break;
+	case TRIVIA_CORRECT_EXPLANATION:
+		DrawTriviaExplanationScreen(snap, true);
+		break;
+	case TRIVIA_INCORRECT_EXPLANATION:
+		DrawTriviaExplanationScreen(snap, false);
+		break;
+	default:
+		DrawFrame(snap);
+		break;
+	}
+
+	// read back before display() swaps the buffer away
+	if (gStation->capture)
+		CaptureFrame(*gState->window);
+	gState->window->display();
+	LatencyPresented(snap.input_turn_id);
+}
+bool RenderStation(Station& station)
+{
+	StationBinding bound(station);
+	StationRender& render = station.render;
+
+	// nothing new from the sim yet, don't redraw the same frame
+	if (!render.frames.Acquire())
+		return false;
+
+	uint64_t start_us = LogTimestamp();
+	gState->window->setActive(true);
+	if (station.capture && !render.capture_started) {
+		InitFrameCapture(*gState->window);
+		render.capture_started = true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(render.viewport_mutex);
+		if (render.viewport_changed) {
+			sf::View view = gState->window->getView();
+			view.setViewport(render.pending_viewport);
+			gState->window->setView(view);
+			render.viewport_changed = false;
+		}
+	}
+
+	RenderFrame(render.frames.Front());
+
+	// the next frame may be drawn from another thread
+	gState->window->setActive(false);
+
+	uint64_t now = LogTimestamp();
+	StationStats& stats = station.stats;
+	stats.render.Add(now - start_us);
+	if (stats.last_present_us != 0)
+		stats.interval.Add(now - stats.last_present_us);
+	stats.last_present_us = now;
+	return true;
+}
+void StopRender(Station& station)
+{
+	StationBinding bound(station);
+	StationRender& render = station.render;
+	if (!render.capture_started)
+		return;
+	gState->window->setActive(true);
+	ShutdownFrameCapture();
+	gState->window->setActive(false);
+	render.capture_started = false;
 }
-void DrawGameUI()
+void SetRenderViewport(Station& station, const sf::FloatRect& viewport)
 {
+	StationRender& render = station.render;
+	std::lock_guard<std::mutex> lock(render.viewport_mutex);
+	render.pending_viewport = viewport;
+	render.viewport_changed = true;
+}
+void DrawGameUI(const FrameSnapshot& snap)
+{
+	RenderItems& RItems = gStation->render.items;
 	ClearText();
 
 	MakeText("HIGH SCORE", 9, 0, { 204, 85, 0 });
 
-	if (gState.game_state == GAMESTART)
+	if (snap.game_state == GAMESTART)
 		MakeText("READY!", 11, 20, { 204, 85, 0 });
-	else if (gState.game_state == GAMEOVER)
+	else if (snap.game_state == GAMEOVER)
 		MakeText("GAME OVER", 10.5, 20, { 204, 85, 0 });
 
-	std::string score = std::to_string(gState.game_score);
+	std::string score = std::to_string(snap.game_score);
 	if (score.size() == 1)
 		score.insert(score.begin(), '0');
 	MakeText(score, 7 - score.size(), 1, { 204, 85, 0 });
 
-	score = std::to_string(gState.high_score);
+	score = std::to_string(snap.high_score);
 	if (score.size() == 1)
 		score.insert(score.begin(), '0');
 	MakeText(score, 17 - score.size(), 1, { 204, 85, 0 });
 
 	RItems.player.setTextureRect({ 256,32,30,30 });
-	for (int i = 0; i < gState.player_lives; i++) {
+	for (int i = 0; i < snap.player_lives; i++) {
 		RItems.player.setPosition({ 24.f + 16 * i,35 * TSIZE });
-		gState.window->draw(RItems.player);
+		gState->window->draw(RItems.player);
 	}
 }
-void FlashPPellets()
+// Trivia text never changes, so each question's text is wrapped and turned
+// into glyph quads once here instead of every frame
+TriviaLayout& LayoutTriviaQuestion(const TriviaQuestion& question)
 {
-	sf::Uint8 new_alpha = (RItems.pow_is_off) ? 255 : 1;
-
-	for (int i = 0; i < 4; i++) {
-		int index = RItems.pow_indicies[i];
-		sf::Vertex* vert = &RItems.pellet_va[index];
-		// I am using alpha 0 to hide pellets, so for flashing, Ill just use alpha 1
-		if (vert->color.a == 0)
-			continue;
-		vert[0].color.a = new_alpha;
-		vert[1].color.a = new_alpha;
-		vert[2].color.a = new_alpha;
-		vert[3].color.a = new_alpha;
-	}
-}
-void ResetPPelletFlash()
-{
-	RItems.pow_is_off = true;
-	FlashPPellets();
-}
-void DrawTriviaQuestion()
-{
-	ClearText();
-
-	// Debug output
-	std::cout << "Current selected answer: " << gState.selected_trivia_answer << std::endl;
-
-	// Get the full question
-	std::string full_question = gState.current_trivia_question.question;
+	TriviaLayout& layout = gStation->render.trivia_layouts[question.Index()];
+	layout.question_va.setPrimitiveType(sf::Quads);
+	layout.question_va.clear();
 
 	// Maximum characters per line
 	const int MAX_LINE_LENGTH = 26;
 
 	// Maximum number of lines to display
 	const int MAX_QUESTION_LINES = 5;
+	const int MAX_ANSWER_LINES = 3;
+	const int MAX_EXPLANATION_LINES = 10;
 
 	// Wrap the question text
-	std::vector<std::string> question_lines = WrapText(full_question, MAX_LINE_LENGTH);
+	std::vector<std::string> question_lines = WrapText(std::string(question.Text()), MAX_LINE_LENGTH);
 
 	// Limit the number of lines displayed
 	if (question_lines.size() > MAX_QUESTION_LINES) {
 		question_lines.resize(MAX_QUESTION_LINES);
 	}
 
-	// Draw question lines
 	for (size_t i = 0; i < question_lines.size(); i++) {
-		MakeText(question_lines[i], 1, 1 + i * 2, { 204, 85, 0 });
+		MakeText(layout.question_va, question_lines[i], 1, 1 + i * 2, trivia_text_color);
 	}
 
 	// Calculate starting Y for answers based on question lines
 	int answers_start_y = 1 + question_lines.size() * 2 + 2;
 
-	// Draw answers with full text and line breaking
-	for (int i = 0; i < gState.current_trivia_question.answers.size(); i++) {
-		std::string answer_text = std::to_string(i + 1) + ": " +
-			gState.current_trivia_question.answers[i];
+	// Answers go in the same vertex array, remember each one's range for recoloring
+	for (int i = 0; i < 4; i++) {
+		layout.answer_begin[i] = layout.answer_end[i] = layout.question_va.getVertexCount();
+		if (i >= question.AnswerCount())
+			continue;
+
+		std::string answer_text = std::to_string(i + 1) + ": " + std::string(question.Answer(i));
 
 		// Break long answers into multiple lines
 		std::vector<std::string> answer_lines = WrapText(answer_text, MAX_LINE_LENGTH);
-
-		// Limit the number of answer lines
-		const int MAX_ANSWER_LINES = 3;
 		if (answer_lines.size() > MAX_ANSWER_LINES) {
 			answer_lines.resize(MAX_ANSWER_LINES);
 		}
 
-		// Debug output for each answer
-		std::cout << "Answer " << i << " selected: "
-			<< (i == gState.selected_trivia_answer ? "YES" : "NO") << std::endl;
-
-		// Determine color based on selection
-		sf::Color answer_color = (i == gState.selected_trivia_answer)
-			? sf::Color::Blue  // blue for selected answer
-			: sf::Color({ 204, 85, 0 });  // burnt orange for unselected answer
-
-		// Draw each line of the answer
 		for (size_t j = 0; j < answer_lines.size(); j++) {
 			// Adjusted vertical spacing to create more consistent layout
 			int line_y = answers_start_y + (i * 7) + j * 2;
-			MakeText(answer_lines[j], 5, line_y, answer_color);
+			MakeText(layout.question_va, answer_lines[j], 5, line_y, trivia_text_color);
+		}
+		layout.answer_end[i] = layout.question_va.getVertexCount();
+	}
+	layout.selected = -1;
+
+	for (int e = 0; e < question.AnswerCount(); e++) {
+		sf::VertexArray& va = layout.explanation_va[e];
+		va.setPrimitiveType(sf::Quads);
+		va.clear();
+
+		std::vector<std::string> explanation_lines = WrapText(std::string(question.Explanation(e)), MAX_LINE_LENGTH);
+		for (size_t i = 0; i < explanation_lines.size() && i < MAX_EXPLANATION_LINES; i++) {
+			MakeText(va, explanation_lines[i], 5, 16 + i * 2, sf::Color::Black);
 		}
 	}
+	return layout;
 }
+void InitTriviaLayouts()
+{
+	RenderItems& RItems = gStation->render.items;
+	gStation->render.trivia_layouts.clear();
 
-void DrawTriviaExplanationScreen(bool was_correct)
+	// for answers without an explanation
+	RItems.missing_explanation_va.setPrimitiveType(sf::Quads);
+	RItems.missing_explanation_va.clear();
+	MakeText(RItems.missing_explanation_va, "No explanation available.", 5, 16, sf::Color::Black);
+}
+TriviaLayout* FindTriviaLayout(const TriviaQuestion& question)
+{
+	if (!question.IsValid())
+		return nullptr;
+	std::map<int, TriviaLayout>& layouts = gStation->render.trivia_layouts;
+	auto it = layouts.find(question.Index());
+	return (it != layouts.end()) ? &it->second : &LayoutTriviaQuestion(question);
+}
+static void ColorVertexRange(sf::VertexArray& va, size_t begin, size_t end, sf::Color color)
+{
+	for (size_t i = begin; i < end; i++)
+		va[i].color = color;
+}
+void DrawTriviaQuestion(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135));
+	TriviaLayout* layout = snap.trivia_layout;
+	if (layout == nullptr)
+		return;
+
+	// Only the previously and newly selected answers change color
+	int selected = snap.selected_trivia_answer;
+	if (selected != layout->selected) {
+		if (layout->selected >= 0 && layout->selected < 4)
+			ColorVertexRange(layout->question_va, layout->answer_begin[layout->selected],
+				layout->answer_end[layout->selected], trivia_text_color);
+		if (selected >= 0 && selected < 4)
+			ColorVertexRange(layout->question_va, layout->answer_begin[selected],
+				layout->answer_end[selected], sf::Color::Blue);
+		layout->selected = selected;
+	}
+
+	gState->window->draw(layout->question_va, &RTextures.font);
+}
+
+void DrawTriviaExplanationScreen(const FrameSnapshot& snap, bool was_correct)
+{
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135));
 	ClearText();
 
 	// Draw the Buzzy sprite
 	RItems.buzzy.setPosition(14 * TSIZE, 6 * TSIZE + YOFFSET);
-	gState.window->draw(RItems.buzzy);
+	gState->window->draw(RItems.buzzy);
 
 	// Set title color based on correct/incorrect
 	sf::Color titleColor = was_correct ? sf::Color::Green : sf::Color::Red;
 
 	// Draw title
-	std::string titleText = was_correct ? "CORRECT!" : "NOT QUITE!";
-	MakeText(titleText, 11, 3, titleColor);
-
-	// Get explanation
-	std::string explanation = gState.current_explanation;
-
-	// Break the explanation into lines for display
-	std::vector<std::string> explanation_lines = WrapText(explanation, 26);
-
-	// Draw explanation text
-	for (size_t i = 0; i < explanation_lines.size() && i < 10; i++) {
-		MakeText(explanation_lines[i], 5, 16 + i * 2, sf::Color::Black);
-	}
+	MakeText(was_correct ? "CORRECT!" : "NOT QUITE!", 11, 3, titleColor);
 
 	// Draw instruction at bottom
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press button to continue", 5, 32, {204, 85, 0});
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	gState->window->draw(RItems.text_va, &RTextures.font);
+
+	// Draw the explanation that was laid out with its question
+	const sf::VertexArray* explanation_va = &RItems.missing_explanation_va;
+	TriviaLayout* layout = snap.trivia_layout;
+	if (layout != nullptr && snap.explanation >= 0 && snap.explanation < trivia_max_answers
+		&& layout->explanation_va[snap.explanation].getVertexCount() > 0)
+		explanation_va = &layout->explanation_va[snap.explanation];
+	gState->window->draw(*explanation_va, &RTextures.font);
 }
 
 std::vector<std::string> WrapText(const std::string& text, size_t line_length) {
@@ -301,95 +524,77 @@ std::vector<std::string> WrapText(const std::string& text, size_t line_length) {
 
 	return wrapped_lines;
 }
-void DrawFrame()
+void DrawFrame(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135));
-	DrawGameUI();
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135));
+	DrawGameUI(snap);
 
-	if (RItems.pow_is_off != IsPulse()) {
-		FlashPPellets();
-		RItems.pow_is_off = !RItems.pow_is_off;
-	}
+	ApplyPellets(snap);
 
-	static bool white_texture = false;
-	if (gState.game_state == GAMEWIN) {
-		if (IsPulse() && !white_texture) {
-			RItems.wall_map.setTexture(RTextures.wall_map_t_white);
-			white_texture = true;
-		}
-		else if (!IsPulse() && white_texture) {
-			RItems.wall_map.setTexture(RTextures.wall_map_t);
-			white_texture = false;
-		}
-	}
+	if (snap.game_state == GAMEWIN && snap.pulse)
+		RItems.wall_map.setTexture(RTextures.wall_map_t_white);
+	else
+		RItems.wall_map.setTexture(RTextures.wall_map_t);
 
 	// Ensure the game background is not drawn during trivia mode
-	if (gState.game_state != TRIVIA_MODE) {
-		gState.window->draw(RItems.wall_map);
-		gState.window->draw(RItems.pellet_va, &RTextures.pellets);
-	}
-
-	if (gState.game_state == TRIVIA_MODE) {
-		DrawTriviaQuestion();
+	if (snap.game_state != TRIVIA_MODE) {
+		gState->window->draw(RItems.wall_map);
+		gState->window->draw(RItems.pellet_va, &RTextures.pellets);
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
+	// the trivia screen replaces the score text with the question
+	if (snap.game_state == TRIVIA_MODE)
+		DrawTriviaQuestion(snap);
+	else
+		gState->window->draw(RItems.text_va, &RTextures.font);
 
 	for (int i = 0; i < 4; i++) {
-		if (!gState.ghosts[i]->enable_draw)
+		if (!snap.ghosts[i].enable_draw)
 			continue;
-		RItems.ghosts[i].setPosition(gState.ghosts[i]->pos.x * TSIZE, gState.ghosts[i]->pos.y * TSIZE + YOFFSET);
-		RItems.ghosts[i].setTextureRect(GetGhostFrame(gState.ghosts[i]->type, gState.ghosts[i]->target_state, gState.ghosts[i]->cur_dir));
-		if (gState.game_state != TRIVIA_MODE) {
-			gState.window->draw(RItems.ghosts[i]);
+		RItems.ghosts[i].setPosition(snap.ghosts[i].pos.x * TSIZE, snap.ghosts[i].pos.y * TSIZE + YOFFSET);
+		RItems.ghosts[i].setTextureRect(snap.ghosts[i].frame);
+		if (snap.game_state != TRIVIA_MODE) {
+			gState->window->draw(RItems.ghosts[i]);
 		}
 	}
 
-	if (gState.player->enable_draw) {
-		RItems.player.setPosition(gState.player->pos.x * TSIZE, gState.player->pos.y * TSIZE + YOFFSET);
+	if (snap.player.enable_draw) {
+		RItems.player.setPosition(snap.player.pos.x * TSIZE, snap.player.pos.y * TSIZE + YOFFSET);
 
-		// Check if player is powered up
-		bool isPowered = (gState.energizer_time > 0);
-
-		// Set the appropriate texture and frame
-		if (isPowered && !animate.death_animation) {
-			// Use powered texture only when not in death animation
+		// Set the appropriate texture, the frame was already picked by the sim
+		if (snap.player_powered)
 			RItems.player.setTexture(RTextures.powered_pacman);
-			RItems.player.setTextureRect(GetPoweredPacManFrame(gState.player->cur_dir));
-		}
-		else {
-			// Always use regular sprites for death animation or normal state
+		else
 			RItems.player.setTexture(RTextures.sprites);
-			RItems.player.setTextureRect(GetPacManFrame(gState.player->cur_dir));
-		}
+		RItems.player.setTextureRect(snap.player.frame);
 
-		if (gState.game_state != TRIVIA_MODE) {
-			gState.window->draw(RItems.player);
+		if (snap.game_state != TRIVIA_MODE) {
+			gState->window->draw(RItems.player);
 		}
 	}
 
-	if (gState.player_eat_ghost) {
-		RItems.float_score.setPosition(gState.player->pos.x * TSIZE, gState.player->pos.y * TSIZE + YOFFSET);
-		RItems.float_score.setTextureRect({ (gState.ghosts_eaten_in_powerup - 1) * 32,256,32,32 });
+	if (snap.player_eat_ghost) {
+		RItems.float_score.setPosition(snap.player.pos.x * TSIZE, snap.player.pos.y * TSIZE + YOFFSET);
+		RItems.float_score.setTextureRect({ (snap.ghosts_eaten_in_powerup - 1) * 32,256,32,32 });
 
-		if (gState.game_state != TRIVIA_MODE) {
-			gState.window->draw(RItems.float_score);
+		if (snap.game_state != TRIVIA_MODE) {
+			gState->window->draw(RItems.float_score);
 		}
 	}
-
-	gState.window->display();
 }
 
-void DrawInstructionScreen1()
+void DrawInstructionScreen1(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135)); // Same background as menu
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135)); // Same background as menu
 
 	ClearText();
 
 	// Draw the Buzzy sprite
 	// Position in the upper part of the screen, centered horizontally
 	RItems.buzzy.setPosition(14 * TSIZE, 1.5 * TSIZE + YOFFSET);
-	gState.window->draw(RItems.buzzy);
+	gState->window->draw(RItems.buzzy);
 
 	// Display instruction text with word wrapping
 	std::string line1 = "Hi there! I'm Buzzy, the busy worker";
@@ -415,24 +620,24 @@ void DrawInstructionScreen1()
 	MakeText(line9, 10, 29, sf::Color::Black);
 
 	// pulse text
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press the big yellow button", 3, 32, { 204, 85, 0 });
 		MakeText("to continue!", 9, 34, { 204, 85, 0 });
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	gState->window->draw(RItems.text_va, &RTextures.font);
 }
 
-void DrawInstructionScreen2()
+void DrawInstructionScreen2(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135));
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135));
 
 	ClearText();
 
 	// Draw joystick instruction with bee sprite
 	RItems.flower.setPosition(14 * TSIZE, 8 * TSIZE + YOFFSET);
-	gState.window->draw(RItems.flower);
+	gState->window->draw(RItems.flower);
 
 	// Draw instruction text
 	std::string line1 = "Use the joystick to help me fly";
@@ -442,23 +647,23 @@ void DrawInstructionScreen2()
 	MakeText(line2, 2, 22, sf::Color::Black);
 
 	// Display button prompt - pulse this text
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press to continue", 7, 30, { 204, 85, 0 });
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	gState->window->draw(RItems.text_va, &RTextures.font);
 }
 
-void DrawInstructionScreen3()
+void DrawInstructionScreen3(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135));
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135));
 
 	ClearText();
 
 	// Draw trivia instruction with flower icon
 	RItems.buzzyfriends.setPosition(14 * TSIZE, 8 * TSIZE + YOFFSET);
-	gState.window->draw(RItems.buzzyfriends);
+	gState->window->draw(RItems.buzzyfriends);
 
 	// Draw instruction text
 	std::string line1 = "Answer a question correctly to get";
@@ -470,17 +675,17 @@ void DrawInstructionScreen3()
 	MakeText(line3, 2, 22, sf::Color::Black);
 
 	// Display button prompt - pulse this text
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press to continue", 7, 30, { 204, 85, 0 });
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	gState->window->draw(RItems.text_va, &RTextures.font);
 }
 
-void DrawInstructionScreen4()
+void DrawInstructionScreen4(const FrameSnapshot& snap)
 {
-	gState.window->clear(sf::Color(255, 214, 135));
+	RenderItems& RItems = gStation->render.items;
+	gState->window->clear(sf::Color(255, 214, 135));
 
 	ClearText();
 
@@ -490,18 +695,18 @@ void DrawInstructionScreen4()
 	MakeText(line1, 3, 15, sf::Color::Red);
 
 	// Display button prompt - pulse this text
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press to continue", 7, 30, { 204, 85, 0 });
 	}
 
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	gState->window->draw(RItems.text_va, &RTextures.font);
 }
 
-void DrawFinalInstructionScreen()
+void DrawFinalInstructionScreen(const FrameSnapshot& snap)
 {
+	RenderItems& RItems = gStation->render.items;
 	// Draw the original menu screen but with warning text
-	gState.window->clear(sf::Color(255, 214, 135));
+	gState->window->clear(sf::Color(255, 214, 135));
 
 	ClearText();
 
@@ -519,34 +724,64 @@ void DrawFinalInstructionScreen()
 	MakeText("-BUZZY", 9, 24, { 204, 85, 0 });
 
 	// Draw start prompt at bottom
-	if (IsPulse()) {
+	if (snap.pulse) {
 		MakeText("Press the button to start Buzzy's day!", 0, 30, { 204, 85, 0 });
 	}
-	// Draw ghosts for the menu (hornets)
+	// Draw ghosts for the menu (hornets), HandleFinalInstructionScreen lines them up
 	for (int i = 0; i < 4; i++) {
-		gState.ghosts[i]->enable_draw = true;
-		gState.ghosts[i]->pos = { 8, 5.5f + i * 3.f + (float) 4.2};
-		RItems.ghosts[i].setPosition(gState.ghosts[i]->pos.x * TSIZE, gState.ghosts[i]->pos.y * TSIZE + YOFFSET);
-		RItems.ghosts[i].setTextureRect(GetGhostFrame(gState.ghosts[i]->type, gState.ghosts[i]->target_state, gState.ghosts[i]->cur_dir));
-		gState.window->draw(RItems.ghosts[i]);
+		RItems.ghosts[i].setPosition(snap.ghosts[i].pos.x * TSIZE, snap.ghosts[i].pos.y * TSIZE + YOFFSET);
+		RItems.ghosts[i].setTextureRect(snap.ghosts[i].frame);
+		gState->window->draw(RItems.ghosts[i]);
 	}
 
 	// Draw player (bee)
-	gState.player->enable_draw = true;
-	gState.player->pos = { 8, 17.5f + 4.2};
-	RItems.player.setPosition(gState.player->pos.x * TSIZE, gState.player->pos.y * TSIZE + YOFFSET);
-	RItems.player.setTextureRect(GetPacManFrame(gState.player->cur_dir));
-	gState.window->draw(RItems.player);
-
-	gState.window->draw(RItems.text_va, &RTextures.font);
-	gState.window->display();
+	RItems.player.setTexture(RTextures.sprites);
+	RItems.player.setPosition(snap.player.pos.x * TSIZE, snap.player.pos.y * TSIZE + YOFFSET);
+	RItems.player.setTextureRect(snap.player.frame);
+	gState->window->draw(RItems.player);
+
+	gState->window->draw(RItems.text_va, &RTextures.font);
 }
 
 void ClearText()
 {
+	RenderItems& RItems = gStation->render.items;
 	RItems.text_va.clear();
 }
-void MakeText(std::string string, float x, float y, sf::Color color)
+void MakeText(const std::string& string, float x, float y, sf::Color color)
+{
+	RenderItems& RItems = gStation->render.items;
+	MakeText(RItems.text_va, string, x, y, color);
+}
+
+// Cell of each character in the font spritesheet, row by row, -1 if it has none
+struct GlyphTable
+{
+	signed char row[128];
+	signed char col[128];
+
+	GlyphTable()
+	{
+		const char* rows[6] = {
+			"!\"#$%&'[]*+,-.",
+			"/0123456789:;<",
+			"=>?@ABCDEFGHIJ",
+			"KLMNOPQRSTUVWX",
+			"YZabcdefghijkl",
+			"mnopqrstuvwxyz",
+		};
+		for (int i = 0; i < 128; i++)
+			row[i] = col[i] = -1;
+		for (int r = 0; r < 6; r++) {
+			for (int c = 0; rows[r][c] != '\0'; c++) {
+				row[(unsigned char)rows[r][c]] = r;
+				col[(unsigned char)rows[r][c]] = c;
+			}
+		}
+	}
+};
+
+void MakeText(sf::VertexArray& va, const std::string& string, float x, float y, sf::Color color)
 {
 	const int CHAR_WIDTH = 46;   // Width of each character cell in spritesheet
 	const int CHAR_HEIGHT = 65;  // Height of each character cell in spritesheet
@@ -558,130 +793,21 @@ void MakeText(std::string string, float x, float y, sf::Color color)
 	// Reduced spacing factor (previously multiplied by DISPLAY_WIDTH)
 	const int SPACING = 6;  // Tighter spacing between characters
 
-	// Direct mapping of characters to their positions in the spritesheet
-	std::map<char, std::pair<int, int>> charMap;
-
-	// First row (index 0,0 to 0,13)
-	charMap['!'] = { 0, 0 };
-	charMap['"'] = { 0, 1 };
-	charMap['#'] = { 0, 2 };
-	charMap['$'] = { 0, 3 };
-	charMap['%'] = { 0, 4 };
-	charMap['&'] = { 0, 5 };
-	charMap['\''] = { 0, 6 };
-	charMap['['] = { 0, 7 };
-	charMap[']'] = { 0, 8 };
-	charMap['*'] = { 0, 9 };
-	charMap['+'] = { 0, 10 };
-	charMap[','] = { 0, 11 };
-	charMap['-'] = { 0, 12 };
-	charMap['.'] = { 0, 13 };
-
-	// Second row (index 1,0 to 1,13)
-	charMap['/'] = { 1, 0 };
-	charMap['0'] = { 1, 1 };
-	charMap['1'] = { 1, 2 };
-	charMap['2'] = { 1, 3 };
-	charMap['3'] = { 1, 4 };
-	charMap['4'] = { 1, 5 };
-	charMap['5'] = { 1, 6 };
-	charMap['6'] = { 1, 7 };
-	charMap['7'] = { 1, 8 };
-	charMap['8'] = { 1, 9 };
-	charMap['9'] = { 1, 10 };
-	charMap[':'] = { 1, 11 };
-	charMap[';'] = { 1, 12 };
-	charMap['<'] = { 1, 13 };
-
-	// Third row
-	charMap['='] = { 2, 0 };
-	charMap['>'] = { 2, 1 };
-	charMap['?'] = { 2, 2 };
-	charMap['@'] = { 2, 3 };
-	charMap['A'] = { 2, 4 };
-	charMap['B'] = { 2, 5 };
-	charMap['C'] = { 2, 6 };
-	charMap['D'] = { 2, 7 };
-	charMap['E'] = { 2, 8 };
-	charMap['F'] = { 2, 9 };
-	charMap['G'] = { 2, 10 };
-	charMap['H'] = { 2, 11 };
-	charMap['I'] = { 2, 12 };
-	charMap['J'] = { 2, 13 };
-
-	// Fourth row
-	charMap['K'] = { 3, 0 };
-	charMap['L'] = { 3, 1 };
-	charMap['M'] = { 3, 2 };
-	charMap['N'] = { 3, 3 };
-	charMap['O'] = { 3, 4 };
-	charMap['P'] = { 3, 5 };
-	charMap['Q'] = { 3, 6 };
-	charMap['R'] = { 3, 7 };
-	charMap['S'] = { 3, 8 };
-	charMap['T'] = { 3, 9 };
-	charMap['U'] = { 3, 10 };
-	charMap['V'] = { 3, 11 };
-	charMap['W'] = { 3, 12 };
-	charMap['X'] = { 3, 13 };
-
-	// Fifth row
-	charMap['Y'] = { 4, 0 };
-	charMap['Z'] = { 4, 1 };
-	charMap['a'] = { 4, 2 };
-	charMap['b'] = { 4, 3 };
-	charMap['c'] = { 4, 4 };
-	charMap['d'] = { 4, 5 };
-	charMap['e'] = { 4, 6 };
-	charMap['f'] = { 4, 7 };
-	charMap['g'] = { 4, 8 };
-	charMap['h'] = { 4, 9 };
-	charMap['i'] = { 4, 10 };
-	charMap['j'] = { 4, 11 };
-	charMap['k'] = { 4, 12 };
-	charMap['l'] = { 4, 13 };
-
-	// Sixth row
-	charMap['m'] = { 5, 0 };
-	charMap['n'] = { 5, 1 };
-	charMap['o'] = { 5, 2 };
-	charMap['p'] = { 5, 3 };
-	charMap['q'] = { 5, 4 };
-	charMap['r'] = { 5, 5 };
-	charMap['s'] = { 5, 6 };
-	charMap['t'] = { 5, 7 };
-	charMap['u'] = { 5, 8 };
-	charMap['v'] = { 5, 9 };
-	charMap['w'] = { 5, 10 };
-	charMap['x'] = { 5, 11 };
-	charMap['y'] = { 5, 12 };
-	charMap['z'] = { 5, 13 };
-
-	// Special handling for space
-	charMap[' '] = { 0, 0 };
+	static const GlyphTable glyphs;
 
 	for (int i = 0; i < string.size(); i++) {
-		char letter = string.at(i);
-
-		// Handle spaces with reduced width
-		if (letter == ' ') {
-			continue; // Skip rendering, but position advances with spacing below
-		}
+		unsigned char letter = string[i];
 
-		// Check if we have a mapping for this character
-		if (charMap.find(letter) != charMap.end()) {
-			sf::FloatRect font_let = { 0, 0, CHAR_WIDTH, CHAR_HEIGHT };
-
-			// Get the row and column for this character
-			int row = charMap[letter].first;
-			int col = charMap[letter].second;
+		// Spaces and characters without a glyph just advance the position
+		if (letter >= 128 || glyphs.row[letter] < 0)
+			continue;
 
-			// Calculate position in the spritesheet
-			font_let.left = col * CHAR_WIDTH;
-			font_let.top = row * CHAR_HEIGHT;
+		// Calculate position in the spritesheet
+		sf::FloatRect font_let = { 0, 0, CHAR_WIDTH, CHAR_HEIGHT };
+		font_let.left = glyphs.col[letter] * CHAR_WIDTH;
+		font_let.top = glyphs.row[letter] * CHAR_HEIGHT;
 
-			// Draw the character with closer spacing
-			MakeQuad(RItems.text_va, x * TSIZE + SPACING * i, y * TSIZE, DISPLAY_WIDTH, DISPLAY_HEIGHT, color, font_let);
-		}
+		// Draw the character with closer spacing
+		MakeQuad(va, x * TSIZE + SPACING * i, y * TSIZE, DISPLAY_WIDTH, DISPLAY_HEIGHT, color, font_let);
 	}
 }
\ No newline at end of file
@@ -2,7 +2,11 @@
 #define RENDER_H
 #include "SFML/Graphics.hpp"
 #include "Buzzy.h"
+#include "StartupPlan.h"
+#include "TripleBuffer.h"
 #include <map>
+#include <bitset>
+#include <mutex>
 
 struct Textures
 {
@@ -16,6 +20,20 @@ struct Textures
 	sf::Texture buzzy_friends;
 	sf::Texture flower_t;
 };
+// Pre-wrapped glyph quads for one trivia question, built by the sim the first
+// time the question is dealt and kept, so its text is only wrapped once and
+// never while a frame is being drawn
+struct TriviaLayout
+{
+	// question lines followed by each answer's lines
+	sf::VertexArray question_va;
+	size_t answer_begin[4];
+	size_t answer_end[4];
+	int selected = -1;	// answer currently colored as selected
+
+	// empty where the answer has no explanation
+	sf::VertexArray explanation_va[trivia_max_answers];
+};
 struct RenderItems
 {
 	sf::VertexArray pellet_va;
@@ -39,47 +57,132 @@ struct RenderItems
 	// also keep index of power up pellets so they can be flashed
 	int pow_indicies[4];
 
+	// pellets currently visible in pellet_va, compared against each snapshot
+	std::bitset<28 * 31> shown_pellets;
+
 	sf::VertexArray text_va;
 
-	bool pow_is_off = false;
+	sf::VertexArray missing_explanation_va;
+};
+
+// Everything the renderer needs to draw one frame. The simulation fills
+// one of these at the end of every tick and publishes it through a triple
+// buffer, so the renderer never touches gState while the sim is mutating it.
+struct SpriteSnapshot
+{
+	sf::Vector2f pos;
+	sf::IntRect frame;
+	bool enable_draw = false;
+};
+struct FrameSnapshot
+{
+	State game_state = INSTR_SCREEN1;
+	bool pulse = true;
+
+	int game_score = 0;
+	int high_score = 0;
+	int player_lives = 0;
+
+	SpriteSnapshot player;
+	bool player_powered = false;
+	SpriteSnapshot ghosts[4];
+
+	bool player_eat_ghost = false;
+	int ghosts_eaten_in_powerup = 0;
+
+	// one bit per board tile (y * 28 + x), set while a pellet or flower is there
+	std::bitset<28 * 31> pellets;
+
+	TriviaLayout* trivia_layout = nullptr;	// the current question's, see FindTriviaLayout
+	int selected_trivia_answer = 0;
+	int explanation = -1;
+
+	uint32_t input_turn_id = 0;	// newest joystick turn in this frame, see InputLatency.h
+};
+
+// One station's render side. items is only touched by whichever thread is
+// drawing the station, frames is the hand-off from its sim.
+struct StationRender
+{
+	RenderItems items;
+	TripleBuffer<FrameSnapshot> frames;
+
+	// Sim side, by the question's number in the bank, only those dealt so
+	// far: the bank can have thousands. The renderer only gets at one through
+	// a snapshot, and std::map keeps it in place while more are added.
+	std::map<int, TriviaLayout> trivia_layouts;
+	bool capture_started = false;
+
+	// resize events arrive on the main thread but the view belongs to the renderer
+	std::mutex viewport_mutex;
+	sf::FloatRect pending_viewport;
+	bool viewport_changed = false;
 };
 
 const int font_width = 14;
+const sf::Color trivia_text_color = { 204, 85, 0 };	// burnt orange
 
 // pellet rects
 const sf::FloatRect pel_r = { 0,0,16,16 };
 const sf::FloatRect pow_r = { 16,0,16,16 };
 
+// Steps that load the shared textures, see StartupPlan.h. Done with
+// first_screen, InitFirstScreen can run, with all the rest can.
+struct TextureSteps
+{
+	int first_screen;
+	int all;
+};
+TextureSteps PlanTextures(StartupPlan& plan, int after);
+
+void InitFirstScreen();
 void InitRender();
 void InitWalls();
-void InitTextures();
 void InitPellets();
-void ResetPellets();
-void RemovePellet(int x, int y);
+void InitTriviaLayouts();
+TriviaLayout& LayoutTriviaQuestion(const TriviaQuestion& question);
+// sim side: the question's layout, laid out now if it's new. nullptr for no question.
+TriviaLayout* FindTriviaLayout(const TriviaQuestion& question);
 void MakeQuad(sf::VertexArray& va, float x, float y, int w, int h,
 	sf::Color color = { 255,255,255 }, sf::FloatRect tex_rect = { 0,0,0,0 });
-void DrawGameUI();
-void DrawFrame();
-void DrawTriviaQuestion();
-void DrawTriviaExplanationScreen(bool was_correct);
 
-std::vector<std::string> WrapText(const std::string& text, size_t line_length);
+struct Station;
+
+// sim side: copy the station's game state into the next snapshot and publish it
+void PublishFrame(Station& station);
 
-void FlashPPellets();
-void ResetPPelletFlash();
+// render side, on any thread: draws and presents the station's newest
+// snapshot, false if the sim hasn't published one since. The window's GL
+// context is only active during the call, so the next frame can be drawn
+// from another thread. Only one thread may draw a station at a time.
+bool RenderStation(Station& station);
+// frame capture teardown, after the station's last frame
+void StopRender(Station& station);
+// main thread
+void SetRenderViewport(Station& station, const sf::FloatRect& viewport);
+
+void RenderFrame(const FrameSnapshot& snap);
+void ApplyPellets(const FrameSnapshot& snap);
+void DrawGameUI(const FrameSnapshot& snap);
+void DrawFrame(const FrameSnapshot& snap);
+void DrawTriviaQuestion(const FrameSnapshot& snap);
+void DrawTriviaExplanationScreen(const FrameSnapshot& snap, bool was_correct);
+
+std::vector<std::string> WrapText(const std::string& text, size_t line_length);
 
-void DrawInstructionScreen1();
-void DrawInstructionScreen2();
-void DrawInstructionScreen3();
-void DrawInstructionScreen4();
-void DrawFinalInstructionScreen();
+void DrawInstructionScreen1(const FrameSnapshot& snap);
+void DrawInstructionScreen2(const FrameSnapshot& snap);
+void DrawInstructionScreen3(const FrameSnapshot& snap);
+void DrawInstructionScreen4(const FrameSnapshot& snap);
+void DrawFinalInstructionScreen(const FrameSnapshot& snap);
 
 // Text drawing
 // Ive tried using SFML's text class in the past but it ends up
 // looking blurry at low resolution, this is a simple way of drawing text
 // using the original lettering
 void ClearText();
-void MakeText(std::string string, float x, float y, sf::Color f_color);
+void MakeText(const std::string& string, float x, float y, sf::Color f_color);
+void MakeText(sf::VertexArray& va, const std::string& string, float x, float y, sf::Color f_color);
 
 
 #endif // !RENDER_H
\ No newline at end of file
@@ -0,0 +1,391 @@
+#include "SerialCapture.h"
+#include "Log.h"
+#include "Clock.h"
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+const uint64_t capture_flush_interval_us = 1000000;
+
+static void PutVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char)(uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)(uint8_t)value;
+}
+
+static bool GetVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t byte = (uint8_t)in[pos++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool ReadSerialCapture(const char* path, std::vector<CaptureRecord>& records, uint64_t* startedUnixMs) {
+    FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        LOG_ERROR("Can't open serial capture {}", path);
+        return false;
+    }
+    std::string in;
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        in.append(chunk, n);
+    }
+    std::fclose(file);
+
+    const size_t header_size = sizeof(serial_capture_magic) + 1 + 8;
+    if (in.size() < header_size || std::memcmp(in.data(), serial_capture_magic, sizeof(serial_capture_magic)) != 0) {
+        LOG_ERROR("{} is not a serial capture", path);
+        return false;
+    }
+    if ((uint8_t)in[sizeof(serial_capture_magic)] != serial_capture_version) {
+        LOG_ERROR("Serial capture {} has unsupported version {}", path, (uint8_t)in[sizeof(serial_capture_magic)]);
+        return false;
+    }
+    if (startedUnixMs) {
+        uint64_t started = 0;
+        for (int i = 0; i < 8; i++) {
+            started |= (uint64_t)(uint8_t)in[sizeof(serial_capture_magic) + 1 + i] << (8 * i);
+        }
+        *startedUnixMs = started;
+    }
+
+    records.clear();
+    size_t pos = header_size;
+    uint64_t time = 0;
+    while (pos < in.size()) {
+        uint8_t type = (uint8_t)in[pos++];
+        uint64_t delta, length;
+        if (!GetVarint(in, pos, delta) || !GetVarint(in, pos, length) || length > in.size() - pos) {
+            // A recording cut off by a crash, keep what made it to disk
+            LOG_WARN("Serial capture {} is truncated after {} records", path, records.size());
+            break;
+        }
+        time += delta;
+        if (type >= CAPTURE_IN && type <= CAPTURE_BAUD) {
+            records.push_back({ (CaptureRecordType)type, time, in.substr(pos, (size_t)length) });
+        }
+        pos += (size_t)length;
+    }
+    return true;
+}
+
+//
+// Recording
+//
+
+class CapturingSerialPort : public SerialPort {
+public:
+    CapturingSerialPort(std::unique_ptr<SerialPort> inner, const char* path) : inner(std::move(inner)), path(path) {}
+    ~CapturingSerialPort() override { close(); }
+
+    bool open(const char* portName, unsigned long baudRate) override;
+    void close() override;
+    bool isOpen() const override { return inner->isOpen(); }
+    bool setBaudRate(unsigned long baudRate) override;
+    void purge() override { inner->purge(); }
+    int read(char* buffer, size_t size, int timeoutMs) override;
+    bool write(const void* data, size_t size) override;
+    int writeSome(const void* data, size_t size) override;
+    int pollHandle() const override { return inner->pollHandle(); }
+
+    // inner is open already, see RecordOpenSerialPort
+    void startRecording(unsigned long baudRate);
+
+private:
+    void record(CaptureRecordType type, const void* data, size_t size);
+    void recordBaud(unsigned long baudRate);
+
+    std::unique_ptr<SerialPort> inner;
+    std::string path;
+    std::mutex mutex;   // reads and writes come from different threads
+    FILE* file = nullptr;
+    std::string pending;
+    uint64_t lastUs = 0;
+    uint64_t lastFlushUs = 0;
+};
+
+bool CapturingSerialPort::open(const char* portName, unsigned long baudRate) {
+    if (!inner->open(portName, baudRate)) return false;
+
+    startRecording(baudRate);
+    return true;
+}
+
+void CapturingSerialPort::startRecording(unsigned long baudRate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        // Still play, just without the recording
+        LOG_ERROR("Can't create serial capture {}", path);
+        return;
+    }
+
+    uint64_t started = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string header(serial_capture_magic, sizeof(serial_capture_magic));
+    header += (char)serial_capture_version;
+    for (int i = 0; i < 8; i++) {
+        header += (char)(uint8_t)(started >> (8 * i));
+    }
+    std::fwrite(header.data(), 1, header.size(), file);
+    lastUs = lastFlushUs = MonotonicUs();
+    LOG_INFO("Recording serial traffic to {}", path);
+
+    recordBaud(baudRate);
+}
+
+void CapturingSerialPort::close() {
+    inner->close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file) {
+        std::fwrite(pending.data(), 1, pending.size(), file);
+        std::fclose(file);
+        file = nullptr;
+        pending.clear();
+    }
+}
+
+bool CapturingSerialPort::setBaudRate(unsigned long baudRate) {
+    if (!inner->setBaudRate(baudRate)) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    recordBaud(baudRate);
+    return true;
+}
+
+int CapturingSerialPort::read(char* buffer, size_t size, int timeoutMs) {
+    int result = inner->read(buffer, size, timeoutMs);
+    if (result > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        record(CAPTURE_IN, buffer, (size_t)result);
+    }
+    return result;
+}
+
+bool CapturingSerialPort::write(const void* data, size_t size) {
+    // Recorded before the write so the Arduino's answer can't get in first
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        record(CAPTURE_OUT, data, size);
+    }
+    return inner->write(data, size);
+}
+
+int CapturingSerialPort::writeSome(const void* data, size_t size) {
+    // Only the hub writes this way, and it reads on the same thread, so
+    // recording after the write keeps the order
+    int written = inner->writeSome(data, size);
+    if (written > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        record(CAPTURE_OUT, data, (size_t)written);
+    }
+    return written;
+}
+
+void CapturingSerialPort::recordBaud(unsigned long baudRate) {
+    uint8_t payload[4];
+    for (int i = 0; i < 4; i++) {
+        payload[i] = (uint8_t)(baudRate >> (8 * i));
+    }
+    record(CAPTURE_BAUD, payload, sizeof(payload));
+}
+
+// Called with mutex held. Records are batched and written at most once a
+// second, the reader thread shouldn't wait on the disk for every line.
+void CapturingSerialPort::record(CaptureRecordType type, const void* data, size_t size) {
+    if (!file) return;
+
+    uint64_t now = MonotonicUs();
+    pending += (char)type;
+    PutVarint(pending, now - lastUs);
+    PutVarint(pending, size);
+    pending.append((const char*)data, size);
+    lastUs = now;
+
+    if (now - lastFlushUs >= capture_flush_interval_us) {
+        std::fwrite(pending.data(), 1, pending.size(), file);
+        std::fflush(file);
+        pending.clear();
+        lastFlushUs = now;
+    }
+}
+
+std::unique_ptr<SerialPort> CreateCapturingSerialPort(std::unique_ptr<SerialPort> inner, const char* path) {
+    return std::unique_ptr<SerialPort>(new CapturingSerialPort(std::move(inner), path));
+}
+
+std::unique_ptr<SerialPort> RecordOpenSerialPort(std::unique_ptr<SerialPort> opened, const char* path, unsigned long baudRate) {
+    CapturingSerialPort* port = new CapturingSerialPort(std::move(opened), path);
+    port->startRecording(baudRate);
+    return std::unique_ptr<SerialPort>(port);
+}
+
+std::unique_ptr<SerialPort> CreateSerialPortFor(const char* portName) {
+    return CreateSerialPortFor(portName, SerialCapturePath());
+}
+
+std::unique_ptr<SerialPort> CreateSerialPortFor(const char* portName, const char* capturePath) {
+    std::unique_ptr<SerialPort> port;
+    if (std::strncmp(portName, replay_port_prefix, std::strlen(replay_port_prefix)) == 0) {
+        port.reset(new ReplaySerialPort(true));
+    }
+    else {
+        port = CreateSerialPort();
+    }
+
+    if (capturePath) {
+        port = CreateCapturingSerialPort(std::move(port), capturePath);
+    }
+    return port;
+}
+
+//
+// Replay
+//
+
+bool ReplaySerialPort::open(const char* portName, unsigned long) {
+    close();
+
+    const char* path = portName;
+    if (std::strncmp(path, replay_port_prefix, std::strlen(replay_port_prefix)) == 0) {
+        path += std::strlen(replay_port_prefix);
+    }
+    if (!ReadSerialCapture(path, records)) {
+        return false;
+    }
+
+    outBefore.resize(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        outBefore[i] = expectedOut.size();
+        if (records[i].type == CAPTURE_OUT) {
+            expectedOut += records[i].data;
+        }
+    }
+
+    consumed = 0;
+    offsetUs = (int64_t)MonotonicUs();
+    skipToInbound(0);
+    loaded = true;
+    LOG_INFO("Replaying {} serial records from {}{}", records.size(), path, realtime ? "" : " as fast as possible");
+    return true;
+}
+
+void ReplaySerialPort::close() {
+    loaded = false;
+    records.clear();
+    outBefore.clear();
+    expectedOut.clear();
+    nextIn = 0;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    written = 0;
+}
+
+void ReplaySerialPort::skipToInbound(size_t from) {
+    while (from < records.size() && records[from].type != CAPTURE_IN) {
+        from++;
+    }
+    nextIn = from;
+}
+
+int ReplaySerialPort::read(char* buffer, size_t size, int timeoutMs) {
+    uint64_t now = MonotonicUs();
+    uint64_t deadline = now + (uint64_t)timeoutMs * 1000;
+    size_t index = nextIn;
+
+    if (index >= records.size()) {
+        // Recording played out, the line just stays quiet
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return 0;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(writeMutex);
+
+        // Held back by whoever drives a fast replay
+        if (index >= limit) {
+            if (!writeCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return index < limit; })) {
+                return 0;
+            }
+        }
+
+        // Wait for the game to catch up with what it had sent by this point
+        if (written < outBefore[index]) {
+            if (stalledSince == 0) stalledSince = now;
+            bool caughtUp = writeCv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                [&] { return written >= outBefore[index]; });
+            if (!caughtUp) {
+                if (MonotonicUs() - stalledSince < (uint64_t)replay_stall_timeout_ms * 1000) {
+                    return 0;
+                }
+                stallCount++;
+                LOG_WARN("Serial replay: game never sent what it sent before record {}, going on without it", index);
+            }
+        }
+    }
+    stalledSince = 0;
+
+    const CaptureRecord& rec = records[index];
+    if (realtime) {
+        now = MonotonicUs();
+        uint64_t due = (uint64_t)((int64_t)rec.time_us + offsetUs);
+        if (due > deadline) {
+            std::this_thread::sleep_for(std::chrono::microseconds(deadline - now));
+            return 0;
+        }
+        if (due > now) {
+            std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+        }
+        else {
+            // Late because the game was slower than live, keep the gaps that follow
+            offsetUs = (int64_t)now - (int64_t)rec.time_us;
+        }
+    }
+
+    size_t length = std::min(size, rec.data.size() - consumed);
+    std::memcpy(buffer, rec.data.data() + consumed, length);
+    consumed += length;
+    if (consumed == rec.data.size()) {
+        consumed = 0;
+        skipToInbound(index + 1);
+    }
+    return (int)length;
+}
+
+void ReplaySerialPort::holdAt(size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        limit = index;
+    }
+    writeCv.notify_all();
+}
+
+bool ReplaySerialPort::write(const void* data, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const char* bytes = (const char*)data;
+        uint64_t different = 0;
+        for (size_t i = 0; i < size; i++) {
+            uint64_t at = written + i;
+            if (at >= expectedOut.size() || expectedOut[(size_t)at] != bytes[i]) {
+                different++;
+            }
+        }
+        if (different > 0 && mismatched == 0) {
+            LOG_WARN("Serial replay: game output differs from the recording at byte {}", written);
+        }
+        mismatched += different;
+        written += size;
+    }
+    writeCv.notify_all();
+    return true;
+}
@@ -0,0 +1,114 @@
+#ifndef SERIALCAPTURE_H
+#define SERIALCAPTURE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SerialPort.h"
+
+// Recording and replaying the traffic between the game and the Arduino.
+//
+// With BUZZY_SERIAL_CAPTURE=file set, everything read from and written to the
+// port is recorded. A port name of "replay:file" (BUZZY_SERIAL_PORT, or
+// tools/SerialReplay.cpp) plays a recording back into SerialController.
+//
+// File layout: "BZCAP", a version byte and the wall clock time the recording
+// started (unix ms, 8 bytes little endian), then one record per read, write or
+// baud change: type byte, varint microseconds since the previous record,
+// varint length, payload. Inbound records are exactly what each read returned,
+// so a replay cuts the stream where the live port did.
+
+enum CaptureRecordType : uint8_t {
+    CAPTURE_IN = 1,     // bytes from the Arduino
+    CAPTURE_OUT = 2,    // bytes to the Arduino
+    CAPTURE_BAUD = 3,   // new baud rate, 4 bytes little endian
+};
+
+struct CaptureRecord {
+    CaptureRecordType type;
+    uint64_t time_us;   // since the recording started
+    std::string data;
+};
+
+const char serial_capture_magic[5] = { 'B', 'Z', 'C', 'A', 'P' };
+const uint8_t serial_capture_version = 1;
+const char* const replay_port_prefix = "replay:";
+const int replay_stall_timeout_ms = 2000;   // give up waiting for the game to send what it sent live
+
+inline const char* SerialCapturePath() {
+    const char* env = std::getenv("BUZZY_SERIAL_CAPTURE");
+    return (env && *env) ? env : nullptr;
+}
+
+bool ReadSerialCapture(const char* path, std::vector<CaptureRecord>& records, uint64_t* startedUnixMs = nullptr);
+
+// Wraps a port and records everything that goes through it to path
+std::unique_ptr<SerialPort> CreateCapturingSerialPort(std::unique_ptr<SerialPort> inner, const char* path);
+// Same for a port that is open already, e.g. one SerialSupervisor found.
+// Recording starts now, at baudRate.
+std::unique_ptr<SerialPort> RecordOpenSerialPort(std::unique_ptr<SerialPort> opened, const char* path, unsigned long baudRate);
+
+// A real port, or a replay for "replay:" names. Recorded when
+// BUZZY_SERIAL_CAPTURE is set.
+std::unique_ptr<SerialPort> CreateSerialPortFor(const char* portName);
+// Same, recorded to capturePath unless it's null
+std::unique_ptr<SerialPort> CreateSerialPortFor(const char* portName, const char* capturePath);
+
+// Plays the inbound side of a recording. An inbound record is held back until
+// the game has written as many bytes as it had written live before it, so
+// acks never overtake their command however fast the replay runs. Writes are
+// compared with the recording and counted when they differ.
+class ReplaySerialPort : public SerialPort {
+public:
+    // realtime: keep the recorded gaps between reads, else as fast as possible
+    explicit ReplaySerialPort(bool realtime) : realtime(realtime) {}
+
+    // portName is "replay:file" or just the file
+    bool open(const char* portName, unsigned long baudRate) override;
+    void close() override;
+    bool isOpen() const override { return loaded; }
+    bool setBaudRate(unsigned long) override { return true; }
+    void purge() override {}
+    int read(char* buffer, size_t size, int timeoutMs) override;
+    bool write(const void* data, size_t size) override;
+
+    bool finished() const { return nextIn >= records.size(); }
+    // Index of the next inbound record to be delivered, records before it are done
+    size_t position() const { return nextIn; }
+    const std::vector<CaptureRecord>& recording() const { return records; }
+    // Records from index on wait until the limit is raised again. A fast replay
+    // releases a few at a time, or the reader fills SerialController's queue.
+    void holdAt(size_t index);
+    uint64_t mismatchedBytes() const { return mismatched; }
+    unsigned stalls() const { return stallCount; }
+
+private:
+    void skipToInbound(size_t from);
+
+    bool realtime;
+    bool loaded = false;
+    std::vector<CaptureRecord> records;
+    std::vector<uint64_t> outBefore;    // bytes the game wrote before record i
+    std::string expectedOut;            // everything the game wrote, in order
+
+    // Reader thread only
+    std::atomic<size_t> nextIn{ 0 };
+    size_t consumed = 0;                // of records[nextIn], when a read took part of it
+    int64_t offsetUs = 0;               // recording time + offset = replay time
+    uint64_t stalledSince = 0;
+    std::atomic<unsigned> stallCount{ 0 };
+
+    // Shared with the writer thread
+    std::mutex writeMutex;
+    std::condition_variable writeCv;
+    uint64_t written = 0;
+    size_t limit = SIZE_MAX;
+    std::atomic<uint64_t> mismatched{ 0 };
+};
+
+#endif // SERIALCAPTURE_H
@@ -1,23 +1,61 @@
 #include "SerialController.h"
-#include <iostream>
+#include "Log.h"
+#include "SerialCapture.h"
+#include "SerialHub.h"
+#include "SerialSupervisor.h"
+#include "Clock.h"
 #include <thread>
 #include <chrono>
 #include <string>
+#include <cstring>
 
-// These globals are preserved
-bool gameStartButtonPressed = false;
-std::string lastMessage;
+// Lines that say the same button press several ways arrive within a few ms of
+// each other, the sketch itself debounces presses to 300 ms
+const uint64_t button_merge_window_us = 150000;
 
 SerialController::SerialController() :
-    hSerial(INVALID_HANDLE_VALUE),
     connected(false),
     joyUp(false),
     joyDown(false),
     joyLeft(false),
     joyRight(false),
+    stickX(0),
+    stickY(0),
+    stickSeen(false),
     buttonPressed(false),
+    gameStartButtonPressed(false),
+    selectionChanged(false),
     selectedAnswer(1),
-    resetGameRequested(false) {
+    resetGameRequested(false),
+    hub(nullptr),
+    onHub(false),
+    logStation(0),
+    hubWritable(false),
+    supervisor(nullptr),
+    portLost(false),
+    readerRunning(false),
+    droppedEvents(0),
+    lastButtonEventTime(0),
+    protocol(PROTOCOL_TEXT),
+    frameLength(0),
+    protocolVersion(0),
+    pendingInputAge(-1),
+    lastDirectionSeq(-1),
+    directionSeqGaps(0),
+    writerRunning(false),
+    boardReady(false),
+    bootDeadline(0),
+    awaitingAck(false),
+    ackReceived(false),
+    ackDeadline(0),
+    attempt(0),
+    inFlight{ SERIAL_CMD_GAME_RESET, 0 },
+    boardAnswering(false),
+    ledsWanted(0),
+    ledsShown(0),
+    requestedMode(CONTROLLER_STEERING),
+    confirmedMode(CONTROLLER_STEERING),
+    ledsSet(0) {
 }
 
 SerialController::~SerialController() {
@@ -25,180 +63,537 @@ SerialController::~SerialController() {
 }
 
 bool SerialController::initialize(const char* portName) {
-    std::cout << "Connecting to Arduino on " << portName << "..." << std::endl;
+    return initialize(portName, CreateSerialPortFor(portName, captureFile()));
+}
+
+bool SerialController::initialize(const char* portName, std::unique_ptr<SerialPort> withPort) {
+    LOG_INFO("Connecting to Arduino on {}...", portName);
 
     // Close any existing connection
     if (connected) {
         disconnect();
     }
 
-    // Format COM port name correctly for Windows
-    std::string fullPortName = std::string("\\\\.\\") + portName;
+    this->portName = portName;
+    bool replay = std::strncmp(portName, replay_port_prefix, std::strlen(replay_port_prefix)) == 0;
+    bool discover = std::strcmp(portName, auto_serial_port) == 0;
+    bool supervised = supervisor && !replay;
 
-    // Open the serial port
-    hSerial = CreateFileA(fullPortName.c_str(),
-        GENERIC_READ | GENERIC_WRITE,
-        0,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
+    // Always start in text, the binary protocol is negotiated once the sketch is up
+    bool opened = !discover && withPort->open(portName, serial_text_baud);
+    if (!opened && !supervised) {
+        if (discover) {
+            LOG_ERROR("Nothing to look for the Arduino with, name its port");
+        }
+        return false;
+    }
 
-    if (hSerial == INVALID_HANDLE_VALUE) {
-        DWORD error = GetLastError();
-        std::cerr << "Error opening serial port! Error code: " << error << std::endl;
+    // Nothing else runs yet, so no need for the lock
+    connected = true;
+    requestedMode = CONTROLLER_STEERING;
+    confirmedMode = CONTROLLER_STEERING;
+    commands.clear();
+    awaitingAck = false;
+    boardAnswering = false;
+    // The sketch turns the strip off as it boots
+    ledsWanted = 0;
+    ledsShown = 0;
+    ledsSet = 0;
+
+    if (!opened) {
+        // Carry on without it, the supervisor attaches the board once it turns up
+        portLost = true;
+        supervisor->watch(this, nullptr);
+        LOG_INFO(discover ? "Looking for the Arduino in the background" : "Waiting for the Arduino to show up on {}", portName);
         return false;
     }
 
-    // Set serial port parameters
-    DCB dcbSerialParams = { 0 };
-    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    port = std::move(withPort);
 
-    if (!GetCommState(hSerial, &dcbSerialParams)) {
-        std::cerr << "Error getting serial port state!" << std::endl;
-        CloseHandle(hSerial);
-        return false;
+    // Clear any existing data
+    port->purge();
+    portLost = false;
+    LOG_INFO("Successfully connected to Arduino on {}", portName);
+
+    // Opening the port resets the Arduino. Rather than sleeping through its
+    // boot, the writer holds queued commands until the sketch prints READY.
+    resetLink();
+    boardReady = false;
+    bootDeadline = MonotonicMs() + serial_boot_timeout_ms;
+    startIo();
+
+    // First thing once the sketch is ready, older sketches just ignore it
+    queueCommand(SERIAL_CMD_PROTOCOL, serial_protocol_version);
+
+    if (supervised) {
+        supervisor->watch(this, portName);
     }
+    return true;
+}
 
-    dcbSerialParams.BaudRate = CBR_9600;
-    dcbSerialParams.ByteSize = 8;
-    dcbSerialParams.StopBits = ONESTOPBIT;
-    dcbSerialParams.Parity = NOPARITY;
+void SerialController::disconnect() {
+    if (connected) {
+        if (supervisor) {
+            // Returns once the supervisor is out of this controller for good
+            supervisor->unwatch(this);
+        }
+        stopIo();
+        port.reset();
+        connected = false;
+        portLost = false;
+        LOG_INFO("Disconnected from Arduino");
+    }
+}
 
-    if (!SetCommState(hSerial, &dcbSerialParams)) {
-        std::cerr << "Error setting serial port state!" << std::endl;
-        CloseHandle(hSerial);
-        return false;
+// Reading and writing on the port, by the hub or on threads of our own.
+// Replays and Windows ports can't be polled, they always get threads.
+void SerialController::startIo() {
+    onHub = hub && port->pollHandle() >= 0 && hub->add(this);
+    if (!onHub) {
+        readerRunning = true;
+        readerThread = std::thread(&SerialController::readerLoop, this);
+        writerRunning = true;
+        writerThread = std::thread(&SerialController::writerLoop, this);
     }
+}
 
-    // Set timeouts
-    COMMTIMEOUTS timeouts = { 0 };
-    timeouts.ReadIntervalTimeout = MAXDWORD;
-    timeouts.ReadTotalTimeoutMultiplier = 0;
-    timeouts.ReadTotalTimeoutConstant = 0;
-    timeouts.WriteTotalTimeoutMultiplier = 0;
-    timeouts.WriteTotalTimeoutConstant = 0;
+void SerialController::stopIo() {
+    if (onHub) {
+        // Returns once the hub thread is out of this controller for good
+        hub->remove(this);
+        onHub = false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        writerRunning = false;
+    }
+    commandCv.notify_all();
+    if (writerThread.joinable()) {
+        writerThread.join();
+    }
 
-    if (!SetCommTimeouts(hSerial, &timeouts)) {
-        std::cerr << "Error setting timeouts!" << std::endl;
-        CloseHandle(hSerial);
-        return false;
+    readerRunning = false;
+    if (readerThread.joinable()) {
+        readerThread.join();
     }
+}
 
-    // Clear any existing data
-    PurgeComm(hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
+// Reader side state for a freshly opened port, with I/O stopped
+void SerialController::resetLink() {
+    hubOutput.clear();
+    hubWritable = false;
+    lineParser.Reset();
+    frameLength = 0;
+    protocol = PROTOCOL_TEXT;
+    protocolVersion = 0;
+    pendingInputAge = -1;
+    lastDirectionSeq = -1;
+}
 
-    connected = true;
-    std::cout << "Successfully connected to Arduino on " << portName << std::endl;
+// Reader thread or hub, on a failed read. Usually the board was unplugged.
+void SerialController::markPortLost() {
+    if (portLost.exchange(true)) return;
 
-    // Wait for Arduino to reset
-    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+    LOG_ERROR("Lost the Arduino, holding commands until it is back");
+    if (supervisor) {
+        supervisor->wake();
+    }
+}
 
-    return true;
+// The supervisor, with I/O stopped: a port it found the sketch on, which has
+// printed its READY banner already. Whatever was queued meanwhile is replaced
+// by the commands that bring the board back to where the game left it, the
+// flowers follow by themselves.
+void SerialController::attachPort(std::unique_ptr<SerialPort> newPort) {
+    port = std::move(newPort);
+    resetLink();
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.clear();
+        awaitingAck = false;
+        boardReady = true;
+        commands.push_back({ SERIAL_CMD_PROTOCOL, serial_protocol_version });
+        // Steering too, the game may be waiting for its ack
+        commands.push_back({ boardAnswering ? SERIAL_CMD_MODE_ANSWERING : SERIAL_CMD_MODE_STEERING, 0 });
+        ledsShown = 0;
+    }
+    portLost = false;
+    startIo();
 }
 
-void SerialController::disconnect() {
-    if (connected) {
-        CloseHandle(hSerial);
-        hSerial = INVALID_HANDLE_VALUE;
-        connected = false;
-        std::cout << "Disconnected from Arduino" << std::endl;
+const char* SerialController::captureFile() const {
+    return capturePath.empty() ? SerialCapturePath() : capturePath.c_str();
+}
+
+void SerialController::readerLoop() {
+    SetLogStation(logStation);
+
+    // Nothing more will come from a failed port, the supervisor replaces it
+    while (readerRunning) {
+        if (readAvailable(serial_read_timeout_ms) < 0) {
+            break;
+        }
     }
 }
 
-void SerialController::update() {
-    if (!connected) return;
+// Reads whatever arrives within timeoutMs and queues the events in it.
+// Returns the number of bytes read, -1 if the port failed.
+int SerialController::readAvailable(int timeoutMs) {
+    char buffer[256];
 
-    // Reset transient states
-    buttonPressed = false;
-    gameStartButtonPressed = false;
+    int result = port->read(buffer, sizeof(buffer), timeoutMs);
+    if (result < 0) {
+        markPortLost();
+    }
+    if (result <= 0) {
+        return result;
+    }
+    size_t bytesRead = (size_t)result;
 
-    // DO NOT reset joystick flags here - they need to persist
-    // joyUp = false;
-    // joyDown = false;
-    // joyLeft = false;
-    // joyRight = false;
-    resetGameRequested = false;
+    // Text: the parser reassembles lines however the reads cut them
+    size_t used = 0;
+    while (used < bytesRead && protocol == PROTOCOL_TEXT) {
+        used += lineParser.Feed(buffer + used, bytesRead - used);
 
-    char buffer[256] = { 0 };
-    DWORD bytesRead = 0;
+        std::string_view line;
+        while (protocol == PROTOCOL_TEXT && lineParser.NextLine(line)) {
+            processLine(line);
+        }
+    }
 
-    // Read from serial port
-    if (ReadFile(hSerial, buffer, sizeof(buffer) - 1, &bytesRead, NULL)) {
-        if (bytesRead > 0) {
-            buffer[bytesRead] = '\0'; // Null terminate
-            std::string input(buffer);
+    // Binary, possibly switched to halfway through this read. Whatever
+    // followed PROTO:BINARY OK at the old baud rate is noise the frame
+    // parser skips.
+    if (protocol != PROTOCOL_TEXT) {
+        lineParser.Reset();
+        for (size_t i = used; i < bytesRead; i++) {
+            processFrameByte((uint8_t)buffer[i]);
+        }
+    }
+    return result;
+}
 
-            // Only process if not empty
-            if (!input.empty()) {
-                lastMessage = input; // Store for debugging
+void SerialController::processLine(std::string_view line) {
+    if (line.empty()) return;
 
-                // Always log raw input for debugging
-                std::cout << "ARDUINO RAW: [" << input << "]" << std::endl;
+    uint64_t now = LogTimestamp();
+    LOG_DEBUG("ARDUINO RAW: [{}]", line);
 
-                // Check for reset command
-                if (input.find("RESET_GAME") != std::string::npos) {
-                    resetGameRequested = true;
-                    std::cout << "Game reset requested via button hold" << std::endl;
-                }
+    SerialEventType type;
+    int value;
+    if (!ParseSerialLine(line, type, value)) return;
 
-                // Check for button press in any form
-                if (input.find("Button") != std::string::npos ||
-                    input.find("NextScreen") != std::string::npos ||
-                    input.find("Answering") != std::string::npos) {
+    switch (type) {
+    case SERIAL_PROTOCOL_ACCEPT:
+        // The sketch switches baud rate right after this line
+        if (setBaudRate(serial_binary_baud)) {
+            frameLength = 0;
+            protocol = PROTOCOL_NEGOTIATING;
+        }
+        break;
+    case SERIAL_READY_STEERING:
+    case SERIAL_READY_ANSWERING:
+    case SERIAL_FLOWER_SET:
+    case SERIAL_LEDS_SET:
+        onAck(type, value);
+        pushEvent(type, value, now);
+        break;
+    case SERIAL_UP:
+    case SERIAL_DOWN:
+    case SERIAL_LEFT:
+    case SERIAL_RIGHT:
+        // The line plus CR LF, 10 bits a byte
+        pushDirection(type, now, -1, -1, (int)((line.size() + 2) * 10 * 1000000 / serial_text_baud));
+        break;
+    case SERIAL_BUTTON:
+        // "Button pressed in answering mode: 2", "Button", "NextScreen" and
+        // "Answering" all describe the same press, only report it once
+        if (now - lastButtonEventTime > button_merge_window_us) {
+            pushEvent(SERIAL_BUTTON, value, now);
+        }
+        lastButtonEventTime = now;
+        break;
+    default:
+        pushEvent(type, value, now);
+        break;
+    }
+}
 
-                    buttonPressed = true;
-                    gameStartButtonPressed = true; // For compatibility
-                    std::cout << "BUTTON DETECTED IN MESSAGE" << std::endl;
-                }
+void SerialController::processFrameByte(uint8_t byte) {
+    // Skip to the next sync byte, there's no other framing
+    if (frameLength == 0 && byte != frame_sync) return;
 
-                // Check for joystick directions - directly check for keywords
-                // Use direct string matching to catch any case
+    frameBuffer[frameLength++] = byte;
+    if (frameLength < frame_size) return;
 
-                // Looking for "Up" but not when it's part of "Selected: "
-                if ((input.find("Up") != std::string::npos) &&
-                    (input.find("Selected") == std::string::npos)) {
-                    joyUp = true;
-                    std::cout << "UP DETECTED IN MESSAGE" << std::endl;
-                }
+    if (FrameCrc(frameBuffer[1], frameBuffer[2]) == frameBuffer[3]) {
+        frameLength = 0;
+        processFrame(frameBuffer[1], frameBuffer[2]);
+        return;
+    }
 
-                // Looking for "Down" but not when it's part of "Selected: "
-                if ((input.find("Down") != std::string::npos) &&
-                    (input.find("Selected") == std::string::npos)) {
-                    joyDown = true;
-                    std::cout << "DOWN DETECTED IN MESSAGE" << std::endl;
-                }
+    // Bad CRC, the sync byte was probably data. Retry from the next one.
+    LOG_DEBUG("Dropping serial frame with bad CRC");
+    int next = 1;
+    while (next < frame_size && frameBuffer[next] != frame_sync) next++;
+    frameLength = frame_size - next;
+    std::memmove(frameBuffer, frameBuffer + next, frameLength);
+}
 
-                // Looking for "Left"
-                if (input.find("Left") != std::string::npos) {
-                    joyLeft = true;
-                    std::cout << "LEFT DETECTED IN MESSAGE" << std::endl;
-                }
+void SerialController::processFrame(uint8_t type, uint8_t value) {
+    uint64_t now = LogTimestamp();
 
-                // Looking for "Right"
-                if (input.find("Right") != std::string::npos) {
-                    joyRight = true;
-                    std::cout << "RIGHT DETECTED IN MESSAGE" << std::endl;
-                }
+    switch (type) {
+    case FRAME_HELLO:
+        if (value < serial_protocol_min_version || value > serial_protocol_version) {
+            LOG_WARN("Arduino speaks binary protocol version {}, expected {}", value, serial_protocol_version);
+            return;
+        }
+        if (protocol != PROTOCOL_BINARY) {
+            protocol = PROTOCOL_BINARY;
+            protocolVersion = value;
+            LOG_INFO("Arduino switched to binary protocol version {} at {} baud", value, serial_binary_baud);
+        }
+        // The sketch repeats HELLO until it hears one back
+        writeFrame(FRAME_HELLO, serial_protocol_version);
+        onAck(SERIAL_HELLO, value);
+        break;
+    case FRAME_INPUT_AGE:
+        pendingInputAge = value;
+        break;
+    case FRAME_DIRECTION: {
+        int seq = -1;
+        if (protocolVersion >= 2) {
+            seq = value >> 3;
+            value &= 0x07;
+        }
+        // One frame, two with the age in front
+        int bytes = pendingInputAge >= 0 ? 2 * frame_size : frame_size;
+        int wireUs = (int)(bytes * 10 * 1000000 / serial_binary_baud);
+        switch (value) {
+        case 1: pushDirection(SERIAL_UP, now, seq, pendingInputAge, wireUs); break;
+        case 2: pushDirection(SERIAL_RIGHT, now, seq, pendingInputAge, wireUs); break;
+        case 3: pushDirection(SERIAL_DOWN, now, seq, pendingInputAge, wireUs); break;
+        case 4: pushDirection(SERIAL_LEFT, now, seq, pendingInputAge, wireUs); break;
+        }
+        pendingInputAge = -1;
+        break;
+    }
+    case FRAME_STICK_X:
+    case FRAME_STICK_Y: {
+        SerialEvent ev = { type == FRAME_STICK_X ? SERIAL_STICK_X : SERIAL_STICK_Y, (int8_t)value, now };
+        ev.wire_us = (int)(frame_size * 10 * 1000000 / serial_binary_baud);
+        if (!events.Push(ev)) {
+            droppedEvents++;
+        }
+        break;
+    }
+    case FRAME_BUTTON:
+        pushEvent(SERIAL_BUTTON, value, now);
+        break;
+    case FRAME_SELECTED:
+        if (value >= 1 && value <= 4) {
+            pushEvent(SERIAL_SELECTED, value, now);
+        }
+        break;
+    case FRAME_RESET_GAME:
+        pushEvent(SERIAL_RESET_GAME, 0, now);
+        break;
+    case FRAME_READY: {
+        SerialEventType ready = value ? SERIAL_READY_ANSWERING : SERIAL_READY_STEERING;
+        onAck(ready, 0);
+        pushEvent(ready, 0, now);
+        break;
+    }
+    case FRAME_FLOWER_SET:
+        onAck(SERIAL_FLOWER_SET, value);
+        pushEvent(SERIAL_FLOWER_SET, value, now);
+        break;
+    case FRAME_LEDS_SET:
+        onAck(SERIAL_LEDS_SET, value);
+        pushEvent(SERIAL_LEDS_SET, value, now);
+        break;
+    default:
+        LOG_DEBUG("Unknown serial frame type {}", type);
+        break;
+    }
+}
 
-                // Process selected answer for trivia mode
-                size_t selectedPos = input.find("Selected: ");
-                if (selectedPos != std::string::npos && selectedPos + 10 < input.length()) {
-                    char answerChar = input[selectedPos + 10];
-                    if (answerChar >= '1' && answerChar <= '4') {
-                        selectedAnswer = answerChar - '0';
-                        std::cout << "Answer selection changed to: " << selectedAnswer << std::endl;
-                    }
-                }
-            }
+bool SerialController::writeFrame(uint8_t type, uint8_t value) {
+    uint8_t frame[frame_size];
+    BuildFrame(frame, type, value);
+
+    if (!send(frame, frame_size)) {
+        LOG_ERROR("Failed to send serial frame {}", type);
+        return false;
+    }
+    return true;
+}
+
+// On the hub nothing waits for the port: the bytes are queued and the hub
+// writes them as the port takes them. A port that has stopped taking them
+// fails the write, like a timed out write does on our own writer thread.
+bool SerialController::send(const void* data, size_t size) {
+    if (!onHub) {
+        return port->write(data, size);
+    }
+    if (hubOutput.size() + size > serial_hub_output_limit) {
+        return false;
+    }
+    hubOutput.append((const char*)data, size);
+    return true;
+}
+
+bool SerialController::setBaudRate(unsigned long baudRate) {
+    return port->setBaudRate(baudRate);
+}
+
+void SerialController::pushEvent(SerialEventType type, int value, uint64_t timestamp) {
+    SerialEvent ev = { type, value, timestamp };
+    if (!events.Push(ev)) {
+        droppedEvents++;
+    }
+}
+
+void SerialController::pushDirection(SerialEventType type, uint64_t timestamp, int seq, int sketchMs, int wireUs) {
+    // Reader thread only, so the gap count sees every frame even if the queue drops some
+    if (seq >= 0) {
+        if (lastDirectionSeq >= 0 && seq != ((lastDirectionSeq + 1) & direction_seq_mask)) {
+            directionSeqGaps++;
         }
+        lastDirectionSeq = seq;
+    }
+
+    SerialEvent ev = { type, 0, timestamp };
+    ev.seq = seq;
+    ev.sketch_ms = sketchMs;
+    ev.wire_us = wireUs;
+    if (!events.Push(ev)) {
+        droppedEvents++;
     }
+}
 
-    // For debugging - print current joystick state after update
-    //std::cout << "CURRENT JOYSTICK STATE: Up=" << joyUp
-    //    << " Down=" << joyDown
-    //    << " Left=" << joyLeft
-    //    << " Right=" << joyRight << std::endl;
+void SerialController::centerStick() {
+    stickX = 0;
+    stickY = 0;
+    stickSeen = false;
+}
+
+void SerialController::applyEvent(const SerialEvent& ev) {
+    switch (ev.type) {
+    case SERIAL_READY_STEERING:
+        // A mode change or a reboot, either way the sketch starts streaming over
+        confirmedMode = CONTROLLER_STEERING;
+        centerStick();
+        return;
+    case SERIAL_READY_ANSWERING:
+        confirmedMode = CONTROLLER_ANSWERING;
+        centerStick();
+        return;
+    case SERIAL_COMMAND_FAILED:
+        // Don't hold input back forever for an Arduino that stopped answering
+        if (ev.value != SERIAL_CMD_FLOWER && ev.value != SERIAL_CMD_LEDS) {
+            confirmedMode = requestedMode;
+        }
+        return;
+    case SERIAL_RESET_GAME:
+        resetGameRequested = true;
+        LOG_INFO("Game reset requested via button hold");
+        return;
+    default:
+        break;
+    }
+
+    // Sent before the Arduino switched to the mode we're in now
+    if (requestedMode != confirmedMode) {
+        LOG_DEBUG("Dropping input {} while waiting for mode ack", ev.type);
+        return;
+    }
+
+    switch (ev.type) {
+    case SERIAL_UP:
+    case SERIAL_DOWN:
+    case SERIAL_LEFT:
+    case SERIAL_RIGHT:
+    case SERIAL_STICK_X:
+    case SERIAL_STICK_Y:
+        lastDirection.seq = ev.seq;
+        lastDirection.sketch_ms = ev.sketch_ms;
+        lastDirection.wire_us = ev.wire_us;
+        lastDirection.read_us = ev.timestamp_us;
+        lastDirection.drained_us = LogTimestamp();
+        lastDirection.seq_gaps = directionSeqGaps;
+        break;
+    default:
+        break;
+    }
+
+    switch (ev.type) {
+    case SERIAL_UP:
+        joyUp = true;
+        LOG_DEBUG("UP DETECTED IN MESSAGE");
+        break;
+    case SERIAL_DOWN:
+        joyDown = true;
+        LOG_DEBUG("DOWN DETECTED IN MESSAGE");
+        break;
+    case SERIAL_LEFT:
+        joyLeft = true;
+        LOG_DEBUG("LEFT DETECTED IN MESSAGE");
+        break;
+    case SERIAL_RIGHT:
+        joyRight = true;
+        LOG_DEBUG("RIGHT DETECTED IN MESSAGE");
+        break;
+    case SERIAL_STICK_X:
+        stickX = ev.value;
+        stickSeen = true;
+        break;
+    case SERIAL_STICK_Y:
+        stickY = ev.value;
+        stickSeen = true;
+        break;
+    case SERIAL_BUTTON:
+        buttonPressed = true;
+        gameStartButtonPressed = true; // For compatibility
+        LOG_DEBUG("BUTTON DETECTED IN MESSAGE");
+        break;
+    case SERIAL_SELECTED:
+        selectedAnswer = ev.value;
+        selectionChanged = true;
+        LOG_DEBUG("Answer selection changed to: {}", selectedAnswer);
+        break;
+    default:
+        break;
+    }
+}
+
+void SerialController::update() {
+    if (!connected) return;
+
+    // Reset transient states, joystick flags persist until resetJoystickFlags
+    buttonPressed = false;
+    gameStartButtonPressed = false;
+    selectionChanged = false;
+    resetGameRequested = false;
+
+    SerialEvent ev;
+    while (failedCommands.Pop(ev)) {
+        applyEvent(ev);
+    }
+    while (events.Pop(ev)) {
+        applyEvent(ev);
+    }
+
+    // Nobody is holding a stick that isn't there
+    if (portLost) {
+        centerStick();
+    }
+
+    unsigned dropped = droppedEvents.exchange(0);
+    if (dropped > 0) {
+        LOG_WARN("Serial event queue full, dropped {} events", dropped);
+    }
 }
 
 bool SerialController::isGameStartPressed() const {
@@ -209,108 +604,323 @@ bool SerialController::isResetRequested() const {
     return resetGameRequested;
 }
 
-std::string SerialController::getLastMessage() const {
-    return lastMessage;
+void SerialController::writerLoop() {
+    SetLogStation(logStation);
+    std::unique_lock<std::mutex> lock(commandMutex);
+
+    while (writerRunning) {
+        int waitMs = pumpCommands(lock);
+        if (!writerRunning) break;
+
+        // Everything that gives pumpCommands more to do changes state under
+        // the lock and notifies, so nothing is missed between pump and wait
+        if (waitMs < 0) {
+            commandCv.wait(lock);
+        }
+        else {
+            commandCv.wait_for(lock, std::chrono::milliseconds(waitMs));
+        }
+    }
 }
 
-bool SerialController::setMode(const std::string& mode) {
-    if (!connected) return false;
+// Moves the command queue along: sends the next command, resends one whose ack
+// is late, gives up on it after the retries. Called with commandMutex held, by
+// the writer thread or the hub. Returns how long until it has to run again if
+// no ack or command comes in first, -1 for not at all.
+int SerialController::pumpCommands(std::unique_lock<std::mutex>& lock) {
+    // Nothing to send them on, attachPort starts over
+    if (portLost) {
+        return -1;
+    }
+
+    uint64_t now = MonotonicMs();
+
+    if (!boardReady) {
+        if (now < bootDeadline) {
+            return (int)(bootDeadline - now);
+        }
+        LOG_WARN("Arduino never reported READY, sending commands anyway");
+        boardReady = true;
+    }
+
+    for (;;) {
+        if (awaitingAck) {
+            if (ackReceived) {
+                finishCommand(true);
+                continue;
+            }
+            if (now < ackDeadline) {
+                return (int)(ackDeadline - now);
+            }
+
+            // Resending PROTO:BINARY makes no sense once the baud rate may have changed
+            int retries = inFlight.type == SERIAL_CMD_PROTOCOL ? 0 : serial_command_retries;
+            if (attempt >= retries) {
+                finishCommand(false);
+                continue;
+            }
+            attempt++;
+            LOG_WARN("No ack for serial command {} ({}), retry {}", inFlight.type, inFlight.value, attempt);
+        }
+        else {
+            // Queued commands first, the LEDs are state and can wait
+            if (!commands.empty()) {
+                inFlight = commands.front();
+                commands.pop_front();
+            }
+            else if (!nextLedCommand(inFlight)) {
+                return -1;
+            }
+            attempt = 0;
+            awaitingAck = true;
+        }
+        ackReceived = false;
+
+        // The ack can't be missed while unlocked, onAck checks awaitingAck
+        SerialCommand cmd = inFlight;
+        lock.unlock();
+        bool written = writeCommand(cmd);
+        lock.lock();
+
+        // A failed write goes straight to the next attempt
+        now = MonotonicMs();
+        ackDeadline = written ? now + serial_ack_timeout_ms : now;
+    }
+}
+
+// One message towards ledsWanted, false if the board shows it already
+bool SerialController::nextLedCommand(SerialCommand& cmd) const {
+    if (ledsWanted == ledsShown) {
+        return false;
+    }
+    if (protocol == PROTOCOL_BINARY && protocolVersion >= 3) {
+        cmd = { SERIAL_CMD_LEDS, (int)ledsWanted };
+        return true;
+    }
+
+    // Older sketches only add flowers, or clear the lot with 5
+    if (ledsShown & ~ledsWanted) {
+        cmd = { SERIAL_CMD_FLOWER, 5 };
+        return true;
+    }
+    for (int flower = 1; flower <= flower_count; flower++) {
+        if (ledsWanted & ~ledsShown & FlowerLed(flower)) {
+            cmd = { SERIAL_CMD_FLOWER, flower };
+            return true;
+        }
+    }
+    return false;
+}
 
-    std::cout << "Setting Arduino mode to: " << mode << std::endl;
+void SerialController::finishCommand(bool acked) {
+    awaitingAck = false;
 
-    // Create command string (with newline)
-    std::string command = "MODE:" + mode + "\n";
+    if (inFlight.type == SERIAL_CMD_PROTOCOL) {
+        if (!acked && protocol != PROTOCOL_TEXT) {
+            // The sketch gives up at the same time and goes back to text
+            setBaudRate(serial_text_baud);
+            protocol = PROTOCOL_TEXT;
+        }
+        LOG_INFO("Arduino protocol: {}", acked ? "binary" : "text");
+    }
+    else if (acked && inFlight.type == SERIAL_CMD_GAME_RESET) {
+        // The sketch's reset turns the strip off
+        ledsShown = 0;
+    }
+    else if (!acked) {
+        if (inFlight.type == SERIAL_CMD_LEDS) {
+            // Count it as shown rather than resend it forever
+            ledsShown = inFlight.value;
+        }
+        else if (inFlight.type == SERIAL_CMD_FLOWER) {
+            ledsShown = inFlight.value == 5 ? 0 : ledsShown | FlowerLed(inFlight.value);
+        }
+        LOG_ERROR("Arduino did not acknowledge serial command {} ({})", inFlight.type, inFlight.value);
+        SerialEvent ev = { SERIAL_COMMAND_FAILED, inFlight.type, LogTimestamp() };
+        failedCommands.Push(ev);
+    }
+}
+
+bool SerialController::writeCommand(const SerialCommand& cmd) {
+    if (protocol == PROTOCOL_BINARY) {
+        switch (cmd.type) {
+        case SERIAL_CMD_MODE_STEERING:
+            return writeFrame(FRAME_MODE, 0);
+        case SERIAL_CMD_MODE_ANSWERING:
+            return writeFrame(FRAME_MODE, 1);
+        case SERIAL_CMD_GAME_RESET:
+            return writeFrame(FRAME_GAME_RESET, 0);
+        case SERIAL_CMD_FLOWER:
+            return writeFrame(FRAME_FLOWER, (uint8_t)cmd.value);
+        case SERIAL_CMD_LEDS:
+            return writeFrame(FRAME_LEDS, (uint8_t)cmd.value);
+        case SERIAL_CMD_PROTOCOL:
+            return true;
+        }
+    }
 
-    // Send the command to Arduino
-    DWORD bytesWritten = 0;
-    if (!WriteFile(hSerial, command.c_str(), command.length(), &bytesWritten, NULL) ||
-        bytesWritten != command.length()) {
-        std::cerr << "Failed to send mode command to Arduino" << std::endl;
+    std::string command;
+    switch (cmd.type) {
+    case SERIAL_CMD_MODE_STEERING:
+        command = "MODE:STEERING\n";
+        break;
+    case SERIAL_CMD_MODE_ANSWERING:
+        command = "MODE:ANSWERING\n";
+        break;
+    case SERIAL_CMD_GAME_RESET:
+        command = "GAME:RESET\n";
+        break;
+    case SERIAL_CMD_FLOWER:
+        command = std::to_string(cmd.value) + "\n";
+        break;
+    case SERIAL_CMD_LEDS:
+        // nextLedCommand only picks it in binary
         return false;
+    case SERIAL_CMD_PROTOCOL:
+        command = std::string(serial_protocol_request) + "\n";
+        break;
+    }
+
+    if (!send(command.c_str(), command.length())) {
+        LOG_ERROR("Failed to send serial command {}", cmd.type);
+        return false;
+    }
+    return true;
+}
+
+void SerialController::queueCommand(SerialCommandType type, int value) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        switch (type) {
+        case SERIAL_CMD_MODE_STEERING:
+            boardAnswering = false;
+            break;
+        case SERIAL_CMD_MODE_ANSWERING:
+            boardAnswering = true;
+            break;
+        case SERIAL_CMD_GAME_RESET:
+            boardAnswering = false;
+            break;
+        default:
+            break;
+        }
+        // Only the state counts while the board is away, see attachPort
+        if (!portLost) {
+            commands.push_back({ type, value });
+        }
+    }
+    if (onHub) {
+        hub->wake();
+    }
+    else {
+        commandCv.notify_one();
+    }
+}
+
+// Called from the reader thread (or the hub) for every READY / Set flower line.
+// On the hub the pump runs right after the read, nothing to notify.
+void SerialController::onAck(SerialEventType type, int value) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+
+        // The sketch prints READY:STEERING at the end of setup()
+        if (!boardReady) {
+            boardReady = true;
+        }
+        else if (awaitingAck) {
+            switch (inFlight.type) {
+            case SERIAL_CMD_MODE_STEERING:
+            case SERIAL_CMD_GAME_RESET:
+                ackReceived = type == SERIAL_READY_STEERING;
+                break;
+            case SERIAL_CMD_MODE_ANSWERING:
+                ackReceived = type == SERIAL_READY_ANSWERING;
+                break;
+            case SERIAL_CMD_FLOWER:
+                ackReceived = type == SERIAL_FLOWER_SET && value == inFlight.value;
+                if (ackReceived) {
+                    // Flowers add up, 5 turns them all off
+                    ledsShown = value == 5 ? 0 : ledsShown | FlowerLed(value);
+                }
+                break;
+            case SERIAL_CMD_LEDS:
+                ackReceived = type == SERIAL_LEDS_SET && value == inFlight.value;
+                if (ackReceived) {
+                    ledsShown = value;
+                }
+                break;
+            case SERIAL_CMD_PROTOCOL:
+                ackReceived = type == SERIAL_HELLO;
+                break;
+            }
+        }
     }
+    commandCv.notify_all();
+}
 
-    // Clear the input buffer
-    PurgeComm(hSerial, PURGE_RXCLEAR);
+bool SerialController::setMode(ControllerMode mode) {
+    if (!connected) return false;
 
-    // Wait a moment for Arduino to process
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    LOG_INFO("Setting Arduino mode to: {}", mode == CONTROLLER_ANSWERING ? "ANSWERING" : "STEERING");
 
+    // Input is held back in applyEvent until the READY line comes in
+    requestedMode = mode;
+    queueCommand(mode == CONTROLLER_ANSWERING ? SERIAL_CMD_MODE_ANSWERING : SERIAL_CMD_MODE_STEERING, 0);
     return true;
 }
 
 void SerialController::setAnsweringMode() {
-    setMode("ANSWERING");
+    setMode(CONTROLLER_ANSWERING);
 
     // Reset flags to avoid input issues
     joyUp = false;
     joyDown = false;
     joyLeft = false;
     joyRight = false;
+    centerStick();
     buttonPressed = false;
 }
 
 void SerialController::setSteeringMode() {
-    setMode("STEERING");
+    setMode(CONTROLLER_STEERING);
 
     // Reset flags to avoid input issues
     joyUp = false;
     joyDown = false;
     joyLeft = false;
     joyRight = false;
+    centerStick();
     buttonPressed = false;
 }
 
 bool SerialController::resetGame() {
     if (!connected) return false;
 
-    std::cout << "Resetting game on Arduino..." << std::endl;
-
-    // Send reset command
-    std::string command = "GAME:RESET\n";
-    DWORD bytesWritten = 0;
-
-    if (!WriteFile(hSerial, command.c_str(), command.length(), &bytesWritten, NULL) ||
-        bytesWritten != command.length()) {
-        std::cerr << "Failed to send reset command to Arduino" << std::endl;
-        return false;
-    }
-
-    // Wait for acknowledgment
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    LOG_INFO("Resetting game on Arduino...");
 
+    // The sketch answers GAME:RESET with READY:STEERING. Until then the mode
+    // counts as unconfirmed, so presses from before the reset are dropped.
+    requestedMode = CONTROLLER_STEERING;
+    confirmedMode = CONTROLLER_ANSWERING;
+    queueCommand(SERIAL_CMD_GAME_RESET, 0);
     return true;
 }
 
-bool SerialController::setFlowerCollected(int flowerNumber) {
-    if (!connected) return false;
-
-    std::cout << "Sending flower collection: " << flowerNumber << std::endl;
+void SerialController::setFlowerLeds(unsigned leds) {
+    if (!connected || leds == ledsSet) return;
 
-    // Make sure flower number is valid (1-5)
-    if (flowerNumber < 1 || flowerNumber > 5) {
-        std::cerr << "Invalid flower number: " << flowerNumber << ", valid range is 1-5" << std::endl;
-        return false;
+    LOG_INFO("Flower LEDs: {}", leds);
+    ledsSet = leds;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        ledsWanted = leds;
     }
-
-    // Convert to string and send the flower number
-    std::string command = std::to_string(flowerNumber) + "\n";
-
-    DWORD bytesWritten = 0;
-    if (!WriteFile(hSerial, command.c_str(), command.length(), &bytesWritten, NULL) ||
-        bytesWritten != command.length()) {
-        std::cerr << "Failed to send flower number to Arduino" << std::endl;
-        return false;
+    if (onHub) {
+        hub->wake();
+    }
+    else {
+        commandCv.notify_one();
     }
-
-    // Short delay to ensure Arduino has time to process
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
-    return true;
-}
-
-bool SerialController::resetLEDs() {
-    // Sending flower number 5 resets all LEDs to off
-    return setFlowerCollected(5);
 }
 
 void SerialController::resetJoystickFlags() {
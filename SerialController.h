@@ -2,41 +2,235 @@
 #define SERIALCONTROLLER_H
 
 #include <string>
-#include <windows.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdint>
+#include <memory>
+#include "SerialPort.h"
+#include "SpscQueue.h"
+#include "SerialProtocol.h"
+#include "SerialLineParser.h"
+
+// Commands to the Arduino, each one is answered by a line we can wait for
+enum SerialCommandType {
+    SERIAL_CMD_MODE_STEERING,   // "MODE:STEERING" -> "READY:STEERING"
+    SERIAL_CMD_MODE_ANSWERING,  // "MODE:ANSWERING" -> "READY:ANSWERING"
+    SERIAL_CMD_GAME_RESET,      // "GAME:RESET" -> "READY:STEERING"
+    SERIAL_CMD_FLOWER,          // "N" -> "Set flower: N", to sketches before version 3
+    SERIAL_CMD_LEDS,            // version 3 FRAME_LEDS -> FRAME_LEDS_SET
+    SERIAL_CMD_PROTOCOL,        // "PROTO:BINARY" -> HELLO frame, see SerialProtocol.h
+};
+
+enum SerialProtocolState {
+    PROTOCOL_TEXT,
+    PROTOCOL_NEGOTIATING,   // switched to the binary baud rate, waiting for HELLO
+    PROTOCOL_BINARY,
+};
+
+struct SerialCommand {
+    SerialCommandType type;
+    int value;
+};
+
+enum ControllerMode {
+    CONTROLLER_STEERING,
+    CONTROLLER_ANSWERING,
+};
+
+struct SerialEvent {
+    SerialEventType type;
+    int value;
+    uint64_t timestamp_us;  // steady clock, when the reader thread parsed the line
+    // Joystick directions only
+    int seq = -1;           // the sketch's sequence number, -1 over text or protocol version 1
+    int sketch_ms = -1;     // how long the sketch had it before sending, -1 if not reported
+    int wire_us = 0;        // time on the wire, from message size and baud rate
+};
+
+// How the last joystick direction got to the game, see InputLatency.h
+struct InputTiming {
+    int seq = -1;
+    int sketch_ms = -1;
+    int wire_us = 0;
+    uint64_t read_us = 0;       // reader thread parsed it
+    uint64_t drained_us = 0;    // update() handed it to the game
+    unsigned seq_gaps = 0;      // direction frames lost or dropped so far
+};
+
+const int serial_event_queue_size = 256;
+// Opening the port resets the board. Its bootloader waits for an upload, about
+// 0.5 s with Optiboot and up to 2 s with older Nano bootloaders. setup()
+// doesn't wait for anything before READY. Sketches from before the task
+// table ran the strip test first, auto only finds them once reflashed.
+const int serial_boot_timeout_ms = 2500;
+const int serial_read_timeout_ms = 20;      // how often the reader checks for shutdown
+const int serial_ack_timeout_ms = 1500;     // sketches before version 3 blink the button LED for 1 s before acking GAME:RESET
+const int serial_command_retries = 2;
+
+class SerialHub;
+class SerialSupervisor;
 
 class SerialController {
+    friend class SerialHub;
+    friend class SerialSupervisor;
 private:
-    HANDLE hSerial;
+    std::unique_ptr<SerialPort> port;
     bool connected;
     bool joyUp, joyDown, joyLeft, joyRight;
+    // Protocol version 4 streams the stick instead, it stays where the last
+    // frame put it
+    int stickX, stickY;
+    bool stickSeen;
     bool buttonPressed;
+    bool gameStartButtonPressed;
+    bool selectionChanged;
     int selectedAnswer;
-    void processSerialData(const std::string& data);
     bool resetGameRequested;
 
+    // With a hub, its thread does the reading and the writing below and
+    // neither of our own threads is started
+    SerialHub* hub;
+    std::atomic<bool> onHub;
+    int logStation;
+    // Hub thread only: bytes written that the port hasn't taken yet, and
+    // whether the hub is waiting for it to poll writable
+    std::string hubOutput;
+    bool hubWritable;
+
+    // Finds the board and puts a new port in when the old one fails. Reads
+    // fail once the board is unplugged, portLost stays set until the
+    // supervisor has attached a port again.
+    SerialSupervisor* supervisor;
+    std::string portName;       // as given to initialize, may be "auto"
+    std::string capturePath;
+    std::atomic<bool> portLost;
+
+    // Reader thread: blocks on the port, splits lines and queues events
+    std::thread readerThread;
+    std::atomic<bool> readerRunning;
+    SpscQueue<SerialEvent, serial_event_queue_size> events;
+    std::atomic<unsigned> droppedEvents;
+    SerialLineParser lineParser;
+    uint64_t lastButtonEventTime;
+    std::atomic<int> protocol;
+    uint8_t frameBuffer[frame_size];
+    int frameLength;
+    std::atomic<int> protocolVersion;
+    int pendingInputAge;    // FRAME_INPUT_AGE waiting for its direction frame
+    int lastDirectionSeq;
+    std::atomic<unsigned> directionSeqGaps;
+
+    // Writer thread: sends one command at a time and waits for its ack.
+    // Everything below up to failedCommands is guarded by commandMutex.
+    std::thread writerThread;
+    std::mutex commandMutex;
+    std::condition_variable commandCv;
+    std::deque<SerialCommand> commands;
+    bool writerRunning;
+    bool boardReady;
+    uint64_t bootDeadline;      // MonotonicMs(), stop waiting for READY
+    bool awaitingAck;
+    bool ackReceived;
+    uint64_t ackDeadline;
+    int attempt;
+    SerialCommand inFlight;
+    SpscQueue<SerialEvent, 16> failedCommands;
+    // The mode to put back after a reconnect
+    bool boardAnswering;
+    // Flower LEDs the game wants lit and the ones the board last confirmed,
+    // see FlowerLed. Once the queue is empty the writer sends the difference.
+    unsigned ledsWanted;
+    unsigned ledsShown;
+
+    // Game thread only. Input that arrives while the Arduino hasn't confirmed
+    // the mode we asked for was meant for the previous mode and is dropped.
+    ControllerMode requestedMode;
+    ControllerMode confirmedMode;
+    InputTiming lastDirection;
+    unsigned ledsSet;           // last setFlowerLeds, saves taking the lock every tick
+
+    void startIo();
+    void stopIo();
+    void resetLink();
+    void markPortLost();
+    void attachPort(std::unique_ptr<SerialPort> newPort);
+    const char* captureFile() const;
+
+    void readerLoop();
+    int readAvailable(int timeoutMs);
+    void processLine(std::string_view line);
+    void pushEvent(SerialEventType type, int value, uint64_t timestamp);
+    void pushDirection(SerialEventType type, uint64_t timestamp, int seq, int sketchMs, int wireUs);
+    void centerStick();
+    void applyEvent(const SerialEvent& ev);
+    void processFrameByte(uint8_t byte);
+    void processFrame(uint8_t type, uint8_t value);
+    bool writeFrame(uint8_t type, uint8_t value);
+    bool send(const void* data, size_t size);
+    bool setBaudRate(unsigned long baudRate);
+
+    void writerLoop();
+    int pumpCommands(std::unique_lock<std::mutex>& lock);
+    void finishCommand(bool acked);
+    bool nextLedCommand(SerialCommand& cmd) const;
+    bool writeCommand(const SerialCommand& cmd);
+    void queueCommand(SerialCommandType type, int value);
+    void onAck(SerialEventType type, int value);
+
 public:
-    bool setMode(const std::string& mode);
+    // Commands are queued and return immediately, the writer thread retries
+    // them until the Arduino acknowledges
+    bool setMode(ControllerMode mode);
     void setAnsweringMode();
     void setSteeringMode();
     SerialController();
     ~SerialController();
     bool isResetRequested() const;
 
+    // Ports that can be polled are then serviced by the hub's thread instead
+    // of a reader and a writer thread of their own. Set before initialize.
+    void setHub(SerialHub* serialHub) { hub = serialHub; }
+    // Log lines from the reader and writer are tagged with this, see Log.h
+    void setLogStation(int station) { logStation = station; }
+    // Without one a port that fails stays failed. Set before initialize.
+    void setSupervisor(SerialSupervisor* serialSupervisor) { supervisor = serialSupervisor; }
+    // Record the port's traffic here instead of BUZZY_SERIAL_CAPTURE
+    void setCapturePath(const std::string& path) { capturePath = path; }
+
+    // portName may also be "replay:file", see SerialCapture.h, or "auto" to
+    // have the supervisor look for the board. False if the port didn't open;
+    // with a supervisor the controller still goes on, see isConnected.
     bool initialize(const char* portName);
+    // Same on a port the caller set up, e.g. a ReplaySerialPort it keeps an eye on
+    bool initialize(const char* portName, std::unique_ptr<SerialPort> withPort);
     void disconnect();
+    // Between initialize and disconnect, including while the supervisor is
+    // looking for the board. Commands sent meanwhile aren't lost: the mode
+    // and flower LEDs they asked for are restored once it is back.
     bool isConnected() const { return connected; }
+    // A working port right now
+    bool isPortUp() const { return connected && !portLost; }
+    bool isBinaryProtocol() const { return protocol == PROTOCOL_BINARY; }
+    // false between a mode change and the Arduino's READY line
+    bool isModeConfirmed() const { return requestedMode == confirmedMode; }
 
+    // Drains everything the reader thread queued since the last call.
+    // Call exactly once per game tick, the per-tick flags below are only
+    // valid until the next call.
     void update();
 
     bool isGameStartPressed() const;
 
-    std::string getLastMessage() const;
-
     bool resetGame();
 
-    bool setFlowerCollected(int flowerNumber);
-
-    bool resetLEDs();
+    // The flower LEDs that should be lit, see FlowerLed. State, not a
+    // command: call it as often as convenient, only a change goes out, as
+    // one message however many changes piled up meanwhile. resetGame turns
+    // the strip off on the board, so set 0 along with it.
+    void setFlowerLeds(unsigned leds);
 
     void resetJoystickFlags();
 
@@ -45,8 +239,18 @@ public:
     bool isDownPressed() const { return joyDown; }
     bool isLeftPressed() const { return joyLeft; }
     bool isRightPressed() const { return joyRight; }
+    // A sketch that streams the stick, see FRAME_STICK_X. Then the flags
+    // above stay off and the stick is read here, -stick_max .. stick_max,
+    // right and down positive. Centered while the board is away.
+    bool hasStick() const { return stickSeen; }
+    int getStickX() const { return stickX; }
+    int getStickY() const { return stickY; }
     bool isButtonPressed() const { return buttonPressed; }
+    // Timing of the newest direction or stick movement update() passed on
+    const InputTiming& getLastDirectionTiming() const { return lastDirection; }
+    // true if the Arduino reported a selection this tick
+    bool isSelectionChanged() const { return selectionChanged; }
     int getSelectedAnswer() const { return selectedAnswer; }
 };
 
-#endif // SERIALCONTROLLER_H
\ No newline at end of file
+#endif // SERIALCONTROLLER_H
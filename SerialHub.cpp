@@ -0,0 +1,193 @@
+#include "SerialHub.h"
+#include "SerialController.h"
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+bool SerialHub::start() {
+    if (running) return true;
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;  // the wake fd, controllers have their pointer here
+    if (epollFd < 0 || wakeFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) != 0) {
+        LOG_ERROR("Can't set up the serial hub: {}", std::strerror(errno));
+        stop();
+        return false;
+    }
+
+    running = true;
+    thread = std::thread(&SerialHub::loop, this);
+    return true;
+}
+
+void SerialHub::stop() {
+    if (running) {
+        running = false;
+        wake();
+        thread.join();
+    }
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    if (epollFd >= 0) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+}
+
+bool SerialHub::add(SerialController* controller) {
+    if (!running) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = controller;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, controller->port->pollHandle(), &ev) != 0) {
+        LOG_ERROR("Can't add serial port to the hub: {}", std::strerror(errno));
+        return false;
+    }
+    controllers.push_back(controller);
+    wake();
+    return true;
+}
+
+void SerialHub::remove(SerialController* controller) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Already gone from epoll if the port failed, that's fine
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, controller->port->pollHandle(), nullptr);
+    controllers.erase(std::remove(controllers.begin(), controllers.end(), controller), controllers.end());
+}
+
+void SerialHub::wake() {
+    uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG_ERROR("Serial hub wake failed: {}", std::strerror(errno));
+    }
+}
+
+bool SerialHub::isAdded(SerialController* controller) const {
+    return std::find(controllers.begin(), controllers.end(), controller) != controllers.end();
+}
+
+// Hub thread, with mutex held: writes what the port takes of the
+// controller's output and has epoll report when the rest fits
+void SerialHub::flush(SerialController* controller) {
+    std::string& output = controller->hubOutput;
+    if (!output.empty()) {
+        int written = controller->port->writeSome(output.data(), output.size());
+        if (written < 0) {
+            // The read side notices too, commands to it fail the usual way
+            output.clear();
+        }
+        else {
+            output.erase(0, (size_t)written);
+        }
+    }
+
+    bool writable = !output.empty();
+    if (writable != controller->hubWritable) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        if (writable)
+            ev.events |= EPOLLOUT;
+        ev.data.ptr = controller;
+        // Fails once the port has been dropped from epoll, nothing to wait for then
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, controller->port->pollHandle(), &ev);
+        controller->hubWritable = writable;
+    }
+}
+
+void SerialHub::loop() {
+    epoll_event events[16];
+    int waitMs = -1;
+
+    while (running) {
+        int ready = epoll_wait(epollFd, events, 16, waitMs);
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR("Serial hub epoll_wait failed: {}", std::strerror(errno));
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < ready; i++) {
+            SerialController* controller = (SerialController*)events[i].data.ptr;
+            if (!controller) {
+                uint64_t count;
+                while (::read(wakeFd, &count, sizeof(count)) > 0) {
+                }
+                continue;
+            }
+            // Removed after epoll_wait returned, or only writable, see flush
+            if (!isAdded(controller) || !(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) continue;
+
+            SetLogStation(controller->logStation);
+            if (controller->readAvailable(0) < 0) {
+                // Gone, e.g. unplugged. Stop listening rather than spin on
+                // the hangup, commands to it fail the usual way.
+                LOG_ERROR("Serial port failed, no longer reading it");
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, controller->port->pollHandle(), nullptr);
+                controller->hubOutput.clear();
+            }
+        }
+
+        // Acks that just came in, new commands, timeouts, then whatever
+        // that and the reads above have to send
+        waitMs = -1;
+        for (SerialController* controller : controllers) {
+            SetLogStation(controller->logStation);
+            {
+                std::unique_lock<std::mutex> commandLock(controller->commandMutex);
+                int next = controller->pumpCommands(commandLock);
+                if (next >= 0 && (waitMs < 0 || next < waitMs)) {
+                    waitMs = next;
+                }
+            }
+            flush(controller);
+        }
+        SetLogStation(0);
+    }
+}
+
+#else
+
+bool SerialHub::start() {
+    LOG_INFO("No serial hub on this platform, each port gets its own threads");
+    return false;
+}
+
+void SerialHub::stop() {
+}
+
+bool SerialHub::add(SerialController*) {
+    return false;
+}
+
+void SerialHub::remove(SerialController*) {
+}
+
+void SerialHub::wake() {
+}
+
+bool SerialHub::isAdded(SerialController*) const {
+    return false;
+}
+
+void SerialHub::flush(SerialController*) {
+}
+
+void SerialHub::loop() {
+}
+
+#endif // __linux__
@@ -0,0 +1,54 @@
+#ifndef SERIALHUB_H
+#define SERIALHUB_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SerialController;
+
+// One thread for the serial ports of every station. It waits in epoll on all
+// of them plus an eventfd, reads whatever came in and runs each controller's
+// command queue (sends, ack timeouts, retries), so four cabinets cost one
+// thread instead of eight. Linux only, start() fails elsewhere and the
+// controllers fall back to their own reader and writer threads.
+//
+// Writes never wait on a port: what a port doesn't take right away goes out
+// once it polls writable, so a cabinet that stops reading holds up nobody
+// else's input or acks.
+const size_t serial_hub_output_limit = 64;  // bytes waiting per port, a few commands
+
+class SerialHub {
+public:
+    ~SerialHub() { stop(); }
+
+    bool start();
+    void stop();
+
+    // SerialController::initialize / disconnect. remove returns once the hub
+    // thread is done with the controller.
+    bool add(SerialController* controller);
+    void remove(SerialController* controller);
+
+    // A command was queued, come around and send it
+    void wake();
+
+private:
+    void loop();
+    void flush(SerialController* controller);
+    bool isAdded(SerialController* controller) const;
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+
+    // held while the hub thread is working, so remove can't pull a
+    // controller out from under it
+    std::mutex mutex;
+    std::vector<SerialController*> controllers;
+};
+
+#endif // SERIALHUB_H
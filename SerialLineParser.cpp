@@ -0,0 +1,141 @@
+#include "SerialLineParser.h"
+#include <cstring>
+#include <algorithm>
+
+const size_t ring_mask = serial_ring_size - 1;
+
+size_t SerialLineParser::Feed(const char* data, size_t length)
+{
+	size_t space = serial_ring_size - (head - tail);
+	if (length > space)
+		length = space;
+
+	size_t offset = head & ring_mask;
+	size_t first = serial_ring_size - offset;
+	if (first >= length) {
+		std::memcpy(ring + offset, data, length);
+	}
+	else {
+		std::memcpy(ring + offset, data, first);
+		std::memcpy(ring, data + first, length - first);
+	}
+	head += length;
+	return length;
+}
+
+bool SerialLineParser::NextLine(std::string_view& line)
+{
+	while (scanned < head) {
+		// memchr over the contiguous part up to the ring's end
+		size_t offset = scanned & ring_mask;
+		size_t run = std::min(head - scanned, serial_ring_size - offset);
+		const char* newline = (const char*)std::memchr(ring + offset, '\n', run);
+		if (newline == nullptr) {
+			scanned += run;
+			continue;
+		}
+		scanned += newline - (ring + offset) + 1;
+
+		size_t start = tail;
+		size_t end = scanned - 1;
+		tail = scanned;
+
+		if (skipping) {
+			skipping = false;
+			continue;
+		}
+
+		if (end > start && ring[(end - 1) & ring_mask] == '\r')
+			end--;
+		size_t length = end - start;
+
+		// too long, even though its end came in the same read
+		if (length > serial_line_max) {
+			dropped++;
+			continue;
+		}
+
+		offset = start & ring_mask;
+		if (offset + length <= serial_ring_size) {
+			line = std::string_view(ring + offset, length);
+		}
+		else {
+			size_t first = serial_ring_size - offset;
+			std::memcpy(scratch, ring + offset, first);
+			std::memcpy(scratch + first, ring, length - first);
+			line = std::string_view(scratch, length);
+		}
+		return true;
+	}
+
+	// No end in sight, give up on this line so it can't fill the ring
+	if (head - tail > serial_line_max) {
+		if (!skipping)
+			dropped++;
+		skipping = true;
+		tail = head;
+	}
+	return false;
+}
+
+void SerialLineParser::Reset()
+{
+	head = tail = scanned = 0;
+	skipping = false;
+}
+
+//
+// Keyword table
+//
+struct SerialKeyword
+{
+	std::string_view text;
+	bool prefix;	// text is followed by a number, e.g. "Selected: 3"
+	SerialEventType type;
+	int min_value, max_value;
+};
+
+// Whole lines only, so "Up" can't match inside another message. Ordered
+// roughly by how often the sketch sends them.
+static const SerialKeyword serial_keywords[] = {
+	{ "Selected: ", true, SERIAL_SELECTED, 1, 4 },
+	{ "Up", false, SERIAL_UP, 0, 0 },
+	{ "Down", false, SERIAL_DOWN, 0, 0 },
+	{ "Left", false, SERIAL_LEFT, 0, 0 },
+	{ "Right", false, SERIAL_RIGHT, 0, 0 },
+	{ "Button", false, SERIAL_BUTTON, 0, 0 },
+	{ "Button pressed in answering mode: ", true, SERIAL_BUTTON, 1, 4 },
+	{ "Answering", false, SERIAL_BUTTON, 0, 0 },
+	{ "NextScreen", false, SERIAL_BUTTON, 0, 0 },
+	{ "NextScreen (GameStart)", false, SERIAL_BUTTON, 0, 0 },
+	{ "Set flower: ", true, SERIAL_FLOWER_SET, 1, 5 },
+	{ "READY:STEERING", false, SERIAL_READY_STEERING, 0, 0 },
+	{ "READY:ANSWERING", false, SERIAL_READY_ANSWERING, 0, 0 },
+	{ "RESET_GAME", false, SERIAL_RESET_GAME, 0, 0 },
+	{ serial_protocol_accept, false, SERIAL_PROTOCOL_ACCEPT, 0, 0 },
+};
+
+bool ParseSerialLine(std::string_view line, SerialEventType& type, int& value)
+{
+	for (const SerialKeyword& keyword : serial_keywords) {
+		if (!keyword.prefix) {
+			if (line == keyword.text) {
+				type = keyword.type;
+				value = 0;
+				return true;
+			}
+			continue;
+		}
+
+		// a single digit after the keyword
+		if (line.size() != keyword.text.size() + 1 || line.compare(0, keyword.text.size(), keyword.text) != 0)
+			continue;
+		int number = line.back() - '0';
+		if (number < keyword.min_value || number > keyword.max_value)
+			return false;
+		type = keyword.type;
+		value = number;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,50 @@
+#ifndef SERIALLINEPARSER_H
+#define SERIALLINEPARSER_H
+#include <cstddef>
+#include <string_view>
+#include "SerialProtocol.h"
+
+const size_t serial_ring_size = 512;	// must be a power of two
+const size_t serial_line_max = 128;		// longer lines are dropped
+
+// Splits the text protocol's byte stream into lines. Bytes go into a fixed
+// ring as they arrive, however the reads happen to cut them, and complete
+// lines come back out as views into the ring. Nothing is allocated.
+//
+//	size_t used = 0;
+//	while (used < length) {
+//		used += parser.Feed(data + used, length - used);
+//		std::string_view line;
+//		while (parser.NextLine(line)) { ... }
+//	}
+class SerialLineParser
+{
+public:
+	// Copies as much as fits, returns how many bytes were taken
+	size_t Feed(const char* data, size_t length);
+
+	// Next complete line without its "\r\n". The view is valid until the
+	// next call to Feed or NextLine.
+	bool NextLine(std::string_view& line);
+
+	void Reset();
+
+	// lines thrown away for being longer than serial_line_max
+	unsigned DroppedLines() const { return dropped; }
+
+private:
+	char ring[serial_ring_size];
+	char scratch[serial_line_max];	// for the odd line that wraps around the end of the ring
+	// Free running positions, masked when indexing
+	size_t head = 0;		// where Feed writes next
+	size_t tail = 0;		// start of the line being assembled
+	size_t scanned = 0;		// everything before this has been searched for '\n'
+	bool skipping = false;	// inside an overlong line, wait for its end
+	unsigned dropped = 0;
+};
+
+// Looks the line up in the keyword table. value is the number after the
+// keyword for the lines that carry one.
+bool ParseSerialLine(std::string_view line, SerialEventType& type, int& value);
+
+#endif // !SERIALLINEPARSER_H
@@ -0,0 +1,67 @@
+#ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// By default SerialSupervisor looks for the board on every serial port there
+// is. BUZZY_SERIAL_PORT in the environment names one instead (a pty from the
+// emulator, one board of several, ...).
+const char* const auto_serial_port = "auto";
+
+inline const char* SerialPortName() {
+    const char* env = std::getenv("BUZZY_SERIAL_PORT");
+    return (env && *env) ? env : auto_serial_port;
+}
+
+// A write gives up after this long if the device stops taking bytes, e.g. a
+// board that hangs with its USB still attached. Commands are a few bytes and
+// go out in milliseconds otherwise.
+const int serial_write_timeout_ms = 500;
+
+// A raw 8N1 serial port. One implementation per platform, SerialPortWin32.cpp
+// and SerialPortPosix.cpp, CreateSerialPort picks the one for this build.
+// Read and Write may be called from different threads at the same time.
+class SerialPort {
+public:
+    virtual ~SerialPort() {}
+
+    virtual bool open(const char* portName, unsigned long baudRate) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    virtual bool setBaudRate(unsigned long baudRate) = 0;
+
+    // Drops anything sitting in the driver's buffers, both directions
+    virtual void purge() = 0;
+
+    // Waits up to timeoutMs for input. Returns the number of bytes read,
+    // 0 on timeout, -1 on error.
+    virtual int read(char* buffer, size_t size, int timeoutMs) = 0;
+
+    // All or nothing, false on error or after serial_write_timeout_ms
+    virtual bool write(const void* data, size_t size) = 0;
+
+    // Takes what fits in the driver's buffer without waiting. Returns the
+    // number of bytes taken, 0 if it's full, -1 on error. The hub writes
+    // this way and waits in epoll for the rest to fit.
+    virtual int writeSome(const void* data, size_t size) { return write(data, size) ? (int)size : -1; }
+
+    // A descriptor that polls readable whenever read would return right away,
+    // so one thread can wait on many ports (SerialHub). -1 if there's none,
+    // the port's SerialController then reads on a thread of its own.
+    virtual int pollHandle() const { return -1; }
+};
+
+std::unique_ptr<SerialPort> CreateSerialPort();
+
+// Ports a board could be on: ttyACM* / ttyUSB* on Linux, cu.usbmodem* /
+// cu.usbserial* on macOS, the COM ports in the registry on Windows
+std::vector<std::string> ListSerialPorts();
+// The port is there to be opened, e.g. plugged back in. Cheaper than open and
+// quiet about it.
+bool SerialPortExists(const char* portName);
+
+#endif // SERIALPORT_H
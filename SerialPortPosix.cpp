@@ -0,0 +1,243 @@
+#ifndef _WIN32
+#include "SerialPort.h"
+#include "Log.h"
+#include "Clock.h"
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// termios port opened non-blocking. Reads wait in epoll (poll elsewhere), so
+// unlike the Windows handle a write never queues behind a waiting read.
+class PosixSerialPort : public SerialPort {
+public:
+    ~PosixSerialPort() override { close(); }
+
+    bool open(const char* portName, unsigned long baudRate) override;
+    void close() override;
+    bool isOpen() const override { return fd >= 0; }
+    bool setBaudRate(unsigned long baudRate) override;
+    void purge() override;
+    int read(char* buffer, size_t size, int timeoutMs) override;
+    bool write(const void* data, size_t size) override;
+    int writeSome(const void* data, size_t size) override;
+    int pollHandle() const override { return fd; }
+
+private:
+    bool waitReadable(int timeoutMs);
+
+    int fd = -1;
+    int epollFd = -1;
+    std::mutex writeMutex;  // keeps frames from two writer threads whole
+};
+
+static speed_t BaudConstant(unsigned long baudRate) {
+    switch (baudRate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+#ifdef B230400
+    case 230400: return B230400;
+#endif
+    default: return 0;
+    }
+}
+
+bool PosixSerialPort::open(const char* portName, unsigned long baudRate) {
+    close();
+
+    fd = ::open(portName, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Error opening serial port {}: {}", portName, std::strerror(errno));
+        return false;
+    }
+
+    // Raw 8N1, no flow control, no echo or line editing
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        LOG_ERROR("Error getting serial port state: {}", std::strerror(errno));
+        close();
+        return false;
+    }
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        LOG_ERROR("Error setting serial port state: {}", std::strerror(errno));
+        close();
+        return false;
+    }
+    if (!setBaudRate(baudRate)) {
+        close();
+        return false;
+    }
+
+#ifdef __linux__
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        LOG_ERROR("Error setting up epoll for serial port: {}", std::strerror(errno));
+        close();
+        return false;
+    }
+#endif
+    return true;
+}
+
+void PosixSerialPort::close() {
+    if (epollFd >= 0) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool PosixSerialPort::setBaudRate(unsigned long baudRate) {
+    speed_t speed = BaudConstant(baudRate);
+    if (speed == 0) {
+        LOG_ERROR("Unsupported baud rate {}", baudRate);
+        return false;
+    }
+
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        LOG_ERROR("Error getting serial port state: {}", std::strerror(errno));
+        return false;
+    }
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        LOG_ERROR("Error setting baud rate to {}: {}", baudRate, std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void PosixSerialPort::purge() {
+    tcflush(fd, TCIOFLUSH);
+}
+
+bool PosixSerialPort::waitReadable(int timeoutMs) {
+#ifdef __linux__
+    epoll_event ev;
+    int ready = epoll_wait(epollFd, &ev, 1, timeoutMs);
+#else
+    pollfd pfd = { fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeoutMs);
+#endif
+    return ready > 0 || (ready < 0 && errno == EINTR);
+}
+
+int PosixSerialPort::read(char* buffer, size_t size, int timeoutMs) {
+    if (!waitReadable(timeoutMs)) {
+        return 0;
+    }
+
+    ssize_t bytesRead = ::read(fd, buffer, size);
+    if (bytesRead < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        LOG_ERROR("Serial read failed: {}", std::strerror(errno));
+        return -1;
+    }
+    if (bytesRead == 0) {
+        // Readable but nothing there, the device went away
+        LOG_ERROR("Serial port closed by the device");
+        return -1;
+    }
+    return (int)bytesRead;
+}
+
+bool PosixSerialPort::write(const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    const char* bytes = (const char*)data;
+    uint64_t deadline = MonotonicMs() + serial_write_timeout_ms;
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Output buffer full, the device isn't reading
+                uint64_t now = MonotonicMs();
+                if (now >= deadline) {
+                    LOG_ERROR("Serial write timed out, the device isn't reading");
+                    return false;
+                }
+                pollfd pfd = { fd, POLLOUT, 0 };
+                poll(&pfd, 1, (int)(deadline - now));
+                continue;
+            }
+            LOG_ERROR("Serial write failed: {}", std::strerror(errno));
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+int PosixSerialPort::writeSome(const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        LOG_ERROR("Serial write failed: {}", std::strerror(errno));
+        return -1;
+    }
+    return (int)written;
+}
+
+std::unique_ptr<SerialPort> CreateSerialPort() {
+    return std::unique_ptr<SerialPort>(new PosixSerialPort());
+}
+
+std::vector<std::string> ListSerialPorts() {
+#ifdef __APPLE__
+    static const char* const prefixes[] = { "cu.usbmodem", "cu.usbserial" };
+#else
+    static const char* const prefixes[] = { "ttyACM", "ttyUSB" };
+#endif
+    std::vector<std::string> ports;
+    DIR* dir = opendir("/dev");
+    if (!dir) {
+        return ports;
+    }
+    while (dirent* entry = readdir(dir)) {
+        for (const char* prefix : prefixes) {
+            if (std::strncmp(entry->d_name, prefix, std::strlen(prefix)) == 0) {
+                ports.push_back(std::string("/dev/") + entry->d_name);
+            }
+        }
+    }
+    closedir(dir);
+    std::sort(ports.begin(), ports.end());
+    return ports;
+}
+
+bool SerialPortExists(const char* portName) {
+    return access(portName, F_OK) == 0;
+}
+
+#endif // !_WIN32
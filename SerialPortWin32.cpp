@@ -0,0 +1,181 @@
+#ifdef _WIN32
+#include "SerialPort.h"
+#include "Log.h"
+#include <string>
+#include <windows.h>
+
+// Non-overlapped handle: Windows runs one ReadFile/WriteFile at a time per
+// handle, so a write waits for the read in progress. Reads are kept short
+// (the reader passes a ~20 ms timeout) so that wait stays small.
+class Win32SerialPort : public SerialPort {
+public:
+    ~Win32SerialPort() override { close(); }
+
+    bool open(const char* portName, unsigned long baudRate) override;
+    void close() override;
+    bool isOpen() const override { return hSerial != INVALID_HANDLE_VALUE; }
+    bool setBaudRate(unsigned long baudRate) override;
+    void purge() override;
+    int read(char* buffer, size_t size, int timeoutMs) override;
+    bool write(const void* data, size_t size) override;
+
+private:
+    bool setReadTimeout(int timeoutMs);
+
+    HANDLE hSerial = INVALID_HANDLE_VALUE;
+    int readTimeoutMs = -1;
+};
+
+bool Win32SerialPort::open(const char* portName, unsigned long baudRate) {
+    close();
+
+    // Format COM port name correctly for Windows
+    std::string fullPortName = std::string("\\\\.\\") + portName;
+
+    hSerial = CreateFileA(fullPortName.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+
+    if (hSerial == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Error opening serial port {}! Error code: {}", portName, GetLastError());
+        return false;
+    }
+
+    DCB dcbSerialParams = { 0 };
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+
+    if (!GetCommState(hSerial, &dcbSerialParams)) {
+        LOG_ERROR("Error getting serial port state!");
+        close();
+        return false;
+    }
+
+    dcbSerialParams.BaudRate = baudRate;
+    dcbSerialParams.ByteSize = 8;
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity = NOPARITY;
+
+    if (!SetCommState(hSerial, &dcbSerialParams)) {
+        LOG_ERROR("Error setting serial port state!");
+        close();
+        return false;
+    }
+
+    readTimeoutMs = -1;
+    if (!setReadTimeout(0)) {
+        LOG_ERROR("Error setting timeouts!");
+        close();
+        return false;
+    }
+    return true;
+}
+
+void Win32SerialPort::close() {
+    if (hSerial != INVALID_HANDLE_VALUE) {
+        CloseHandle(hSerial);
+        hSerial = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool Win32SerialPort::setBaudRate(unsigned long baudRate) {
+    DCB dcbSerialParams = { 0 };
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+
+    if (!GetCommState(hSerial, &dcbSerialParams)) {
+        LOG_ERROR("Error getting serial port state!");
+        return false;
+    }
+    dcbSerialParams.BaudRate = baudRate;
+    if (!SetCommState(hSerial, &dcbSerialParams)) {
+        LOG_ERROR("Error setting baud rate to {}", baudRate);
+        return false;
+    }
+    return true;
+}
+
+void Win32SerialPort::purge() {
+    PurgeComm(hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
+}
+
+// Return as soon as any byte arrives, or after timeoutMs with nothing. Writes
+// give up after serial_write_timeout_ms.
+bool Win32SerialPort::setReadTimeout(int timeoutMs) {
+    if (timeoutMs == readTimeoutMs) return true;
+
+    COMMTIMEOUTS timeouts = { 0 };
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = timeoutMs > 0 ? MAXDWORD : 0;
+    timeouts.ReadTotalTimeoutConstant = timeoutMs;
+    timeouts.WriteTotalTimeoutMultiplier = 0;
+    timeouts.WriteTotalTimeoutConstant = serial_write_timeout_ms;
+
+    if (!SetCommTimeouts(hSerial, &timeouts)) {
+        return false;
+    }
+    readTimeoutMs = timeoutMs;
+    return true;
+}
+
+int Win32SerialPort::read(char* buffer, size_t size, int timeoutMs) {
+    if (!setReadTimeout(timeoutMs)) {
+        LOG_ERROR("Error setting timeouts!");
+        return -1;
+    }
+
+    DWORD bytesRead = 0;
+    if (!ReadFile(hSerial, buffer, (DWORD)size, &bytesRead, NULL)) {
+        LOG_ERROR("Serial read failed, error code: {}", GetLastError());
+        return -1;
+    }
+    return (int)bytesRead;
+}
+
+bool Win32SerialPort::write(const void* data, size_t size) {
+    DWORD bytesWritten = 0;
+    if (!WriteFile(hSerial, data, (DWORD)size, &bytesWritten, NULL) || bytesWritten != size) {
+        LOG_ERROR("Serial write failed, error code: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<SerialPort> CreateSerialPort() {
+    return std::unique_ptr<SerialPort>(new Win32SerialPort());
+}
+
+// Every COM port Windows knows about right now, USB ones appear and disappear
+// here as they are plugged in and out
+std::vector<std::string> ListSerialPorts() {
+    std::vector<std::string> ports;
+    HKEY key;
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, KEY_READ, &key) != ERROR_SUCCESS) {
+        return ports;
+    }
+    for (DWORD i = 0;; i++) {
+        char name[256];
+        char value[64];
+        DWORD nameSize = sizeof(name);
+        DWORD valueSize = sizeof(value) - 1;
+        DWORD type;
+        if (RegEnumValueA(key, i, name, &nameSize, NULL, &type, (BYTE*)value, &valueSize) != ERROR_SUCCESS) {
+            break;
+        }
+        if (type == REG_SZ) {
+            value[valueSize] = '\0';
+            ports.push_back(value);
+        }
+    }
+    RegCloseKey(key);
+    return ports;
+}
+
+bool SerialPortExists(const char* portName) {
+    char target[256];
+    return QueryDosDeviceA(portName, target, sizeof(target)) != 0;
+}
+
+#endif // _WIN32
@@ -0,0 +1,111 @@
+#ifndef SERIALPROTOCOL_H
+#define SERIALPROTOCOL_H
+#include <cstdint>
+
+// Binary protocol between SerialController and CombinedSteeringAnswering.ino.
+// CombinedSteeringAnswering.ino has its own copy of these values, change both.
+//
+// The sketch boots talking text lines at 9600 baud. Once it has printed READY
+// the host sends "PROTO:BINARY", a sketch that knows the binary protocol answers
+// "PROTO:BINARY OK" and both ends switch to 115200 baud. The sketch then repeats
+// a HELLO frame until the host answers with one, if that doesn't happen
+// within a second and a half both ends go back to text at 9600.
+//
+// Every frame is 4 bytes:
+//	frame_sync, type, value, CRC-8 of type and value
+
+// Version 2 numbers joystick directions and reports how long the sketch had
+// them, see FRAME_INPUT_AGE. Version 3 sets the whole flower strip with one
+// FRAME_LEDS. Version 4 streams the stick's position instead of directions,
+// see FRAME_STICK_X, when the host's HELLO says it's version 4 as well.
+// Version 1 sketches still work.
+const int serial_protocol_version = 4;
+const int serial_protocol_min_version = 1;
+// no digits, older sketches take any digit for a flower number
+const char* const serial_protocol_request = "PROTO:BINARY";
+const char* const serial_protocol_accept = "PROTO:BINARY OK";
+const unsigned long serial_text_baud = 9600;
+const unsigned long serial_binary_baud = 115200;
+
+// What a text line or a frame from the Arduino means, in either protocol
+enum SerialEventType
+{
+	SERIAL_UP,
+	SERIAL_DOWN,
+	SERIAL_LEFT,
+	SERIAL_RIGHT,
+	SERIAL_STICK_X,			// value = deflection, see stick_max
+	SERIAL_STICK_Y,
+	SERIAL_BUTTON,			// value = selected answer if the sketch said so, else 0
+	SERIAL_SELECTED,		// value = answer 1-4
+	SERIAL_RESET_GAME,
+	SERIAL_READY_STEERING,
+	SERIAL_READY_ANSWERING,
+	SERIAL_FLOWER_SET,		// value = flower number acknowledged
+	SERIAL_LEDS_SET,		// value = flower LEDs now lit, see FlowerLed
+	SERIAL_COMMAND_FAILED,	// value = SerialCommandType that never got an ack
+	SERIAL_HELLO,			// binary protocol handshake, never queued
+	SERIAL_PROTOCOL_ACCEPT,	// "PROTO:BINARY OK", never queued
+};
+
+const uint8_t frame_sync = 0xA5;
+const int frame_size = 4;
+
+enum FrameType : uint8_t
+{
+	// both directions
+	FRAME_HELLO = 0x01,			// value = protocol version
+
+	// host -> Arduino
+	FRAME_MODE = 0x02,			// value = 0 steering, 1 answering
+	FRAME_GAME_RESET = 0x03,
+	FRAME_FLOWER = 0x04,		// value = flower 1-4, 5 clears the strip
+	FRAME_LEDS = 0x05,			// version 3: value = flowers to light, see FlowerLed, the rest go off
+
+	// Arduino -> host
+	FRAME_DIRECTION = 0x10,		// value = 1 up, 2 right, 3 down, 4 left; version 2: sequence number << 3
+	FRAME_BUTTON = 0x11,		// value = selected answer in answering mode, else 0
+	FRAME_SELECTED = 0x12,		// value = answer 1-4
+	FRAME_RESET_GAME = 0x13,	// button held for 5 s
+	FRAME_READY = 0x14,			// value = 0 steering, 1 answering
+	FRAME_FLOWER_SET = 0x15,	// value = flower number shown
+	FRAME_INPUT_AGE = 0x16,		// version 2, right before each direction: ms since the sketch saw it, max 255
+	FRAME_LEDS_SET = 0x17,		// version 3: value = flowers now lit
+	FRAME_STICK_X = 0x18,		// version 4: value = int8_t deflection, right positive, see stick_max
+	FRAME_STICK_Y = 0x19,		// version 4: value = int8_t deflection, down positive
+};
+
+// The sketch samples the stick every few ms and sends an axis when it moved,
+// both every 100 ms so a lost frame doesn't stick. A switch joystick reads
+// as 0 or full deflection.
+const int stick_max = 127;
+
+// The flower strip has a segment per flower. Lit ones are sent as a mask.
+const int flower_count = 4;
+inline unsigned FlowerLed(int flower) { return 1u << (flower - 1); }
+
+// CRC-8, polynomial 0x07, initial value 0
+inline uint8_t FrameCrc(uint8_t type, uint8_t value)
+{
+	uint8_t crc = 0;
+	uint8_t bytes[2] = { type, value };
+	for (int i = 0; i < 2; i++) {
+		crc ^= bytes[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+const int direction_seq_bits = 5;
+const int direction_seq_mask = (1 << direction_seq_bits) - 1;
+
+inline void BuildFrame(uint8_t* out, uint8_t type, uint8_t value)
+{
+	out[0] = frame_sync;
+	out[1] = type;
+	out[2] = value;
+	out[3] = FrameCrc(type, value);
+}
+
+#endif // !SERIALPROTOCOL_H
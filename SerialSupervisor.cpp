@@ -0,0 +1,243 @@
+#include "SerialSupervisor.h"
+#include "SerialController.h"
+#include "SerialCapture.h"
+#include "SerialLineParser.h"
+#include "Log.h"
+#include "Clock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+void SerialSupervisor::start() {
+    if (running) return;
+    running = true;
+    thread = std::thread(&SerialSupervisor::loop, this);
+}
+
+void SerialSupervisor::stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wakeCv.notify_one();
+    thread.join();
+}
+
+void SerialSupervisor::watch(SerialController* controller, const char* portName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Watch watch;
+    watch.controller = controller;
+    if (portName) {
+        watch.current = portName;
+        watch.attaches = 1;
+    }
+    watches.push_back(watch);
+    if (!portName) {
+        wake();
+    }
+}
+
+void SerialSupervisor::unwatch(SerialController* controller) {
+    std::lock_guard<std::mutex> lock(mutex);
+    watches.erase(std::remove_if(watches.begin(), watches.end(),
+        [controller](const Watch& watch) { return watch.controller == controller; }), watches.end());
+}
+
+void SerialSupervisor::wake() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        woken = true;
+    }
+    wakeCv.notify_one();
+}
+
+void SerialSupervisor::loop() {
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCv.wait_for(lock, std::chrono::milliseconds(serial_rescan_ms), [this] { return woken || !running; });
+            woken = false;
+            if (!running) break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        releaseLost();
+        search(lock);
+        SetLogStation(0);
+    }
+}
+
+// Closes failed ports as soon as possible. Held open, Linux gives the board a
+// new name (ttyACM1) when it comes back.
+void SerialSupervisor::releaseLost() {
+    for (Watch& watch : watches) {
+        SerialController* controller = watch.controller;
+        if (!controller->portLost || !controller->port) continue;
+
+        SetLogStation(controller->logStation);
+        LOG_WARN("Arduino on {} went away, looking for it", watch.current);
+        controller->stopIo();
+        controller->port.reset();
+        watch.current.clear();
+        watch.lostAtMs = MonotonicMs();
+        watch.nextTryMs = 0;
+        watch.retryMs = serial_rescan_ms;
+    }
+}
+
+void SerialSupervisor::search(std::unique_lock<std::mutex>& lock) {
+    std::vector<std::string> present = ListSerialPorts();
+
+    // Unplugged, so whatever is plugged in there next gets a look
+    for (auto it = rejected.begin(); it != rejected.end();) {
+        if (std::find(present.begin(), present.end(), *it) == present.end()) {
+            it = rejected.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    uint64_t now = MonotonicMs();
+    std::vector<SerialController*> lost;
+    for (const Watch& watch : watches) {
+        if (watch.controller->portLost && !watch.controller->port && now >= watch.nextTryMs) {
+            lost.push_back(watch.controller);
+        }
+    }
+
+    for (SerialController* controller : lost) {
+        Watch* watch = find(controller);
+        if (!watch) continue;
+
+        const std::string& named = controller->portName;
+        bool discover = named == auto_serial_port;
+        std::vector<std::string> candidates;
+        if (!discover) {
+            if (SerialPortExists(named.c_str())) {
+                candidates.push_back(named);
+            }
+        }
+        else {
+            for (const std::string& portName : present) {
+                if (!claimed(portName) && !rejected.count(portName)) {
+                    candidates.push_back(portName);
+                }
+            }
+        }
+
+        bool found = false;
+        int station = controller->logStation;
+        for (const std::string& portName : candidates) {
+            // Takes up to the sketch's boot time, don't hold up unwatch
+            lock.unlock();
+            SetLogStation(station);
+            std::unique_ptr<SerialPort> port = probe(portName);
+            lock.lock();
+
+            watch = find(controller);
+            if (!running || !watch) break;
+            if (port) {
+                attach(*watch, std::move(port), portName);
+                found = true;
+                break;
+            }
+            if (discover) {
+                LOG_INFO("No Buzzy sketch on {}, leaving it alone", portName);
+                rejected.insert(portName);
+            }
+        }
+
+        // Nothing plugged in costs nothing to check, only back off from
+        // ports that were there but didn't answer
+        if (!found && watch && !candidates.empty()) {
+            watch->nextTryMs = MonotonicMs() + watch->retryMs;
+            watch->retryMs = std::min(watch->retryMs * 2, serial_retry_max_ms);
+        }
+        if (!running) return;
+    }
+}
+
+// In use, or named by a station
+bool SerialSupervisor::claimed(const std::string& portName) const {
+    for (const Watch& watch : watches) {
+        if (watch.current == portName || watch.controller->portName == portName) {
+            return true;
+        }
+    }
+    return false;
+}
+
+SerialSupervisor::Watch* SerialSupervisor::find(SerialController* controller) {
+    for (Watch& watch : watches) {
+        if (watch.controller == controller) {
+            return &watch;
+        }
+    }
+    return nullptr;
+}
+
+// Opens the port, which resets the board, and waits for the READY line the
+// sketch prints at the end of setup(). The open port if it came, else null.
+std::unique_ptr<SerialPort> SerialSupervisor::probe(const std::string& portName) {
+    std::unique_ptr<SerialPort> port = CreateSerialPort();
+    if (!port->open(portName.c_str(), serial_text_baud)) {
+        return nullptr;
+    }
+    port->purge();
+
+    SerialLineParser parser;
+    char buffer[256];
+    uint64_t deadline = MonotonicMs() + serial_boot_timeout_ms;
+    for (uint64_t now = MonotonicMs(); now < deadline && running; now = MonotonicMs()) {
+        int result = port->read(buffer, sizeof(buffer), (int)std::min<uint64_t>(deadline - now, 100));
+        if (result < 0) {
+            return nullptr;
+        }
+
+        size_t used = 0;
+        while (used < (size_t)result) {
+            used += parser.Feed(buffer + used, result - used);
+
+            std::string_view line;
+            while (parser.NextLine(line)) {
+                SerialEventType type;
+                int value;
+                if (ParseSerialLine(line, type, value) &&
+                    (type == SERIAL_READY_STEERING || type == SERIAL_READY_ANSWERING)) {
+                    return port;
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+void SerialSupervisor::attach(Watch& watch, std::unique_ptr<SerialPort> port, const std::string& portName) {
+    SerialController* controller = watch.controller;
+
+    // Every connection gets a recording of its own, the first one under the
+    // name itself
+    const char* capture = controller->captureFile();
+    if (capture) {
+        std::string path = capture;
+        if (watch.attaches > 0) {
+            path += "." + std::to_string(watch.attaches + 1);
+        }
+        port = RecordOpenSerialPort(std::move(port), path.c_str(), serial_text_baud);
+    }
+
+    controller->attachPort(std::move(port));
+    watch.attaches++;
+    watch.current = portName;
+    watch.retryMs = serial_rescan_ms;
+
+    if (watch.lostAtMs) {
+        LOG_INFO("Arduino back on {} after {} ms", portName, MonotonicMs() - watch.lostAtMs);
+    }
+    else {
+        LOG_INFO("Found the Arduino on {}", portName);
+    }
+    watch.lostAtMs = 0;
+}
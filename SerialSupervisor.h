@@ -0,0 +1,81 @@
+#ifndef SERIALSUPERVISOR_H
+#define SERIALSUPERVISOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SerialPort.h"
+
+class SerialController;
+
+const int serial_rescan_ms = 1000;      // look at the ports this often, or when one fails
+const int serial_retry_max_ms = 8000;   // back off this far on a named port that won't answer
+
+// Keeps every station's Arduino attached from a thread of its own, so the
+// game never waits on a port. A port that fails is closed right away (the
+// OS hands the same name back when the board is plugged in again) and the
+// board is looked for until it turns up: on its named port, or with "auto"
+// on every port ListSerialPorts finds that no other station is using.
+//
+// A port counts as the board once the sketch prints its READY banner after
+// the reset that opening it causes. The controller then gets the open port,
+// negotiates the protocol again and sends the mode and flower LEDs the game
+// last asked for. Ports that never print READY are left alone until they are
+// unplugged.
+class SerialSupervisor {
+public:
+    ~SerialSupervisor() { stop(); }
+
+    void start();
+    void stop();
+
+    // SerialController::initialize / disconnect. portName is the port it is
+    // on, null while it has none. unwatch returns once the supervisor is done
+    // with the controller.
+    void watch(SerialController* controller, const char* portName);
+    void unwatch(SerialController* controller);
+
+    // A port failed, don't wait for the next scan. Never blocks for long,
+    // the hub thread calls it.
+    void wake();
+
+private:
+    struct Watch {
+        SerialController* controller;
+        std::string current;        // port it's on, empty while it has none
+        int attaches = 0;
+        uint64_t lostAtMs = 0;
+        uint64_t nextTryMs = 0;
+        int retryMs = serial_rescan_ms;
+    };
+
+    void loop();
+    void releaseLost();
+    void search(std::unique_lock<std::mutex>& lock);
+    bool claimed(const std::string& portName) const;
+    Watch* find(SerialController* controller);
+    std::unique_ptr<SerialPort> probe(const std::string& portName);
+    void attach(Watch& watch, std::unique_ptr<SerialPort> port, const std::string& portName);
+
+    std::thread thread;
+    std::atomic<bool> running{ false };
+
+    // The loop holds this while it works on a controller, but not while it
+    // probes a port
+    std::mutex mutex;
+    std::vector<Watch> watches;
+    std::set<std::string> rejected;     // no READY on these, until they disappear
+
+    // Separate, so wake can't get stuck behind the loop
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool woken = false;
+};
+
+#endif // SERIALSUPERVISOR_H
@@ -1,143 +1,437 @@
 #include "Sound.h"
+#include "AssetBundle.h"
+#include "Station.h"
+#include "WorkerPool.h"
+#include "Clock.h"
+#include "Log.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
 
+// SFML plays everything on the default output device, four cabinets all
+// beeping out of one speaker is noise. Only the station with sound enabled
+// (the first unless --sound says otherwise) gets these, the rest stay quiet.
 static Sounds* sounds;
 static SoundState sstate;
 constexpr int total_death_time = 1500;
 
-void InitSounds()
+// With an asset bundle there's nothing to load. Without one, decoding every
+// effect one after another held up the first frame, so each file is a job on
+// a few loader threads. Nothing touches sounds from the game
+// thread until loads_pending is down to 0, then SoundsReady lets the
+// threads go.
+static WorkerPool loader;
+static std::atomic<int> loads_pending;
+static bool sounds_ready;
+static uint64_t load_start_ms;
+const int loader_threads = 4;
+
+// The background the screens asked for while loading, played once it's done.
+// Effects are just skipped, but a screen starts its loop only once.
+enum PendingBackground
 {
-	sounds = new Sounds;
+	PENDING_NONE,
+	PENDING_INSTRUCTION_AMBIENT,
+	PENDING_GAMEPLAY_AMBIENT,
+	PENDING_GAME_START,
+};
+static PendingBackground pending_background;
+
+// Quiet stations never load, and run their sims on other threads
+static void PendBackground(PendingBackground background)
+{
+	if (gStation->sound)
+		pending_background = background;
+}
+
+// Sound names as in bundle_assets, see AssetBundle.cpp
+struct ClipFile
+{
+	Clip Sounds::* clip;
+	const char* name;
+};
+
+struct TrackFile
+{
+	Track Sounds::* track;
+	const char* name;
+};
+
+static const ClipFile clip_files[] = {
+	{ &Sounds::death_1, "death_1" },
+	{ &Sounds::death_2, "death_2" },
+	{ &Sounds::eat_ghost, "eat_ghost" },
+	{ &Sounds::game_start, "game_start" },
+	{ &Sounds::munch1, "munch_1" },
+	{ &Sounds::munch2, "munch_2" },
+	{ &Sounds::power_pellet, "power_pellet" },
+	{ &Sounds::retreating, "retreating" },
+	{ &Sounds::button_press, "button_press" },
+	{ &Sounds::answer_correct, "answer_correct" },
+	{ &Sounds::answer_wrong, "answer_wrong" },
+	{ &Sounds::win_game, "win_game" },
+	{ &Sounds::lose_game, "lose_game" },
+};
+
+// Without the bundle these stream from audio/, opening one only reads the header
+static const TrackFile track_files[] = {
+	{ &Sounds::siren, "siren" },
+	{ &Sounds::instruction_ambient, "instruction_ambient" },
+	{ &Sounds::gameplay_ambient, "gameplay_ambient" },
+};
+
+// Checked first so a file that isn't there costs one warning, not an SFML error
+static bool AudioFileExists(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		LOG_WARN("Sound {} is missing, playing without it", path);
+	return (bool)file;
+}
+
+static void LoadClip(Clip& clip, const char* name)
+{
+	std::string path = AssetPath(FindAsset(ASSET_SOUND, name)->path);
+	if (!AudioFileExists(path))
+		return;
+	if (!clip.buffer.loadFromFile(path)) {
+		LOG_WARN("Couldn't decode {}, playing without it", path);
+		return;
+	}
+	if (clip.buffer.getChannelCount() > 2) {
+		LOG_WARN("{} has more than two channels, playing without it", path);
+		return;
+	}
+	clip.source.samples = clip.buffer.getSamples();
+	clip.source.channels = clip.buffer.getChannelCount();
+	clip.source.frames = clip.buffer.getSampleCount() / clip.source.channels;
+	clip.source.rate = clip.buffer.getSampleRate();
+	clip.present = true;
+}
+
+static void OpenTrack(Track& track, const char* name)
+{
+	std::string path = AssetPath(FindAsset(ASSET_SOUND, name)->path);
+	if (!AudioFileExists(path))
+		return;
+	if (!track.stream.open(path)) {
+		LOG_WARN("Couldn't open {}, playing without it", path);
+		return;
+	}
+	track.source.stream = &track.stream;
+	track.source.channels = track.stream.channels();
+	track.source.rate = track.stream.rate();
+	track.present = true;
+}
+
+static bool FindBundledSound(const char* name, MixerSource& source)
+{
+	const AssetEntry* entry = Assets().find(ASSET_SOUND, name);
+	if (!entry)
+		return false;
+	source.samples = (const int16_t*)Assets().data(*entry);
+	source.frames = entry->width;
+	source.channels = entry->channels;
+	source.rate = mixer_rate;
+	return true;
+}
+
+// Straight from the mapped bundle, the tracks too: the OS reads them in as
+// they play
+static bool UseAssetBundle()
+{
+	if (!Assets().isOpen())
+		return false;
+	if (Assets().soundRate() != mixer_rate) {
+		LOG_WARN("{} has sounds for {} Hz, loading them from audio/", asset_bundle_name, Assets().soundRate());
+		return false;
+	}
+	for (const ClipFile& file : clip_files) {
+		Clip& clip = sounds->*file.clip;
+		clip.present = FindBundledSound(file.name, clip.source);
+	}
+	for (const TrackFile& file : track_files) {
+		Track& track = sounds->*file.track;
+		track.present = FindBundledSound(file.name, track.source);
+	}
+	return true;
+}
+
+// Sounds start a fixed time after the input sample of the tick that played
+// them, wherever in the tick that was
+static uint64_t TickTime()
+{
+	return gInput && gInput->sample_us ? gInput->sample_us : MonotonicUs();
+}
+
+// A free voice if there is one. Otherwise the one that started first among
+// the lowest category this sound may take, or nothing if all outrank it.
+// The pool is fixed, so this never allocates and costs the same every time.
+static VoiceHandle PlayVoice(const MixerSource& source, uint64_t length_us, VoiceCategory category,
+	bool loop, bool ducked = false, float pitch = 1)
+{
+	static uint64_t play_count;
+	uint64_t now = MonotonicUs();
+	int pick = -1;
+	for (int i = 0; i < mixer_voice_count; i++) {
+		Voice& voice = sounds->voices[i];
+		if (now >= voice.end_us) {
+			pick = i;
+			break;
+		}
+		if (voice.category > category)
+			continue;
+		if (pick < 0)
+			pick = i;
+		else {
+			Voice& picked = sounds->voices[pick];
+			if (voice.category < picked.category || (voice.category == picked.category && voice.started < picked.started))
+				pick = i;
+		}
+	}
+	if (pick < 0) {
+		LOG_DEBUG("No voice for a category {} sound", (int)category);
+		return {};
+	}
+
+	Voice& voice = sounds->voices[pick];
+	uint64_t at = TickTime();
+	voice.category = category;
+	voice.started = ++play_count;
+	voice.end_us = loop ? UINT64_MAX : at + mixer_latency_ms * 1000 + length_us;
+	if (++voice.generation == 0)
+		voice.generation = 1;
+	// music doesn't duck the ambient tracks, everything else does
+	sounds->mixer.startVoice(pick, voice.generation, source, at, loop, ducked, category != VOICE_MUSIC, pitch);
+	return { (uint16_t)pick, voice.generation };
+}
+
+static VoiceHandle PlayVoice(const Clip& clip, VoiceCategory category, bool loop = false)
+{
+	if (!clip.present)
+		return {};
+	return PlayVoice(clip.source, clip.source.frames * 1000000 / clip.source.rate, category, loop);
+}
+
+static Voice* FindVoice(VoiceHandle handle)
+{
+	Voice& voice = sounds->voices[handle.index];
+	return handle.generation && voice.generation == handle.generation ? &voice : nullptr;
+}
+
+static void StopVoice(VoiceHandle& handle)
+{
+	if (Voice* voice = FindVoice(handle)) {
+		uint64_t at = TickTime();
+		sounds->mixer.stopVoice(handle.index, handle.generation, at);
+		voice->end_us = std::min(voice->end_us, at + mixer_latency_ms * 1000);
+	}
+	handle = {};
+}
+
+static bool VoicePlaying(VoiceHandle handle)
+{
+	Voice* voice = FindVoice(handle);
+	return voice && MonotonicUs() < voice->end_us;
+}
 
-	// Load original sounds
-	sounds->death_1.loadFromFile("audio/death_1.wav");
-	sounds->death_2.loadFromFile("audio/death_2.wav");
-	sounds->eat_ghost.loadFromFile("audio/eat_ghost.wav");
-	sounds->game_start.loadFromFile("audio/game_start.wav");
-	sounds->munch1.loadFromFile("audio/munch_1.wav");
-	sounds->munch2.loadFromFile("audio/munch_2.wav");
-	sounds->power_pellet.loadFromFile("audio/power_pellet.wav");
-	sounds->retreating.loadFromFile("audio/retreating.wav");
-	sounds->siren.loadFromFile("audio/siren_4.wav");
-
-	// Load new sounds
-	sounds->button_press.loadFromFile("audio/button_press.mp3");
-	sounds->answer_correct.loadFromFile("audio/answer_correct.wav");
-	sounds->answer_wrong.loadFromFile("audio/answer_wrong.wav");
-	sounds->instruction_ambient.loadFromFile("audio/instruction_ambient.wav");
-	sounds->gameplay_ambient.loadFromFile("audio/gameplay_ambient.wav");
-	sounds->win_game.loadFromFile("audio/win_game.wav");
-	sounds->lose_game.loadFromFile("audio/lose_game.wav");
-
-	// Set up original sound players
-	sounds->ghost_eat.setBuffer(sounds->eat_ghost);
-	sounds->background.setLoop(true);
-	sounds->death1.setBuffer(sounds->death_1);
-	sounds->death2.setBuffer(sounds->death_2);
-
-	// Set up new sound players
-	sounds->button_sfx.setBuffer(sounds->button_press);
-	sounds->correct_sfx.setBuffer(sounds->answer_correct);
-	sounds->wrong_sfx.setBuffer(sounds->answer_wrong);
-	sounds->win_sfx.setBuffer(sounds->win_game);
-	sounds->lose_sfx.setBuffer(sounds->lose_game);
-
-	// Set up ambient sound player
-	sounds->ambient.setLoop(true);
+static void PlayTrack(Track& track, float pitch = 1)
+{
+	if (!track.present)
+		return;
+	StopVoice(track.voice);
+	track.voice = PlayVoice(track.source, 0, VOICE_MUSIC, true, track.ambient, pitch);
+}
+
+static void StopTrack(Track& track)
+{
+	StopVoice(track.voice);
+}
+
+// From 0.75 with the maze full to 1.25 with it empty. It used to jump in
+// five steps whenever the background changed, now it glides with every pellet.
+static float SirenPitch()
+{
+	float left = std::min(std::max(gState->pellets_left / 244.f, 0.f), 1.f);
+	return 0.75f + 0.5f * (1 - left);
+}
+const int siren_glide_ms = 250;
+
+// True once everything is loaded, false meanwhile and for quiet stations
+static bool SoundsReady()
+{
+	if (!gStation->sound || !sounds)
+		return false;
+	if (sounds_ready)
+		return true;
+	if (loads_pending.load() > 0)
+		return false;
+
+	loader.Stop();
+	sounds->mixer.play();
 
+	sounds_ready = true;
+	LOG_INFO("Sounds loaded in {} ms", MonotonicMs() - load_start_ms);
+
+	PendingBackground pending = pending_background;
+	pending_background = PENDING_NONE;
+	if (pending == PENDING_INSTRUCTION_AMBIENT)
+		PlayInstructionAmbient();
+	else if (pending == PENDING_GAMEPLAY_AMBIENT)
+		PlayGameplayAmbient();
+	else if (pending == PENDING_GAME_START)
+		PlayGameStart();
+	return true;
+}
+
+void InitSounds(const Station& station)
+{
+	if (!station.sound || sounds)
+		return;
+
+	sounds = new Sounds;
+	sounds->instruction_ambient.ambient = true;
+	sounds->gameplay_ambient.ambient = true;
 	sstate.death_timer = total_death_time;
+	load_start_ms = MonotonicMs();
+
+	if (UseAssetBundle())
+		return;
+
+	int clip_count = sizeof(clip_files) / sizeof(clip_files[0]);
+	int track_count = sizeof(track_files) / sizeof(track_files[0]);
+	loads_pending = clip_count + track_count;
+	int hardware = (int)std::thread::hardware_concurrency();
+	loader.Start(std::max(1, std::min(hardware, loader_threads)));
+
+	for (const ClipFile& file : clip_files) {
+		loader.Submit([&file] {
+			LoadClip(sounds->*file.clip, file.name);
+			loads_pending--;
+		});
+	}
+	for (const TrackFile& file : track_files) {
+		loader.Submit([&file] {
+			OpenTrack(sounds->*file.track, file.name);
+			loads_pending--;
+		});
+	}
 }
 
 // New sound functions
 void PlayButtonSound()
 {
-	sounds->button_sfx.play();
+	if (!SoundsReady())
+		return;
+	PlayVoice(sounds->button_press, VOICE_UI);
 }
 
 void PlayCorrectAnswerSound()
 {
-	sounds->correct_sfx.play();
+	if (!SoundsReady())
+		return;
+	PlayVoice(sounds->answer_correct, VOICE_UI);
 }
 
 void PlayWrongAnswerSound()
 {
-	sounds->wrong_sfx.play();
+	if (!SoundsReady())
+		return;
+	PlayVoice(sounds->answer_wrong, VOICE_UI);
 }
 
 void PlayInstructionAmbient()
 {
-	sounds->ambient.stop();
-	sounds->ambient.setBuffer(sounds->instruction_ambient);
-	sounds->ambient.play();
+	if (!SoundsReady()) {
+		PendBackground(PENDING_INSTRUCTION_AMBIENT);
+		return;
+	}
+	StopTrack(sounds->gameplay_ambient);
+	PlayTrack(sounds->instruction_ambient);
 }
 
 void PlayGameplayAmbient()
 {
-	sounds->ambient.stop();
-	sounds->ambient.setBuffer(sounds->gameplay_ambient);
-	sounds->ambient.play();
+	if (!SoundsReady()) {
+		PendBackground(PENDING_GAMEPLAY_AMBIENT);
+		return;
+	}
+	StopTrack(sounds->instruction_ambient);
+	PlayTrack(sounds->gameplay_ambient);
 }
 
 void PlayWinSound()
 {
+	if (!SoundsReady())
+		return;
 	StopSounds();
-	sounds->win_sfx.play();
+	PlayVoice(sounds->win_game, VOICE_UI);
 }
 
 void PlayLoseSound()
 {
+	if (!SoundsReady())
+		return;
 	StopSounds();
-	sounds->lose_sfx.play();
+	PlayVoice(sounds->lose_game, VOICE_UI);
 }
 
 // Original sound functions
 void PlayMunch()
 {
-	if (sstate.first_munch)
-		sounds->munch.setBuffer(sounds->munch1);
-	else
-		sounds->munch.setBuffer(sounds->munch2);
-
+	if (!SoundsReady())
+		return;
+	// a munch of its own each time, so the last one isn't cut off
+	PlayVoice(sstate.first_munch ? sounds->munch1 : sounds->munch2, VOICE_SFX);
 	sstate.first_munch = !sstate.first_munch;
-
-	sounds->munch.play();
 }
 
 void PlayDeathSound()
 {
+	if (!SoundsReady())
+		return;
 	sstate.playing_death = true;
 }
 
 void PlayEatGhost()
 {
-	sounds->ghost_eat.play();
+	if (!SoundsReady())
+		return;
+	PlayVoice(sounds->eat_ghost, VOICE_SFX);
 }
 
 void PlayGameStart()
 {
-	sounds->background.stop();
-	sounds->ambient.stop();
-	sounds->background.setPitch(1);
-	sounds->background.setBuffer(sounds->game_start);
-	sounds->background.play();
+	if (!SoundsReady()) {
+		PendBackground(PENDING_GAME_START);
+		return;
+	}
+	StopVoice(sstate.background);
+	StopTrack(sounds->siren);
+	StopTrack(sounds->instruction_ambient);
+	StopTrack(sounds->gameplay_ambient);
+	sstate.background = PlayVoice(sounds->game_start, VOICE_MUSIC, true);
 }
 
-const float pitches[5] = { 0.75, 0.87, 1, 1.13, 1.25 };
 void UpdateGameSounds(int ms_elapsed)
 {
+	if (!SoundsReady())
+		return;
 	if (sstate.playing_death) {
-		if (sstate.death_timer <= total_death_time - 250 && sounds->death1.getStatus() != sf::SoundSource::Status::Playing) {
-			sounds->death1.play();
+		if (sstate.death_timer <= total_death_time - 250 && !VoicePlaying(sstate.death1)) {
+			sstate.death1 = PlayVoice(sounds->death_1, VOICE_SFX);
 		}
 		sstate.death_timer -= ms_elapsed;
 		if (sstate.death_timer <= 0) {
-			sounds->death2.play();
+			PlayVoice(sounds->death_2, VOICE_SFX);
 			sstate.death_timer = total_death_time;
 			sstate.playing_death = false;
 		}
 	}
 
 	// Return if not in main game loop (but keep death sounds playing)
-	if (gState.game_state != MAINLOOP)
+	if (gState->game_state != MAINLOOP)
 		return;
 
 	bool update_sound = false;
@@ -147,13 +441,13 @@ void UpdateGameSounds(int ms_elapsed)
 			sstate.bk_state = RETREAT;
 		}
 	}
-	else if (gState.energizer_time > 0) {
+	else if (gState->energizer_time > 0) {
 		if (sstate.bk_state != PPELLET) {
 			update_sound = true;
 			sstate.bk_state = PPELLET;
 		}
 	}
-	else if (gState.game_state == MAINLOOP) {
+	else if (gState->game_state == MAINLOOP) {
 		if (sstate.bk_state != SIREN) {
 			update_sound = true;
 			sstate.bk_state = SIREN;
@@ -161,29 +455,56 @@ void UpdateGameSounds(int ms_elapsed)
 	}
 
 	if (update_sound) {
-		switch (sstate.bk_state)
-		{
-		case SIREN:
-			sounds->background.setPitch(pitches[int((-4 / 244.f) * gState.pellets_left + 4)]);
-			sounds->background.setBuffer(sounds->siren);
-			break;
-		case RETREAT:
-			sounds->background.setPitch(1);
-			sounds->background.setBuffer(sounds->retreating);
-			break;
-		case PPELLET:
-			sounds->background.setPitch(1);
-			sounds->background.setBuffer(sounds->power_pellet);
-			break;
+		// the siren streams, the other two are short enough to keep in memory
+		if (sstate.bk_state == SIREN) {
+			StopVoice(sstate.background);
+			sstate.siren_pitch = SirenPitch();
+			PlayTrack(sounds->siren, sstate.siren_pitch);
+		}
+		else {
+			StopTrack(sounds->siren);
+			StopVoice(sstate.background);
+			sstate.background = PlayVoice(sstate.bk_state == RETREAT ? sounds->retreating : sounds->power_pellet, VOICE_MUSIC, true);
+		}
+	}
+	else if (sstate.bk_state == SIREN) {
+		float pitch = SirenPitch();
+		Voice* siren = FindVoice(sounds->siren.voice);
+		if (siren && std::fabs(pitch - sstate.siren_pitch) >= 0.002f) {
+			sounds->mixer.glidePitch(sounds->siren.voice.index, sounds->siren.voice.generation, pitch, siren_glide_ms);
+			sstate.siren_pitch = pitch;
 		}
-
-		sounds->background.play();
 	}
 }
 
 void StopSounds()
 {
-	sounds->background.stop();
-	sounds->ambient.stop();
+	if (!SoundsReady()) {
+		PendBackground(PENDING_NONE);
+		return;
+	}
+	StopVoice(sstate.background);
+	StopTrack(sounds->siren);
+	StopTrack(sounds->instruction_ambient);
+	StopTrack(sounds->gameplay_ambient);
 	sstate.bk_state = NO_SOUND;
-}
\ No newline at end of file
+}
+
+void CheckSoundsLoaded()
+{
+	SoundsReady();
+}
+
+void QuitSounds(const Station& station)
+{
+	if (!station.sound || !sounds)
+		return;
+	loader.Stop();
+	sounds->mixer.stop();
+}
+
+void LogSoundTiming()
+{
+	if (sounds_ready)
+		sounds->mixer.logTiming();
+}
@@ -3,44 +3,81 @@
 #include <SFML/Audio.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Graphics.hpp>
+#include <cstdint>
 #include "Buzzy.h"
+#include "Mixer.h"
+
+// A sound effect, in the asset bundle or decoded into memory by a loader
+// thread, see InitSounds
+struct Clip
+{
+	sf::SoundBuffer buffer;		// without the bundle
+	MixerSource source;
+	bool present = false;		// written by the loader, read once it's done
+};
+
+// Who gets a voice when they are all busy: a sound only takes one from its
+// own category or a lower one
+enum VoiceCategory
+{
+	VOICE_SFX,		// munches, ghosts, deaths
+	VOICE_MUSIC,	// background loops and jingles
+	VOICE_UI,		// buttons and trivia answers
+};
+
+// Names what a voice was started with. Goes stale when the voice stops or is
+// taken for another sound, after which stopping it does nothing.
+struct VoiceHandle
+{
+	uint16_t index = 0;
+	uint16_t generation = 0;	// voices start at 1, so 0 names nothing
+};
+
+// The game's side of a mixer voice, see Mixer.h
+struct Voice
+{
+	VoiceCategory category = VOICE_SFX;
+	uint16_t generation = 0;
+	uint64_t started = 0;	// play order, the oldest goes first
+	uint64_t end_us = 0;	// MonotonicUs() it will have finished by, UINT64_MAX for loops
+};
+
+// A long loop, read from disk while it plays: the bundle's pages or a stream
+struct Track
+{
+	MixerStream stream;		// without the bundle
+	MixerSource source;
+	bool present = false;
+	bool ambient = false;	// ducks under effects
+	VoiceHandle voice;
+};
 
 struct Sounds
 {
-	// Original sound buffers
-	sf::SoundBuffer munch1;
-	sf::SoundBuffer munch2;
-	sf::SoundBuffer game_start;
-	sf::SoundBuffer death_1;
-	sf::SoundBuffer death_2;
-	sf::SoundBuffer eat_ghost;
-	sf::SoundBuffer retreating;
-	sf::SoundBuffer power_pellet;
-	sf::SoundBuffer siren;
+	// Original sound effects
+	Clip munch1;
+	Clip munch2;
+	Clip game_start;
+	Clip death_1;
+	Clip death_2;
+	Clip eat_ghost;
+	Clip retreating;
+	Clip power_pellet;
 
-	// New sound buffers
-	sf::SoundBuffer button_press;
-	sf::SoundBuffer answer_correct;
-	sf::SoundBuffer answer_wrong;
-	sf::SoundBuffer instruction_ambient;
-	sf::SoundBuffer gameplay_ambient;
-	sf::SoundBuffer win_game;
-	sf::SoundBuffer lose_game;
+	// New sound effects
+	Clip button_press;
+	Clip answer_correct;
+	Clip answer_wrong;
+	Clip win_game;
+	Clip lose_game;
 
-	// Original sound players
-	sf::Sound munch;
-	sf::Sound ghost_eat;
-	sf::Sound background;
-	sf::Sound death1;
-	sf::Sound death2;
+	// Loops
+	Track siren;
+	Track instruction_ambient;
+	Track gameplay_ambient;
 
-	// New sound players
-	sf::Sound ambient;
-	sf::Sound button_sfx;
-	sf::Sound correct_sfx;
-	sf::Sound wrong_sfx;
-	sf::Sound win_sfx;
-	sf::Sound lose_sfx;
+	Mixer mixer;
+	Voice voices[mixer_voice_count];
 };
 
 enum BkState
@@ -55,18 +92,33 @@ struct SoundState
 {
 	bool first_munch = true;
 	bool playing_death = false;
+	VoiceHandle background;
+	VoiceHandle death1;
+	float siren_pitch = 1;
 	int death_timer = 0;
 	BkState bk_state = NO_SOUND;
 };
 
+struct Station;
+
 // Original sound functions
-void InitSounds();
+// Starts loading in the background and returns at once if the station plays
+// sound. Effects asked for before the loads are done are skipped, the last
+// background loop or jingle asked for starts once they are. Missing files
+// stay silent.
+void InitSounds(const Station& station);
+// Once a tick, so a background asked for while loading starts when it's done
+void CheckSoundsLoaded();
 void PlayMunch();
 void PlayEatGhost();
 void PlayDeathSound();
 void PlayGameStart();
 void UpdateGameSounds(int ms_elapsed);
 void StopSounds();
+// Before the station's window closes
+void QuitSounds(const Station& station);
+// Audio timing to the log, with DumpInputLatency
+void LogSoundTiming();
 
 // New sound functions
 void PlayButtonSound();
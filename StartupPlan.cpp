@@ -0,0 +1,117 @@
+#include "StartupPlan.h"
+#include "Clock.h"
+#include "Log.h"
+#include <algorithm>
+
+StartupPlan::StartupPlan()
+	: created_us(MonotonicUs())
+{
+}
+
+void StartupPlan::start(int threads)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (started)
+		return;
+	started = true;
+	pool.Start(threads);
+	for (int i = 0; i < (int)steps.size(); i++) {
+		if (steps[i].waiting_on == 0)
+			submit(i);
+	}
+}
+
+int StartupPlan::add(const std::string& name, std::function<void()> run, const std::vector<int>& after)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	int index = (int)steps.size();
+	steps.emplace_back();
+	Step& step = steps.back();
+	step.name = name;
+	step.run = std::move(run);
+	for (int before : after) {
+		if (before < 0 || before >= index || steps[before].done)
+			continue;
+		steps[before].dependents.push_back(index);
+		step.waiting_on++;
+	}
+	if (started && step.waiting_on == 0)
+		submit(index);
+	return index;
+}
+
+void StartupPlan::submit(int step)
+{
+	pool.Submit([this, step] { runStep(step); });
+}
+
+void StartupPlan::runStep(int index)
+{
+	std::function<void()>* run;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		steps[index].start_us = MonotonicUs();
+		run = &steps[index].run;
+	}
+	(*run)();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Step& step = steps[index];
+	step.end_us = MonotonicUs();
+	step.done = true;
+	done_count++;
+	for (int dependent : step.dependents) {
+		if (--steps[dependent].waiting_on == 0)
+			submit(dependent);
+	}
+	step_done.notify_all();
+}
+
+bool StartupPlan::isDone(int step) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return steps[step].done;
+}
+
+void StartupPlan::waitFor(int step)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	step_done.wait(lock, [&] { return steps[step].done; });
+}
+
+void StartupPlan::finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!started)
+			return;
+		step_done.wait(lock, [this] { return done_count == (int)steps.size(); });
+	}
+	pool.Stop();
+	std::lock_guard<std::mutex> lock(mutex);
+	started = false;
+}
+
+uint64_t StartupPlan::elapsedMs() const
+{
+	return (MonotonicUs() - created_us) / 1000;
+}
+
+void StartupPlan::logTiming() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<const Step*> order;
+	for (const Step& step : steps) {
+		if (step.done)
+			order.push_back(&step);
+	}
+	std::sort(order.begin(), order.end(), [](const Step* a, const Step* b) { return a->start_us < b->start_us; });
+
+	uint64_t last_us = created_us;
+	for (const Step* step : order) {
+		LOG_INFO("Startup: {} at {} ms took {} ms", step->name, (step->start_us - created_us) / 1000.0,
+			(step->end_us - step->start_us) / 1000.0);
+		last_us = std::max(last_us, step->end_us);
+	}
+	LOG_INFO("Startup: {} steps done after {} ms", (int)order.size(), (last_us - created_us) / 1000.0);
+}
@@ -0,0 +1,72 @@
+#ifndef STARTUPPLAN_H
+#define STARTUPPLAN_H
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "WorkerPool.h"
+
+// The work between launch and a playable game, as steps that run on a few
+// threads as soon as the steps they need are done. Textures, sounds, the
+// serial port and the stations' files all start at once instead of one after
+// another, and main shows each station's first screen as soon as the steps
+// that screen needs are done, while the rest finish behind it. See main.cpp
+// and OnStart.
+
+// Most steps read files, more threads than that just wait on the disk
+const int startup_threads = 4;
+
+class StartupPlan
+{
+public:
+	StartupPlan();
+	~StartupPlan() { finish(); }
+	StartupPlan(const StartupPlan&) = delete;
+	StartupPlan& operator=(const StartupPlan&) = delete;
+
+	void start(int threads);
+
+	// Runs run once every step in after is done, right away if they are.
+	// Steps can be added while others already run. Returns the step's
+	// number, for later steps to wait for.
+	int add(const std::string& name, std::function<void()> run, const std::vector<int>& after = {});
+
+	bool isDone(int step) const;
+	void waitFor(int step);
+	// Waits for every step, then lets the threads go
+	void finish();
+
+	// When each step ran, from the plan's creation, to the log
+	void logTiming() const;
+	uint64_t elapsedMs() const;
+
+private:
+	struct Step
+	{
+		std::string name;
+		std::function<void()> run;
+		std::vector<int> dependents;
+		int waiting_on = 0;
+		bool done = false;
+		uint64_t start_us = 0;
+		uint64_t end_us = 0;
+	};
+
+	// with mutex held
+	void submit(int step);
+	void runStep(int step);
+
+	// a deque so a running step's entry stays put while others are added
+	std::deque<Step> steps;
+	int done_count = 0;
+	mutable std::mutex mutex;
+	std::condition_variable step_done;
+	WorkerPool pool;
+	bool started = false;
+	uint64_t created_us;
+};
+
+#endif // !STARTUPPLAN_H
@@ -0,0 +1,78 @@
+#include "Station.h"
+#include "Gameloop.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+
+thread_local StationPtr<Station> gStation;
+
+static void Bind(Station* station)
+{
+	gStation = station;
+	gState = station ? &station->state : nullptr;
+	gSerialController = station ? &station->serial : nullptr;
+	gGameLogger = station ? &station->logger : nullptr;
+	gTriviaManager = station ? &station->trivia : nullptr;
+	gInput = station ? &station->input : nullptr;
+}
+
+StationBinding::StationBinding(Station& station)
+	: previous(gStation.get()), previous_log_station(log_station)
+{
+	Bind(&station);
+	SetLogStation(station.log_tag);
+}
+
+StationBinding::~StationBinding()
+{
+	Bind(previous);
+	SetLogStation(previous_log_station);
+}
+
+void TimeHistogram::Add(uint64_t us)
+{
+	uint64_t bucket = std::min<uint64_t>(us / bucket_us, bucket_count - 1);
+	buckets[bucket]++;
+	count++;
+	sum_us += us;
+	max_us = std::max(max_us, us);
+}
+double TimeHistogram::MeanMs() const
+{
+	return count ? sum_us / 1000.0 / count : 0.0;
+}
+double TimeHistogram::PercentileMs(double fraction) const
+{
+	uint32_t target = (uint32_t)(count * fraction);
+	uint32_t seen = 0;
+	for (int i = 0; i < bucket_count; i++) {
+		seen += buckets[i];
+		// bucket upper bound, never past the slowest one seen
+		if (seen > target)
+			return std::min<uint64_t>((uint64_t)(i + 1) * bucket_us, max_us) / 1000.0;
+	}
+	return max_us / 1000.0;
+}
+
+bool LogStationStats(Station& station, double seconds)
+{
+	StationBinding bound(station);
+	const StationStats& stats = station.stats;
+	double fps = seconds > 0 ? stats.interval.count / seconds : 0.0;
+
+	// a frame that took two ticks to show up means a visible hitch
+	double p99 = stats.interval.PercentileMs(0.99);
+	bool held = fps >= 59.0 && p99 < 1000.0 / 60.0 * 1.5;
+
+	// log text arguments are short, so two lines
+	char frames[96], work[96];
+	std::snprintf(frames, sizeof(frames), "%.1f fps, frame p50 %.2f p99 %.2f max %.2f ms",
+		fps, stats.interval.PercentileMs(0.5), p99, stats.interval.max_us / 1000.0);
+	std::snprintf(work, sizeof(work), "sim p99 %.2f ms, draw p99 %.2f ms, %u frames skipped",
+		stats.sim.PercentileMs(0.99), stats.render.PercentileMs(0.99), stats.busy_ticks);
+	if (held)
+		LOG_INFO("{}, {}", frames, work);
+	else
+		LOG_WARN("{}, {} - below 60 fps", frames, work);
+	return held;
+}
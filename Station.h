@@ -0,0 +1,105 @@
+#ifndef STATION_H
+#define STATION_H
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include "Buzzy.h"
+#include "Animate.h"
+#include "Render.h"
+#include "InputSnapshot.h"
+#include "SerialController.h"
+#include "GameLogger.h"
+#include "Trivia.h"
+
+// One exhibit cabinet: its window, Arduino, game log, highscore and the game
+// running on them. A normal install has one. Started with several --station
+// arguments, one process drives a cabinet per argument (see main.cpp).
+//
+// What main and the startup plan call takes the station to work on:
+// OnStart, SampleInput, GameLoop, PublishFrame, RenderStation and so on.
+// Each binds it with a StationBinding for the duration of the call. Game code
+// below them doesn't pass a station around, it works on gState,
+// gSerialController, gGameLogger, gTriviaManager and gInput, which are per
+// thread and assert that a station is bound when they're used.
+
+const int max_stations = 8;
+
+// Timings in 0.25 ms buckets up to 100 ms, for --bench
+struct TimeHistogram
+{
+	static const int bucket_us = 250;
+	static const int bucket_count = 400;
+
+	uint32_t buckets[bucket_count] = {};
+	uint32_t count = 0;
+	uint64_t sum_us = 0;
+	uint64_t max_us = 0;
+
+	void Add(uint64_t us);
+	double MeanMs() const;
+	double PercentileMs(double fraction) const;
+};
+
+// Only written by whoever is running the station at the time
+struct StationStats
+{
+	TimeHistogram sim;			// SampleInput, GameLoop and PublishFrame
+	TimeHistogram render;		// drawing and display()
+	TimeHistogram interval;		// between two frames on screen
+	uint64_t last_present_us = 0;
+	uint32_t busy_ticks = 0;	// the last frame was still being drawn, this one was skipped
+};
+
+struct Station
+{
+	int index = 0;
+	std::string port;			// "auto" to look for it, "none" for keyboard only
+	std::string highscore_file = "highscore.txt";
+	std::string log_file = "game_log.txt";
+	uint8_t log_tag = 0;		// see Log.h, 0 with a single station
+	bool sound = true;			// see Sound.cpp
+	bool capture = true;		// F11/F12 gameplay capture, see FrameCapture.h
+
+	sf::RenderWindow window;
+	GameState state;
+	SerialController serial;
+	GameLogger logger;
+	TriviaManager trivia;
+	InputSnapshot input;
+	KeyState keys;
+	Animation animate;
+	StationRender render;
+	StationStats stats;
+
+	// Player.cpp's buffered turn: did it come from the joystick, and how it got here
+	bool turn_from_joystick = false;
+	InputTiming turn_timing;
+
+	// Direction of a streamed stick, see Joystick.h, and when it last changed
+	Dir stick_dir = NONE;
+	InputTiming stick_timing;
+};
+
+extern thread_local StationPtr<Station> gStation;
+
+// Binds a station on this thread while it lives and puts back whatever was
+// bound before, so a pool thread isn't left pointing at the last station it
+// worked for
+class StationBinding
+{
+public:
+	explicit StationBinding(Station& station);
+	~StationBinding();
+	StationBinding(const StationBinding&) = delete;
+	StationBinding& operator=(const StationBinding&) = delete;
+
+private:
+	Station* previous;
+	uint8_t previous_log_station;
+};
+
+// Frame rate and timing percentiles of the station over the last seconds to
+// the log. True if it kept up with the 60 Hz tick.
+bool LogStationStats(Station& station, double seconds);
+
+#endif // !STATION_H
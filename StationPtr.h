@@ -0,0 +1,41 @@
+#ifndef STATIONPTR_H
+#define STATIONPTR_H
+#include <cassert>
+
+// The bound station's part of type T, see StationBinding in Station.h. Used
+// like the plain pointer it wraps, but dereferencing it asserts that a
+// station is bound on this thread, so code that runs where none is (a pool
+// thread, a startup step) stops right there instead of reading null or
+// whatever station the thread worked for last.
+template <typename T>
+class StationPtr
+{
+public:
+	constexpr StationPtr() = default;
+
+	StationPtr& operator=(T* bound)
+	{
+		ptr = bound;
+		return *this;
+	}
+
+	T* operator->() const
+	{
+		assert(ptr && "no station bound on this thread");
+		return ptr;
+	}
+	T& operator*() const
+	{
+		assert(ptr && "no station bound on this thread");
+		return *ptr;
+	}
+
+	// unchecked, for code that also runs with no station
+	T* get() const { return ptr; }
+	explicit operator bool() const { return ptr != nullptr; }
+
+private:
+	T* ptr = nullptr;
+};
+
+#endif // !STATIONPTR_H
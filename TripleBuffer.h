@@ -0,0 +1,46 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer.
+// The producer always has a private back slot to fill, the consumer always has
+// a private front slot to read, and the third slot is swapped between them
+// through one atomic byte. Neither side ever waits on the other, the consumer
+// simply sees the most recently published value.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : back_idx(0), middle(1), front_idx(2) {}
+
+	// producer side
+	T& Back() { return slots[back_idx]; }
+	void Publish()
+	{
+		uint8_t prev = middle.exchange(back_idx | dirty_bit, std::memory_order_acq_rel);
+		back_idx = prev & index_mask;
+	}
+
+	// consumer side, returns true if a newer value was swapped in
+	bool Acquire()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & dirty_bit))
+			return false;
+		uint8_t prev = middle.exchange(front_idx, std::memory_order_acq_rel);
+		front_idx = prev & index_mask;
+		return true;
+	}
+	const T& Front() const { return slots[front_idx]; }
+
+private:
+	static constexpr uint8_t dirty_bit = 0x4;
+	static constexpr uint8_t index_mask = 0x3;
+
+	T slots[3];
+	uint8_t back_idx;
+	std::atomic<uint8_t> middle;
+	uint8_t front_idx;
+};
+
+#endif // !TRIPLEBUFFER_H
@@ -2,31 +2,32 @@
 #define TRIVIA_H
 
 #include <vector>
-#include <string>
 #include <random>
+#include "TriviaBank.h"
+#include "StationPtr.h"
 
-struct TriviaQuestion {
-    std::string question;
-    std::vector<std::string> answers;
-    int correct_index;
-    int points_reward;
-    std::vector<std::string> explanations;
-};
-
+// Deals out the bank's questions for the audience set with
+// SetTriviaAudience, one station's worth, see TriviaBank.h
 class TriviaManager {
 private:
-    std::vector<TriviaQuestion> bee_questions;
-    std::vector<TriviaQuestion> available_questions;
+    std::vector<int> order;     // the audience's questions in the bank, shuffled
+    size_t next = 0;            // next one in order to ask
+    bool loaded = false;
     std::default_random_engine rng;
+    void Shuffle();
 
 public:
     TriviaManager();
-    void InitializeQuestions();
+    // Picks the audience's questions out of the bank. Done by the startup
+    // plan, else on the first question.
+    void Load();
+    // Every question once in a shuffled order, then again in a new one.
+    // Invalid if there are none. Nothing is copied, the view reads the bank.
     TriviaQuestion GetRandomQuestion();
     bool CheckAnswer(const TriviaQuestion& question, int selected_index);
-    std::string GetExplanation(const TriviaQuestion& question, int selected_index);
 };
 
-extern TriviaManager gTriviaManager;
+// The current station's, see Station.h
+extern thread_local StationPtr<TriviaManager> gTriviaManager;
 
 #endif // TRIVIA_H
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "TriviaBank.h"
+#include "AssetBundle.h"
+#include "Log.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+static_assert(sizeof(TriviaBankHeader) == 16, "trivia header layout");
+static_assert(sizeof(TriviaRecord) == 88, "trivia record layout");
+
+static std::string trivia_language = "en";
+static int trivia_age = 0;
+
+bool TriviaBank::Open(const uint8_t* data, size_t size, const std::string& source) {
+    records = nullptr;
+    strings = nullptr;
+    count = 0;
+
+    const TriviaBankHeader* header = (const TriviaBankHeader*)data;
+    if (size < sizeof(TriviaBankHeader) || std::memcmp(header->magic, trivia_bank_magic, 4)
+        || header->version != trivia_bank_version
+        || size - sizeof(TriviaBankHeader) < uint64_t(header->count) * sizeof(TriviaRecord) + header->strings_size) {
+        LOG_WARN("The trivia in {} is damaged or from another version", source);
+        return false;
+    }
+    const TriviaRecord* first = (const TriviaRecord*)(data + sizeof(TriviaBankHeader));
+    uint64_t strings_size = header->strings_size;
+
+    auto fits = [strings_size](const TriviaString& string) {
+        return string.offset <= strings_size && string.length <= strings_size - string.offset;
+    };
+    for (uint32_t i = 0; i < header->count; i++) {
+        const TriviaRecord& record = first[i];
+        bool ok = record.answer_count >= 1 && record.answer_count <= trivia_max_answers
+            && record.correct_index < record.answer_count && fits(record.question)
+            && !record.language[trivia_language_size - 1];
+        for (int a = 0; a < trivia_max_answers; a++)
+            ok = ok && fits(record.answers[a]) && fits(record.explanations[a]);
+        if (!ok) {
+            LOG_WARN("Trivia question {} in {} is damaged", (int)i + 1, source);
+            return false;
+        }
+    }
+
+    records = first;
+    strings = (const char*)(first + header->count);
+    count = header->count;
+    return true;
+}
+
+TriviaQuestion TriviaBank::Question(int index) const {
+    return TriviaQuestion(&records[index], strings, index);
+}
+
+bool TriviaBank::IsFor(int index, const std::string& language, int age) const {
+    const TriviaRecord& record = records[index];
+    if (std::strncmp(record.language, language.c_str(), trivia_language_size))
+        return false;
+    return age <= 0 || (age >= record.min_age && age <= record.max_age);
+}
+
+// Question being read, before it's turned into a record
+struct TriviaSource {
+    std::string question;
+    std::vector<std::string> answers;
+    std::vector<std::string> explanations;
+    int correct_index = -1;
+    int points = 1000;
+    int min_age = 0;
+    int max_age = 255;
+    std::string language = "en";
+    int line = 0;
+};
+
+static std::string Trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+        return std::string();
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+static bool CheckQuestion(const TriviaSource& source, std::string& error) {
+    std::string at = "question on line " + std::to_string(source.line);
+    if (source.question.empty())
+        error = at + " has no text";
+    else if (source.answers.size() < 2)
+        error = at + " needs at least two answers";
+    else if (source.correct_index < 0)
+        error = at + " has no correct answer";
+    else
+        return true;
+    return false;
+}
+
+bool CompileTriviaBank(const std::string& text, std::vector<uint8_t>& bank, std::string& error) {
+    std::vector<TriviaSource> sources;
+    size_t begin = 0;
+    int line_number = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(begin, end - begin);
+        begin = end + 1;
+        line_number++;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        line = Trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::string at = "line " + std::to_string(line_number) + ": ";
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            error = at + "expected key: value";
+            return false;
+        }
+        std::string key = Trim(line.substr(0, colon));
+        std::string value = Trim(line.substr(colon + 1));
+
+        if (key == "question") {
+            if (!sources.empty() && !CheckQuestion(sources.back(), error))
+                return false;
+            sources.emplace_back();
+            sources.back().question = value;
+            sources.back().line = line_number;
+            continue;
+        }
+        if (sources.empty()) {
+            error = at + "\"" + key + "\" before the first question";
+            return false;
+        }
+
+        TriviaSource& source = sources.back();
+        if (key == "answer" || key == "correct") {
+            if (source.answers.size() == (size_t)trivia_max_answers) {
+                error = at + "more than " + std::to_string(trivia_max_answers) + " answers";
+                return false;
+            }
+            if (key == "correct") {
+                if (source.correct_index >= 0) {
+                    error = at + "a second correct answer";
+                    return false;
+                }
+                source.correct_index = (int)source.answers.size();
+            }
+            source.answers.push_back(value);
+            source.explanations.emplace_back();
+        }
+        else if (key == "explain") {
+            if (source.answers.empty() || !source.explanations.back().empty()) {
+                error = at + "an explanation goes right after its answer";
+                return false;
+            }
+            source.explanations.back() = value;
+        }
+        else if (key == "points")
+            source.points = std::atoi(value.c_str());
+        else if (key == "language") {
+            if (value.empty() || value.size() >= (size_t)trivia_language_size) {
+                error = at + "language codes are 1 to " + std::to_string(trivia_language_size - 1) + " letters";
+                return false;
+            }
+            source.language = value;
+        }
+        else if (key == "ages") {
+            // "6-9", "8" or "all"
+            if (value == "all") {
+                source.min_age = 0;
+                source.max_age = 255;
+            }
+            else {
+                size_t dash = value.find('-');
+                source.min_age = std::atoi(value.c_str());
+                source.max_age = dash == std::string::npos ? source.min_age : std::atoi(value.c_str() + dash + 1);
+                if (source.min_age < 0 || source.max_age > 255 || source.min_age > source.max_age) {
+                    error = at + "ages are a range like 6-9";
+                    return false;
+                }
+            }
+        }
+        else {
+            error = at + "unknown key \"" + key + "\"";
+            return false;
+        }
+    }
+    if (!sources.empty() && !CheckQuestion(sources.back(), error))
+        return false;
+
+    // the same explanation text is often used for several answers, it's stored once
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> stored;
+    auto add = [&](const std::string& string) {
+        TriviaString added = { 0, (uint32_t)string.size() };
+        if (string.empty())
+            return added;
+        auto found = stored.find(string);
+        if (found != stored.end()) {
+            added.offset = found->second;
+            return added;
+        }
+        added.offset = (uint32_t)strings.size();
+        stored.emplace(string, added.offset);
+        strings += string;
+        return added;
+    };
+
+    std::vector<TriviaRecord> records(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        const TriviaSource& source = sources[i];
+        TriviaRecord& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        record.question = add(source.question);
+        for (size_t a = 0; a < source.answers.size(); a++) {
+            record.answers[a] = add(source.answers[a]);
+            record.explanations[a] = add(source.explanations[a]);
+        }
+        record.answer_count = (uint8_t)source.answers.size();
+        record.correct_index = (uint8_t)source.correct_index;
+        record.min_age = (uint8_t)source.min_age;
+        record.max_age = (uint8_t)source.max_age;
+        std::strncpy(record.language, source.language.c_str(), trivia_language_size - 1);
+        record.points = (uint32_t)source.points;
+    }
+
+    TriviaBankHeader header;
+    std::memcpy(header.magic, trivia_bank_magic, sizeof(header.magic));
+    header.version = trivia_bank_version;
+    header.count = (uint32_t)records.size();
+    header.strings_size = (uint32_t)strings.size();
+
+    bank.resize(sizeof(header) + records.size() * sizeof(TriviaRecord) + strings.size());
+    uint8_t* out = bank.data();
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    if (!records.empty())
+        std::memcpy(out, records.data(), records.size() * sizeof(TriviaRecord));
+    out += records.size() * sizeof(TriviaRecord);
+    if (!strings.empty())
+        std::memcpy(out, strings.data(), strings.size());
+    return true;
+}
+
+void SetTriviaAudience(const std::string& language, int age) {
+    trivia_language = language;
+    trivia_age = age;
+}
+
+const std::string& TriviaLanguage() {
+    return trivia_language;
+}
+
+int TriviaAge() {
+    return trivia_age;
+}
+
+// Keeps the compiled text's bytes when there's no bundle
+static std::vector<uint8_t> compiled_trivia;
+
+static TriviaBank LoadTriviaBank() {
+    TriviaBank bank;
+    const AssetEntry* entry = Assets().find(ASSET_TRIVIA, "trivia");
+    if (entry && bank.Open(Assets().data(*entry), (size_t)entry->size, asset_bundle_name)) {
+        LOG_INFO("{} trivia questions in {}", bank.Count(), asset_bundle_name);
+        return bank;
+    }
+
+    std::string path = AssetPath(FindAsset(ASSET_TRIVIA, "trivia")->path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        LOG_WARN("No {}, playing without trivia", path);
+        return bank;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string error;
+    if (!CompileTriviaBank(text, compiled_trivia, error)) {
+        LOG_WARN("{}: {}, playing without trivia", path, error);
+        return bank;
+    }
+    if (bank.Open(compiled_trivia.data(), compiled_trivia.size(), path))
+        LOG_INFO("{} trivia questions in {}", bank.Count(), path);
+    return bank;
+}
+
+const TriviaBank& GameTriviaBank() {
+    static const TriviaBank bank = LoadTriviaBank();
+    return bank;
+}
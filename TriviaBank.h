@@ -0,0 +1,108 @@
+#ifndef TRIVIABANK_H
+#define TRIVIABANK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The trivia questions, compiled from trivia/questions.txt into fixed size
+// records that point into one string table. The asset bundle carries the
+// compiled bank and the game reads it where it's mapped. Without a bundle
+// the text file is compiled into the same layout at startup. Either way
+// nothing is copied per question, a TriviaQuestion is a view into the bank.
+//
+// Layout, little endian: TriviaBankHeader, header.count TriviaRecord, then
+// header.strings_size bytes of strings. Strings aren't NUL terminated.
+
+const char trivia_bank_magic[4] = { 'B', 'Z', 'T', 'Q' };
+const uint32_t trivia_bank_version = 1;
+const int trivia_max_answers = 4;
+const int trivia_language_size = 8;
+
+struct TriviaBankHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t strings_size;
+};
+
+struct TriviaString {
+    uint32_t offset;    // into the string table
+    uint32_t length;
+};
+
+struct TriviaRecord {
+    TriviaString question;
+    TriviaString answers[trivia_max_answers];
+    TriviaString explanations[trivia_max_answers];   // empty if there's none
+    uint8_t answer_count;
+    uint8_t correct_index;
+    uint8_t min_age;
+    uint8_t max_age;
+    char language[trivia_language_size];   // zero padded, e.g. "en"
+    uint32_t points;
+};
+
+// One question, read through to the bank. Copying it copies two pointers,
+// and the bank stays put for as long as the game runs.
+class TriviaQuestion {
+public:
+    TriviaQuestion() = default;
+    TriviaQuestion(const TriviaRecord* record, const char* strings, int index)
+        : record(record), strings(strings), index(index) {}
+
+    bool IsValid() const { return record != nullptr; }
+    // the question's number in the bank
+    int Index() const { return index; }
+
+    std::string_view Text() const { return View(record->question); }
+    int AnswerCount() const { return record->answer_count; }
+    std::string_view Answer(int i) const { return View(record->answers[i]); }
+    std::string_view Explanation(int i) const { return View(record->explanations[i]); }
+    int CorrectIndex() const { return record->correct_index; }
+    int Points() const { return (int)record->points; }
+
+private:
+    std::string_view View(const TriviaString& string) const {
+        return std::string_view(strings + string.offset, string.length);
+    }
+
+    const TriviaRecord* record = nullptr;
+    const char* strings = nullptr;
+    int index = -1;
+};
+
+class TriviaBank {
+public:
+    // Checks a compiled bank and reads it in place, data has to outlive it.
+    // False, and logged as from source, if it's damaged.
+    bool Open(const uint8_t* data, size_t size, const std::string& source);
+
+    int Count() const { return (int)count; }
+    TriviaQuestion Question(int index) const;
+    // for the audience --trivia picked, see SetTriviaAudience
+    bool IsFor(int index, const std::string& language, int age) const;
+
+private:
+    const TriviaRecord* records = nullptr;
+    const char* strings = nullptr;
+    uint32_t count = 0;
+};
+
+// Compiles trivia/questions.txt's format into a bank. False with a message
+// naming the line if it can't.
+bool CompileTriviaBank(const std::string& text, std::vector<uint8_t>& bank, std::string& error);
+
+// Which questions the game asks: the language and the player's age, 0 for
+// every age. Set before the stations start.
+void SetTriviaAudience(const std::string& language, int age);
+const std::string& TriviaLanguage();
+int TriviaAge();
+
+// The bank in the asset bundle, else trivia/questions.txt compiled. Loaded on
+// first use from any thread, empty if neither is there.
+const TriviaBank& GameTriviaBank();
+
+#endif // TRIVIABANK_H
@@ -0,0 +1,67 @@
+#include "WorkerPool.h"
+
+void WorkerPool::Start(int count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (running)
+		return;
+	running = true;
+	for (int i = 0; i < count; i++)
+		threads.emplace_back(&WorkerPool::WorkerMain, this);
+}
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running)
+			return;
+		running = false;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+void WorkerPool::Submit(std::function<void()> job, bool urgent)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		(urgent ? urgent_jobs : jobs).push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+void WorkerPool::Run(int count, const std::function<void(int)>& job)
+{
+	std::mutex done_mutex;
+	std::condition_variable done;
+	int left = count;
+
+	for (int i = 0; i < count; i++) {
+		Submit([&, i] {
+			job(i);
+			std::lock_guard<std::mutex> lock(done_mutex);
+			if (--left == 0)
+				done.notify_one();
+		}, true);
+	}
+
+	std::unique_lock<std::mutex> lock(done_mutex);
+	done.wait(lock, [&] { return left == 0; });
+}
+void WorkerPool::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait(lock, [this] { return !urgent_jobs.empty() || !jobs.empty() || !running; });
+		if (urgent_jobs.empty() && jobs.empty())
+			return;	// stopped, and nothing left to do
+
+		std::deque<std::function<void()>>& queue = urgent_jobs.empty() ? jobs : urgent_jobs;
+		std::function<void()> job = std::move(queue.front());
+		queue.pop_front();
+
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads that run the stations' sim ticks and frames, see main.cpp.
+// Urgent jobs go ahead of everything queued, so a tick never waits behind a
+// slow frame.
+class WorkerPool
+{
+public:
+	~WorkerPool() { Stop(); }
+
+	void Start(int threads);
+	// finishes what's queued first
+	void Stop();
+
+	void Submit(std::function<void()> job, bool urgent = false);
+
+	// job(0) .. job(count - 1) as urgent jobs, returns when all are done
+	void Run(int count, const std::function<void(int)>& job);
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::function<void()>> urgent_jobs;
+	std::deque<std::function<void()>> jobs;
+	bool running = false;
+};
+
+#endif // !WORKERPOOL_H
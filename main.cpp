@@ -1,8 +1,31 @@
-#include <SFML/graphics.hpp>
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 #include <time.h>
 
+#include "AssetBundle.h"
 #include "Gameloop.h"
+#include "FrameCapture.h"
+#include "InputLatency.h"
+#include "InputSnapshot.h"
+#include "Joystick.h"
+#include "Log.h"
+#include "SerialCapture.h"
+#include "SerialHub.h"
+#include "SerialSupervisor.h"
+#include "Sound.h"
+#include "StartupPlan.h"
+#include "Station.h"
+#include "TriviaBank.h"
+#include "WorkerPool.h"
 
 
 sf::FloatRect calcView(const sf::Vector2f& windowSize, float pacRatio)
@@ -28,52 +51,280 @@ sf::FloatRect calcView(const sf::Vector2f& windowSize, float pacRatio)
 	}
 	return viewport;
 }
-void OnResize(sf::RenderWindow& window, sf::Event& event)
+void OnResize(Station& station, sf::Event& event)
 {
 	float h = event.size.height;
 	float w = event.size.width;
-	sf::View view = window.getView();
-	view.setViewport(calcView({ w,h }, win_ratio));
-	window.setView(view);
+	// the view belongs to whoever draws the station, hand it the new viewport
+	SetRenderViewport(station, calcView({ w,h }, win_ratio));
 }
 
-int main()
+struct StationArg
 {
+	std::string port;
+	bool positioned = false;
+	sf::Vector2i position;
+};
+
+// buzzy [--station PORT[@X,Y]]... [--sound N] [--bench SECONDS] [--stick DEADZONE,HYSTERESIS]
+//	[--trivia LANGUAGE[,AGE]]
+bool ParseArgs(int argc, char** argv, std::vector<StationArg>& stations, int& sound_station, double& bench_seconds)
+{
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--station") && has_value) {
+			StationArg arg;
+			arg.port = argv[++i];
+			size_t at = arg.port.rfind('@');
+			if (at != std::string::npos &&
+				std::sscanf(arg.port.c_str() + at + 1, "%d,%d", &arg.position.x, &arg.position.y) == 2) {
+				arg.port.erase(at);
+				arg.positioned = true;
+			}
+			stations.push_back(arg);
+		}
+		else if (!std::strcmp(argv[i], "--sound") && has_value)
+			sound_station = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--bench") && has_value)
+			bench_seconds = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--stick") && has_value) {
+			// percent of full deflection, for every station
+			StickZones zones;
+			if (std::sscanf(argv[++i], "%d,%d", &zones.dead_zone, &zones.hysteresis) < 1) {
+				std::fprintf(stderr, "--stick takes DEADZONE[,HYSTERESIS] in percent\n");
+				return false;
+			}
+			SetStickZones(zones);
+		}
+		else if (!std::strcmp(argv[i], "--trivia") && has_value) {
+			// the questions' language, and the players' age to pick questions for
+			char language[trivia_language_size] = {};
+			int age = 0;
+			if (std::sscanf(argv[++i], "%7[^,],%d", language, &age) < 1) {
+				std::fprintf(stderr, "--trivia takes LANGUAGE[,AGE]\n");
+				return false;
+			}
+			SetTriviaAudience(language, age);
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--station PORT[@X,Y]]... [--sound N] [--bench SECONDS] [--stick DEADZONE,HYSTERESIS] [--trivia LANGUAGE[,AGE]]\n", argv[0]);
+			return false;
+		}
+	}
+	if (stations.size() > (size_t)max_stations) {
+		std::fprintf(stderr, "at most %d stations\n", max_stations);
+		return false;
+	}
+	// a normal install: one cabinet on the usual port
+	if (stations.empty()) {
+		StationArg arg;
+		arg.port = SerialPortName();
+		stations.push_back(arg);
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<StationArg> args;
+	int sound_station = 1;
+	double bench_seconds = 0;
+	if (!ParseArgs(argc, argv, args, sound_station, bench_seconds))
+		return 2;
+
 	srand(time(NULL));
-	sf::RenderWindow window(sf::VideoMode(28.f * TSIZE * 2, 36.f * TSIZE * 2), "BUZZY");
-	window.setFramerateLimit(60);
-	window.setView(sf::View({ 0, 0, 28.f * TSIZE, 36.f * TSIZE }));
-	gState.window = &window;
 
-	OnStart();
+	// Console output goes through the background log thread from here on
+	StartLog();
+
+	// textures, sounds and the maze, wherever the game was started from
+	FindAssetDirectory(argc > 0 ? argv[0] : nullptr);
 
+	// Loading starts right away, while the windows are being created, see
+	// StartupPlan.h
+	int hardware = (int)std::thread::hardware_concurrency();
+	StartupPlan startup;
+	startup.start(std::max(2, std::min(hardware, startup_threads)));
+	int assets = startup.add("asset bundle", [] { Assets(); });
+	TextureSteps textures = PlanTextures(startup, assets);
+
+	// every station's Arduino on one thread, see SerialHub.h, and another
+	// that finds them and brings them back after USB glitches
+	static SerialHub serial_hub;
+	serial_hub.start();
+	static SerialSupervisor serial_supervisor;
+	serial_supervisor.start();
+
+	int count = (int)args.size();
+	bool several = count > 1;
+	const char* capture_path = SerialCapturePath();
+
+	std::vector<std::unique_ptr<Station>> stations;
+	std::vector<StationStartup> startups;
+	for (int i = 0; i < count; i++) {
+		stations.emplace_back(new Station());
+		Station& station = *stations.back();
+		std::string n = std::to_string(i + 1);
+
+		station.index = i;
+		station.port = args[i].port;
+		station.sound = sound_station == i + 1;
+		if (capture_path)
+			station.serial.setCapturePath(several ? capture_path + ("." + n) : capture_path);
+		if (several) {
+			station.highscore_file = "highscore_" + n + ".txt";
+			station.log_file = "game_log_" + n + ".txt";
+			station.log_tag = i + 1;
+			// one encoder, see FrameCapture.h
+			station.capture = i == 0;
+		}
+
+		station.window.create(sf::VideoMode(28.f * TSIZE * 2, 36.f * TSIZE * 2), several ? "BUZZY " + n : "BUZZY");
+		if (args[i].positioned)
+			station.window.setPosition(args[i].position);
+		station.window.setView(sf::View({ 0, 0, 28.f * TSIZE, 36.f * TSIZE }));
+		station.state.window = &station.window;
+		station.serial.setHub(&serial_hub);
+		station.serial.setSupervisor(&serial_supervisor);
+		station.serial.setLogStation(station.log_tag);
+
+		startups.push_back(OnStart(station, startup, textures));
+
+		// drawn from the pool from here on
+		station.window.setActive(false);
+	}
+
+	// Each station's first screen as soon as what it shows is there, the
+	// rest of the startup carries on behind it
+	for (int i = 0; i < count; i++) {
+		startup.waitFor(startups[i].first_screen);
+		PublishFrame(*stations[i]);
+	}
+	LOG_INFO("First screen after {} ms", (int)startup.elapsedMs());
+	bool starting = true;
+
+	// Stations tick together on the pool, then each queues its frame behind
+	// the ticks. A station whose last frame is still being drawn skips one
+	// rather than holding up the others.
+	WorkerPool pool;
+	pool.Start(std::max(1, std::min(hardware - 1, count)));
+	std::unique_ptr<std::atomic<bool>[]> drawing(new std::atomic<bool>[count]);
+	for (int i = 0; i < count; i++)
+		drawing[i] = false;
+
+	const sf::Time sim_tick = sf::seconds(1.f / 60.f);
 	sf::Clock clock;
+	sf::Clock bench_clock;
 	sf::Time elapsed;
+	bool running = true;
 
-	while (window.isOpen()) {
-		sf::Event event;
-		while (window.pollEvent(event)) {
-			switch (event.type) {
-			case sf::Event::Closed:
-				window.close();
-				break;
-			case sf::Event::Resized:
-				OnResize(window, event);
-				break;
-			case sf::Event::KeyPressed:
-				switch (event.key.code)
-				{
-				case sf::Keyboard::Escape:
-					window.close();
+	while (running) {
+		for (std::unique_ptr<Station>& station : stations) {
+			sf::Event event;
+			while (station->window.pollEvent(event)) {
+				InputWindowEvent(*station, event);
+				switch (event.type) {
+				case sf::Event::Closed:
+					running = false;
+					break;
+				case sf::Event::Resized:
+					OnResize(*station, event);
 					break;
+				case sf::Event::KeyPressed:
+					switch (event.key.code)
+					{
+					case sf::Keyboard::Escape:
+						running = false;
+						break;
+					// save the last 30 seconds of gameplay, e.g. right after a bug
+					case sf::Keyboard::F12:
+						RequestCaptureDump();
+						break;
+					// start/stop recording an attract-mode clip
+					case sf::Keyboard::F11:
+						ToggleCaptureRecording();
+						break;
+					// joystick latency histograms to the log
+					case sf::Keyboard::F10:
+						DumpInputLatency();
+						LogSoundTiming();
+						break;
+					}
 				}
 			}
 		}
+		if (bench_seconds > 0 && bench_clock.getElapsedTime().asSeconds() >= bench_seconds)
+			running = false;
+
+		if (starting) {
+			starting = false;
+			for (int i = 0; i < count; i++)
+				starting = starting || !startup.isDone(startups[i].ready);
+			if (!starting) {
+				startup.finish();
+				startup.logTiming();
+			}
+		}
+
 		elapsed = clock.restart();
-		GameLoop(elapsed.asMilliseconds());
+		int ms = elapsed.asMilliseconds();
+		// Input is sampled after the sleep and the event queue, as close to
+		// the step as it gets, so nothing that arrived meanwhile waits another tick
+		auto tick = [&](int i) {
+			Station& station = *stations[i];
+			// still starting up, its first screen stays up meanwhile
+			if (starting && !startup.isDone(startups[i].ready))
+				return;
+			uint64_t start_us = LogTimestamp();
+			SampleInput(station);
+			GameLoop(station, ms);
+			PublishFrame(station);
+			station.stats.sim.Add(LogTimestamp() - start_us);
+		};
+		if (several)
+			pool.Run(count, tick);
+		else
+			tick(0);
+
+		for (int i = 0; i < count; i++) {
+			if (drawing[i].exchange(true)) {
+				stations[i]->stats.busy_ticks++;
+				continue;
+			}
+			Station* station = stations[i].get();
+			std::atomic<bool>* done = &drawing[i];
+			pool.Submit([station, done] {
+				RenderStation(*station);
+				done->store(false);
+			});
+		}
+
+		sf::Time spent = clock.getElapsedTime();
+		if (spent < sim_tick)
+			sf::sleep(sim_tick - spent);
 	}
 
-	OnQuit();
+	// lets the last frames finish, and whatever was still starting up
+	pool.Stop();
+	startup.finish();
+
+	bool held = true;
+	double seconds = bench_clock.getElapsedTime().asSeconds();
+	for (std::unique_ptr<Station>& station : stations) {
+		StopRender(*station);
+		OnQuit(*station);
+		station->window.close();
+		if (bench_seconds > 0)
+			held = LogStationStats(*station, seconds) && held;
+	}
 
-	return 0;
-}
\ No newline at end of file
+	serial_supervisor.stop();
+	serial_hub.stop();
+	DumpInputLatency();
+	LogSoundTiming();
+	if (bench_seconds > 0)
+		LOG_INFO("{} station(s) over {} s: {}", count, (int)seconds, held ? "held 60 fps" : "fell behind");
+	StopLog();
+
+	return held ? 0 : 1;
+}
@@ -0,0 +1,598 @@
+// Software stand-in for the controller board. Builds the real
+// CombinedSteeringAnswering.ino against a small Arduino core shim and runs it
+// behind a pseudo-terminal, so the game connects to it like to the hardware.
+// POSIX only:
+//
+//	g++ -std=c++17 -O2 -Iarduino ArduinoEmulator.cpp -o ArduinoEmulator
+//	(add -DANALOG_STICK=1 for the sketch's analog stick build)
+//	./ArduinoEmulator --link /tmp/buzzy-arduino --script soak.txt
+//	BUZZY_SERIAL_PORT=/tmp/buzzy-arduino ./buzzy
+//
+// Like the real board it resets whenever the game opens the port: every
+// connection gets a fresh process running setup() and loop() with the sketch's
+// globals at their initial values.
+//
+// Joystick and button are driven by a script, one action per line:
+//	wait <ms>				do nothing for a while
+//	connected				wait until the game has the port open and setup() is done
+//	press [ms]				hold the button, 100 ms by default (5000+ triggers RESET_GAME)
+//	joy <up|down|left|right> [ms]	hold a direction, 100 ms by default
+//	stick <x> <y> [ms]		hold the stick there, percent with right and down
+//							positive, 100 ms by default. The switches close
+//							past 50, the analog build reads it as is.
+//	rate <per_second> <seconds>	random joystick changes through the pins, so the
+//							sketch's 1 ms polling and debounce still apply
+//	flood <per_second> <seconds>	direction messages written straight to the port,
+//							far past anything the hardware can produce
+//	burst <count>			that many direction messages in one write
+// '#' starts a comment. Without --loop the emulator exits when the script is done.
+//
+// On exit it prints how long the sketch's loop() passes took, which is how
+// long a command or a pin change can wait for the sketch to notice it. The
+// PC is much faster than the board, so that's the sketch's logic and the
+// shim's syscalls, not AVR timing.
+#include "Arduino.h"
+#include "Adafruit_NeoPixel.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+// The sketch itself
+#include "../CombinedSteeringAnswering.ino"
+
+namespace emulator
+{
+	const int pin_count = 16;
+	const int board_bootloader_ms = 500;
+
+	// In shared memory, written by the board process and the script alike
+	struct SharedState
+	{
+		std::atomic<int> pins[pin_count];
+		std::atomic<bool> running;		// board finished setup()
+		std::atomic<bool> binary;		// board talks binary frames
+		std::atomic<unsigned long long> bytes_out;
+		std::atomic<unsigned long long> bytes_in;
+		std::atomic<unsigned long long> injected;
+		std::atomic<unsigned long long> connections;
+		std::atomic<unsigned long long> loop_passes;
+		std::atomic<unsigned long long> loop_ns;
+		std::atomic<unsigned long long> loop_ns_max;
+	};
+
+	SharedState* shared = nullptr;
+	int master_fd = -1;
+	bool verbose = false;
+	volatile sig_atomic_t quit = 0;
+
+	// board process only
+	std::chrono::steady_clock::time_point boot_time;
+	std::string rx;
+	size_t rx_pos = 0;
+	uint32_t shown_segments = 0;
+
+	void FillRx()
+	{
+		char buffer[256];
+		ssize_t n = ::read(master_fd, buffer, sizeof(buffer));
+		if (n <= 0)
+			return;
+		if (rx_pos > 0 && rx_pos == rx.size()) {
+			rx.clear();
+			rx_pos = 0;
+		}
+		rx.append(buffer, n);
+		shared->bytes_in += n;
+
+		if (verbose) {
+			std::string shown;
+			for (ssize_t i = 0; i < n; i++) {
+				unsigned char c = buffer[i];
+				if (c >= 32 && c < 127)
+					shown += (char)c;
+				else {
+					char hex[8];
+					std::snprintf(hex, sizeof(hex), "\\x%02X", c);
+					shown += hex;
+				}
+			}
+			std::printf("[board] <- %s\n", shown.c_str());
+		}
+	}
+}
+
+using namespace emulator;
+
+//
+// Arduino core for the sketch
+//
+HardwareSerial Serial;
+
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+int digitalRead(int pin) { return pin >= 0 && pin < pin_count ? shared->pins[pin].load() : HIGH; }
+int analogRead(int pin) { return pin == A0 || pin == A1 ? shared->pins[pin].load() : 0; }
+
+unsigned long millis()
+{
+	return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - boot_time).count();
+}
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	if (verbose)
+		std::printf("[board] serial at %lu baud\n", baud);
+}
+void HardwareSerial::end() {}
+void HardwareSerial::flush() {}
+
+int HardwareSerial::available()
+{
+	FillRx();
+	return (int)(rx.size() - rx_pos);
+}
+
+int HardwareSerial::peek()
+{
+	return available() > 0 ? (unsigned char)rx[rx_pos] : -1;
+}
+
+int HardwareSerial::read()
+{
+	return available() > 0 ? (unsigned char)rx[rx_pos++] : -1;
+}
+
+size_t HardwareSerial::write(const uint8_t* data, size_t size)
+{
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = ::write(master_fd, data + done, size - done);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				delay(1);
+				continue;
+			}
+			break;
+		}
+		done += n;
+	}
+	shared->bytes_out += done;
+	return done;
+}
+
+// Which of the four flower segments (pixels 1-3, 5-7, 9-11, 13-15) are lit
+void OnStripShow(const uint32_t* pixels, int count)
+{
+	uint32_t segments = 0;
+	for (int flower = 0; flower < 4; flower++) {
+		int first = 1 + flower * 4;
+		if (first < count && pixels[first] != 0)
+			segments |= 1u << flower;
+	}
+	if (verbose && segments != shown_segments) {
+		std::printf("[board] strip: flowers");
+		for (int flower = 0; flower < 4; flower++) {
+			if (segments & (1u << flower))
+				std::printf(" %d", flower + 1);
+		}
+		std::printf("%s\n", segments ? "" : " none");
+	}
+	shown_segments = segments;
+}
+
+namespace emulator
+{
+	//
+	// Board process
+	//
+	[[noreturn]] void RunBoard()
+	{
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		// The bootloader waits about half a second after the reset before it
+		// starts the sketch, the game purges the port meanwhile
+		delay(board_bootloader_ms);
+		boot_time = std::chrono::steady_clock::now();
+
+		setup();
+		shared->running = true;
+		for (;;) {
+			auto start = std::chrono::steady_clock::now();
+			loop();
+			unsigned long long ns = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+			shared->loop_passes++;
+			shared->loop_ns += ns;
+			if (ns > shared->loop_ns_max)
+				shared->loop_ns_max = ns;
+			shared->binary = binaryProtocol && helloConfirmed;
+
+			// The board spins, a short nap keeps this off a whole core while
+			// staying well under the sketch's 1 ms input polling
+			usleep(100);
+		}
+	}
+
+	//
+	// Script
+	//
+	enum ActionType { ACT_WAIT, ACT_CONNECTED, ACT_PRESS, ACT_JOY, ACT_STICK, ACT_RATE, ACT_FLOOD, ACT_BURST };
+
+	struct Action
+	{
+		ActionType type;
+		int pin = -1;
+		double amount = 0;		// ms, count or rate
+		double seconds = 0;
+		int x = 0, y = 0;		// stick, percent
+		int line = 0;
+	};
+
+	const int direction_pins[4] = { Upin, Rpin, Dpin, Lpin };	// sketch's direction 1-4
+
+	bool ParseScript(std::istream& in, std::vector<Action>& actions)
+	{
+		std::string text;
+		int line_number = 0;
+		while (std::getline(in, text)) {
+			line_number++;
+			size_t comment = text.find('#');
+			if (comment != std::string::npos)
+				text.erase(comment);
+
+			std::istringstream words(text);
+			std::string name;
+			if (!(words >> name))
+				continue;
+
+			Action action;
+			action.line = line_number;
+			bool ok = true;
+			if (name == "wait") {
+				action.type = ACT_WAIT;
+				ok = (bool)(words >> action.amount);
+			}
+			else if (name == "connected") {
+				action.type = ACT_CONNECTED;
+			}
+			else if (name == "press") {
+				action.type = ACT_PRESS;
+				action.pin = button;
+				action.amount = 100;
+				words >> action.amount;
+			}
+			else if (name == "joy") {
+				std::string dir;
+				action.type = ACT_JOY;
+				action.amount = 100;
+				ok = (bool)(words >> dir);
+				if (dir == "up") action.pin = Upin;
+				else if (dir == "right") action.pin = Rpin;
+				else if (dir == "down") action.pin = Dpin;
+				else if (dir == "left") action.pin = Lpin;
+				else ok = false;
+				words >> action.amount;
+			}
+			else if (name == "stick") {
+				action.type = ACT_STICK;
+				action.amount = 100;
+				ok = (bool)(words >> action.x >> action.y) && std::abs(action.x) <= 100 && std::abs(action.y) <= 100;
+				words >> action.amount;
+			}
+			else if (name == "rate" || name == "flood") {
+				action.type = name == "rate" ? ACT_RATE : ACT_FLOOD;
+				ok = (bool)(words >> action.amount >> action.seconds) && action.amount > 0;
+			}
+			else if (name == "burst") {
+				action.type = ACT_BURST;
+				ok = (bool)(words >> action.amount);
+			}
+			else {
+				ok = false;
+			}
+
+			if (!ok) {
+				std::fprintf(stderr, "script line %d: can't parse \"%s\"\n", line_number, text.c_str());
+				return false;
+			}
+			actions.push_back(action);
+		}
+		return true;
+	}
+
+	// Direction messages written past the sketch, in whatever protocol it talks
+	void Inject(int count, std::mt19937& rng)
+	{
+		static const char* names[4] = { "Up\r\n", "Right\r\n", "Down\r\n", "Left\r\n" };
+		std::string out;
+		bool binary = shared->binary;
+		for (int i = 0; i < count; i++) {
+			int dir = rng() % 4;
+			if (binary) {
+				uint8_t type = FRAME_DIRECTION, value = (uint8_t)(dir + 1);
+				uint8_t frame[FRAME_SIZE] = { FRAME_SYNC, type, value, frameCrc(type, value) };
+				out.append((const char*)frame, FRAME_SIZE);
+			}
+			else {
+				out += names[dir];
+			}
+		}
+
+		size_t done = 0;
+		while (done < out.size() && !quit) {
+			ssize_t n = ::write(master_fd, out.data() + done, out.size() - done);
+			if (n < 0) {
+				if (errno == EAGAIN || errno == EINTR) {
+					usleep(200);
+					continue;
+				}
+				break;
+			}
+			done += n;
+		}
+		shared->injected += count;
+	}
+
+	void ReleaseAll()
+	{
+		for (int i = 0; i < pin_count; i++)
+			shared->pins[i] = HIGH;
+		shared->pins[A0] = 512;
+		shared->pins[A1] = 512;
+	}
+
+	void PushStick(int x, int y)
+	{
+		shared->pins[A0] = 512 + x * 511 / 100;
+		shared->pins[A1] = 512 + y * 511 / 100;
+		if (x <= -50) shared->pins[Lpin] = LOW;
+		if (x >= 50) shared->pins[Rpin] = LOW;
+		if (y <= -50) shared->pins[Upin] = LOW;
+		if (y >= 50) shared->pins[Dpin] = LOW;
+	}
+
+	class ScriptRunner
+	{
+	public:
+		ScriptRunner(const std::vector<Action>& actions, bool repeat, unsigned seed)
+			: actions(actions), repeat(repeat), rng(seed) {}
+
+		// Runs whatever is due, false once the script is finished
+		bool Step(std::chrono::steady_clock::time_point now)
+		{
+			while (pc < actions.size()) {
+				const Action& a = actions[pc];
+				double elapsed = std::chrono::duration<double>(now - started).count();
+
+				if (!active) {
+					active = true;
+					started = now;
+					done = 0;
+					elapsed = 0;
+					if (a.pin >= 0)
+						shared->pins[a.pin] = LOW;
+					if (a.type == ACT_BURST)
+						Inject((int)a.amount, rng);
+					if (a.type == ACT_STICK)
+						PushStick(a.x, a.y);
+				}
+
+				bool finished = false;
+				switch (a.type) {
+				case ACT_WAIT:
+				case ACT_PRESS:
+				case ACT_JOY:
+				case ACT_STICK:
+					finished = elapsed * 1000 >= a.amount;
+					break;
+				case ACT_CONNECTED:
+					finished = shared->running;
+					break;
+				case ACT_BURST:
+					finished = true;
+					break;
+				case ACT_RATE: {
+					long due = (long)(std::min(elapsed, a.seconds) * a.amount);
+					for (; done < due; done++) {
+						// a new direction, or let go of the stick now and then
+						ReleaseAll();
+						int pick = rng() % 5;
+						if (pick < 4)
+							shared->pins[direction_pins[pick]] = LOW;
+					}
+					finished = elapsed >= a.seconds;
+					break;
+				}
+				case ACT_FLOOD: {
+					long due = (long)(std::min(elapsed, a.seconds) * a.amount);
+					if (due > done) {
+						Inject((int)(due - done), rng);
+						done = due;
+					}
+					finished = elapsed >= a.seconds;
+					break;
+				}
+				}
+
+				if (!finished)
+					return true;
+
+				if (a.pin >= 0 || a.type == ACT_RATE || a.type == ACT_STICK)
+					ReleaseAll();
+				active = false;
+				pc++;
+				if (pc == actions.size() && repeat)
+					pc = 0;
+			}
+			return false;
+		}
+
+	private:
+		const std::vector<Action>& actions;
+		bool repeat;
+		std::mt19937 rng;
+		size_t pc = 0;
+		bool active = false;
+		std::chrono::steady_clock::time_point started;
+		long done = 0;
+	};
+
+	//
+	// pty and board process supervision
+	//
+	bool SlaveOpen()
+	{
+		pollfd pfd = { master_fd, 0, 0 };
+		poll(&pfd, 1, 0);
+		return !(pfd.revents & POLLHUP);
+	}
+
+	void OnSignal(int) { quit = 1; }
+}
+
+int main(int argc, char** argv)
+{
+	const char* link_path = nullptr;
+	const char* script_path = nullptr;
+	bool repeat = false;
+	unsigned seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--link" && i + 1 < argc) link_path = argv[++i];
+		else if (arg == "--script" && i + 1 < argc) script_path = argv[++i];
+		else if (arg == "--seed" && i + 1 < argc) seed = (unsigned)std::atoi(argv[++i]);
+		else if (arg == "--loop") repeat = true;
+		else if (arg == "--verbose") verbose = true;
+		else {
+			std::fprintf(stderr, "usage: %s [--link PATH] [--script FILE|-] [--loop] [--seed N] [--verbose]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Action> actions;
+	if (script_path) {
+		bool ok;
+		if (std::string(script_path) == "-") {
+			ok = ParseScript(std::cin, actions);
+		}
+		else {
+			std::ifstream file(script_path);
+			if (!file) {
+				std::fprintf(stderr, "Can't open script %s\n", script_path);
+				return 1;
+			}
+			ok = ParseScript(file, actions);
+		}
+		if (!ok)
+			return 1;
+	}
+
+	void* memory = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		std::perror("mmap");
+		return 1;
+	}
+	shared = new (memory) SharedState();
+	ReleaseAll();
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+		std::perror("posix_openpt");
+		return 1;
+	}
+	fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+	const char* slave_name = ptsname(master_fd);
+
+	// Raw from the start, so nothing echoes before the game configures the port
+	int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+	if (slave_fd >= 0) {
+		termios tty;
+		tcgetattr(slave_fd, &tty);
+		cfmakeraw(&tty);
+		tcsetattr(slave_fd, TCSANOW, &tty);
+		close(slave_fd);
+	}
+
+	if (link_path) {
+		unlink(link_path);
+		if (symlink(slave_name, link_path) != 0) {
+			std::perror("symlink");
+			return 1;
+		}
+	}
+	std::printf("%s\n", link_path ? link_path : slave_name);
+	std::fflush(stdout);
+
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	ScriptRunner script(actions, repeat, seed);
+	bool script_done = actions.empty();
+	pid_t board = -1;
+
+	while (!quit) {
+		bool open = SlaveOpen();
+		if (open && board < 0) {
+			// The game opened the port, reset the board
+			shared->running = false;
+			shared->binary = false;
+			shared->connections++;
+			if (verbose)
+				std::printf("[emulator] port opened, board reset\n");
+			board = fork();
+			if (board == 0)
+				RunBoard();
+		}
+		else if (!open && board >= 0) {
+			kill(board, SIGKILL);
+			waitpid(board, nullptr, 0);
+			board = -1;
+			shared->running = false;
+			if (verbose)
+				std::printf("[emulator] port closed\n");
+		}
+
+		if (!script_done && !script.Step(std::chrono::steady_clock::now())) {
+			script_done = true;
+			if (!actions.empty())
+				break;
+		}
+		usleep(500);
+	}
+
+	if (board >= 0) {
+		kill(board, SIGKILL);
+		waitpid(board, nullptr, 0);
+	}
+	if (link_path)
+		unlink(link_path);
+
+	std::printf("connections %llu, board sent %llu bytes, received %llu bytes, injected %llu messages\n",
+		shared->connections.load(), shared->bytes_out.load(), shared->bytes_in.load(), shared->injected.load());
+	unsigned long long passes = shared->loop_passes;
+	std::printf("loop() ran %llu times, mean %.1f us, max %.1f us\n", passes,
+		passes ? shared->loop_ns / 1000.0 / passes : 0.0, shared->loop_ns_max / 1000.0);
+	return 0;
+}
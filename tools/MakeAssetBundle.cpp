@@ -0,0 +1,237 @@
+// Builds the asset bundle the game maps at startup, see AssetBundle.h: every
+// texture in bundle_assets decoded to RGBA, every sound decoded and resampled
+// to the mixer's rate, the maze and the compiled trivia bank. Not part of the
+// game build:
+//
+//	g++ -std=c++17 -O2 -I.. MakeAssetBundle.cpp ../AssetBundle.cpp ../TriviaBank.cpp ../MappedFile.cpp ../Log.cpp
+//		-o MakeAssetBundle -lsfml-graphics -lsfml-audio -lsfml-system
+//	cd .. && tools/MakeAssetBundle						writes buzzy.assets
+//
+// Run it from the game's directory after changing anything in textures/,
+// audio/, trivia/ or Map.txt, and build it against SFML 2.6 or later: 2.5 can't decode
+// button_press.mp3. It exits with 1 without writing anything if an asset that
+// isn't optional can't be read, so a bundle always has all of them. Optional
+// ones without a file are listed and left out.
+#include "AssetBundle.h"
+#include "Log.h"
+#include "Mixer.h"
+#include "TriviaBank.h"
+#include <SFML/Audio.hpp>
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+const uint64_t asset_alignment = 16;
+
+struct DecodedAsset
+{
+	const Asset* asset;
+	std::vector<uint8_t> bytes;
+	uint32_t width = 0;			// frames for sounds
+	uint32_t height = 0;
+	unsigned channels = 0;
+};
+
+static bool DecodeTexture(const char* path, DecodedAsset& texture)
+{
+	sf::Image image;
+	if (!image.loadFromFile(path))
+		return false;
+	texture.width = image.getSize().x;
+	texture.height = image.getSize().y;
+	const uint8_t* pixels = image.getPixelsPtr();
+	texture.bytes.assign(pixels, pixels + size_t(texture.width) * texture.height * 4);
+	return !texture.bytes.empty();
+}
+
+// Line ends as '\n' whatever the file was saved with, the game splits on it
+static bool ReadText(const char* path, DecodedAsset& text)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	content.erase(std::remove(content.begin(), content.end(), '\r'), content.end());
+	if (!content.empty() && content.back() != '\n')
+		content += '\n';
+	text.bytes.assign(content.begin(), content.end());
+	return (bool)file || file.eof();
+}
+
+static bool CompileTrivia(const char* path, DecodedAsset& trivia)
+{
+	DecodedAsset text;
+	std::string error;
+	if (!ReadText(path, text))
+		return false;
+	if (!CompileTriviaBank(std::string(text.bytes.begin(), text.bytes.end()), trivia.bytes, error)) {
+		std::fprintf(stderr, "%s: %s\n", path, error.c_str());
+		return false;
+	}
+	trivia.width = ((const TriviaBankHeader*)trivia.bytes.data())->count;
+	return true;
+}
+
+static void Store(const std::vector<int16_t>& samples, DecodedAsset& sound)
+{
+	sound.width = (uint32_t)(samples.size() / sound.channels);
+	sound.bytes.resize(samples.size() * sizeof(int16_t));
+	std::memcpy(sound.bytes.data(), samples.data(), sound.bytes.size());
+}
+
+static bool DecodeSound(const char* path, DecodedAsset& sound)
+{
+	sf::InputSoundFile file;
+	if (!file.openFromFile(path))
+		return false;
+	sound.channels = file.getChannelCount();
+	if (sound.channels < 1 || sound.channels > 2) {
+		std::fprintf(stderr, "%s: %u channels, only mono and stereo are supported\n", path, sound.channels);
+		return false;
+	}
+
+	std::vector<int16_t> samples((size_t)file.getSampleCount());
+	samples.resize((size_t)file.read(samples.data(), samples.size()));
+	samples.resize(samples.size() / sound.channels * sound.channels);
+	if (samples.empty())
+		return false;
+
+	// linear is plenty, everything in audio/ is at 44.1 kHz already
+	unsigned rate = file.getSampleRate();
+	if (rate == mixer_rate) {
+		Store(samples, sound);
+		return true;
+	}
+	size_t in_frames = samples.size() / sound.channels;
+	size_t out_frames = (size_t)(uint64_t(in_frames) * mixer_rate / rate);
+	std::vector<int16_t> resampled(out_frames * sound.channels);
+	for (size_t i = 0; i < out_frames; i++) {
+		double position = double(i) * rate / mixer_rate;
+		size_t at = (size_t)position;
+		size_t next = std::min(at + 1, in_frames - 1);
+		double frac = position - at;
+		for (unsigned c = 0; c < sound.channels; c++) {
+			double a = samples[at * sound.channels + c];
+			double b = samples[next * sound.channels + c];
+			resampled[i * sound.channels + c] = (int16_t)std::lround(a + (b - a) * frac);
+		}
+	}
+	std::printf("%s: resampled from %u Hz\n", path, rate);
+	Store(resampled, sound);
+	return true;
+}
+
+static bool Decode(const char* path, DecodedAsset& decoded)
+{
+	switch (decoded.asset->type) {
+	case ASSET_TEXTURE:
+		return DecodeTexture(path, decoded);
+	case ASSET_SOUND:
+		return DecodeSound(path, decoded);
+	case ASSET_TEXT:
+		return ReadText(path, decoded);
+	case ASSET_TRIVIA:
+		return CompileTrivia(path, decoded);
+	}
+	return false;
+}
+
+static int Build(const std::string& out_path)
+{
+	std::vector<DecodedAsset> assets;
+	bool failed = false;
+	for (int i = 0; i < bundle_asset_count; i++) {
+		const Asset& asset = bundle_assets[i];
+		if (!std::ifstream(asset.path)) {
+			if (asset.optional)
+				std::printf("%s: missing, optional, left out\n", asset.path);
+			else {
+				std::fprintf(stderr, "%s: missing\n", asset.path);
+				failed = true;
+			}
+			continue;
+		}
+		DecodedAsset decoded;
+		decoded.asset = &asset;
+		if (!Decode(asset.path, decoded)) {
+			std::fprintf(stderr, "%s: couldn't decode it\n", asset.path);
+			failed = true;
+			continue;
+		}
+		assets.push_back(std::move(decoded));
+	}
+	if (failed) {
+		std::fprintf(stderr, "%s not written\n", out_path.c_str());
+		return 1;
+	}
+
+	AssetBundleHeader header;
+	std::memcpy(header.magic, asset_bundle_magic, sizeof(header.magic));
+	header.version = asset_bundle_version;
+	header.count = (uint32_t)assets.size();
+	header.sound_rate = mixer_rate;
+
+	std::vector<AssetEntry> entries(assets.size());
+	uint64_t offset = sizeof(header) + entries.size() * sizeof(AssetEntry);
+	for (size_t i = 0; i < assets.size(); i++) {
+		AssetEntry& entry = entries[i];
+		std::memset(&entry, 0, sizeof(entry));
+		std::strncpy(entry.name, assets[i].asset->name, asset_name_size - 1);
+		offset = (offset + asset_alignment - 1) / asset_alignment * asset_alignment;
+		entry.type = assets[i].asset->type;
+		entry.channels = (uint16_t)assets[i].channels;
+		entry.width = assets[i].width;
+		entry.height = assets[i].height;
+		entry.offset = offset;
+		entry.size = assets[i].bytes.size();
+		offset += entry.size;
+	}
+
+	// written next to it and renamed, so the game never maps half a bundle
+	std::string temp_path = out_path + ".tmp";
+	std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)entries.data(), entries.size() * sizeof(AssetEntry));
+	for (size_t i = 0; i < assets.size(); i++) {
+		static const char padding[asset_alignment] = {};
+		out.write(padding, entries[i].offset - (uint64_t)out.tellp());
+		out.write((const char*)assets[i].bytes.data(), assets[i].bytes.size());
+	}
+	out.close();
+#ifdef _WIN32
+	// rename doesn't replace on Windows
+	if (out)
+		std::remove(out_path.c_str());
+#endif
+	if (!out || std::rename(temp_path.c_str(), out_path.c_str()) != 0) {
+		std::fprintf(stderr, "couldn't write %s\n", out_path.c_str());
+		std::remove(temp_path.c_str());
+		return 1;
+	}
+
+	for (const AssetEntry& entry : entries) {
+		if (entry.type == ASSET_TEXTURE)
+			std::printf("%-20s texture %4u x %-4u\n", entry.name, entry.width, entry.height);
+		else if (entry.type == ASSET_SOUND)
+			std::printf("%-20s %s %6.2f s\n", entry.name, entry.channels == 2 ? "stereo " : "mono   ", entry.width / double(mixer_rate));
+		else if (entry.type == ASSET_TRIVIA)
+			std::printf("%-20s trivia  %u questions\n", entry.name, entry.width);
+		else
+			std::printf("%-20s text    %llu bytes\n", entry.name, (unsigned long long)entry.size);
+	}
+	std::printf("%s: %zu assets, %.1f MB\n", out_path.c_str(), assets.size(), offset / 1048576.0);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	// the asset and trivia code report what's wrong through the log
+	StartLog();
+	int result = Build(argc > 1 ? argv[1] : asset_bundle_name);
+	StopLog();
+	return result;
+}
@@ -0,0 +1,133 @@
+// Start time test for the Mixer: how closely sounds come out mixer_latency_ms
+// after the tick that played them when neither side keeps good time.
+// Not part of the game build, compile it on its own:
+//
+//	g++ -std=c++17 -O2 -I.. MixerJitterBench.cpp ../Mixer.cpp ../Log.cpp -o MixerJitterBench
+//		-lsfml-audio -lsfml-system -pthread
+//	./MixerJitterBench [seconds]
+//
+// Nothing is played. A fake audio thread calls onGetData once a chunk, up to
+// 5 ms early or late, for a device that plays at a steady rate. A fake sim
+// ticks every 16 ms and starts a click at a random point in each tick,
+// stamped with the tick's start like the game does. Each click is then found
+// in the mixed output and its time on the device compared with where it
+// should be. The first second is left out while the mixer's clock settles.
+#include "Mixer.h"
+#include "Clock.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+const double chunk_seconds = double(mixer_chunk_frames) / mixer_rate;
+const int callback_jitter_us = 5000;
+const int tick_us = 16000;
+const int click_frames = 64;
+const int settle_seconds = 1;
+
+// onGetData is what SFML's audio thread calls
+struct BenchMixer : Mixer
+{
+	using Mixer::onGetData;
+};
+
+static void Sleep(uint64_t until_us)
+{
+	std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(until_us)));
+}
+
+static int Run(int seconds)
+{
+	static BenchMixer mixer;
+	std::vector<int16_t> click(click_frames, 20000);
+	MixerSource source;
+	source.samples = click.data();
+	source.frames = click_frames;
+
+	// The device plays frame 0 at device_start, so the chunk filled at
+	// callback k comes out at device_start + k chunks, two chunks after the
+	// callback is due (see queued_us in Mixer.cpp)
+	uint64_t start_us = MonotonicUs() + 100000;
+	uint64_t device_start_us = start_us + uint64_t(2 * chunk_seconds * 1e6);
+	int chunks = int(seconds / chunk_seconds);
+	std::vector<int16_t> left;
+	left.reserve(size_t(chunks) * mixer_chunk_frames);
+
+	std::thread audio([&] {
+		std::mt19937 rng(1);
+		std::uniform_int_distribution<int> jitter(-callback_jitter_us, callback_jitter_us);
+		sf::SoundStream::Chunk chunk;
+		for (int k = 0; k < chunks; k++) {
+			Sleep(start_us + uint64_t(k * chunk_seconds * 1e6) + jitter(rng));
+			mixer.onGetData(chunk);
+			for (size_t i = 0; i < chunk.sampleCount; i += mixer_channels)
+				left.push_back(chunk.samples[i]);
+		}
+	});
+
+	// One click per tick, on a voice that finished long ago
+	std::vector<uint64_t> ticks;
+	std::mt19937 rng(2);
+	std::uniform_int_distribution<int> offset(0, tick_us);
+	uint64_t tick = start_us;
+	uint64_t last_tick = start_us + uint64_t(seconds) * 1000000 - 200000;
+	for (uint16_t n = 0; tick < last_tick; n++, tick += tick_us) {
+		Sleep(tick + offset(rng));
+		mixer.startVoice(n % mixer_voice_count, uint16_t(n / mixer_voice_count + 1), source, tick);
+		ticks.push_back(tick);
+	}
+	audio.join();
+
+	// Each click starts after a stretch of silence
+	std::vector<uint64_t> onsets;
+	size_t silent = click_frames;
+	for (size_t i = 0; i < left.size(); i++) {
+		if (left[i] != 0 && silent >= click_frames)
+			onsets.push_back(i);
+		silent = left[i] == 0 ? silent + 1 : 0;
+	}
+	if (onsets.size() != ticks.size()) {
+		std::printf("%zu clicks started but %zu came out\n", ticks.size(), onsets.size());
+		return 1;
+	}
+
+	// How far each came out from its tick + mixer_latency_ms
+	std::vector<double> errors_ms;
+	for (size_t i = 0; i < ticks.size(); i++) {
+		if (ticks[i] < start_us + settle_seconds * 1000000)
+			continue;
+		double out_us = device_start_us + onsets[i] * 1e6 / mixer_rate;
+		double want_us = ticks[i] + mixer_latency_ms * 1000.0;
+		errors_ms.push_back((out_us - want_us) / 1000);
+	}
+	std::sort(errors_ms.begin(), errors_ms.end());
+	double lo = errors_ms.front();
+	double hi = errors_ms.back();
+	double median = errors_ms[errors_ms.size() / 2];
+	double p99 = errors_ms[errors_ms.size() * 99 / 100];
+	std::printf("%zu clicks, callbacks +/-%d ms, ticks anywhere in %d ms\n",
+		errors_ms.size(), callback_jitter_us / 1000, tick_us / 1000);
+	// the worst few are usually this process not being scheduled in time
+	std::printf("start error: min %.2f ms, median %.2f ms, 99%% %.2f ms, max %.2f ms\n",
+		lo, median, p99, hi);
+	mixer.logTiming();
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = argc > 1 ? std::atoi(argv[1]) : 10;
+	if (seconds <= settle_seconds) {
+		std::fprintf(stderr, "Run for more than %d s\n", settle_seconds);
+		return 1;
+	}
+
+	// logTiming and the mixer's warnings go through the log
+	StartLog();
+	int result = Run(seconds);
+	StopLog();
+	return result;
+}
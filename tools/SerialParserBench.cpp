@@ -0,0 +1,177 @@
+// Throughput benchmark for SerialLineParser, fed with captured Arduino traffic.
+// Not part of the game build, compile it on its own:
+//
+//	g++ -std=c++17 -O2 -I.. SerialParserBench.cpp ../SerialLineParser.cpp -o SerialParserBench
+//	./SerialParserBench serial_capture.txt
+//
+// The capture is fed in several read sizes, 1 byte at a time up to whole
+// buffers, and every read size has to produce the same events. For comparison
+// it also runs the old approach of treating each read as one message and
+// searching it with std::string::find. Last it checks that overlong lines
+// are dropped wherever they land in the ring.
+#include "SerialLineParser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct BenchResult
+{
+	size_t lines = 0;
+	size_t events = 0;
+	int checksum = 0;
+	double seconds = 0;
+};
+
+static BenchResult RunParser(const std::string& capture, size_t read_size, int iterations)
+{
+	SerialLineParser parser;
+	BenchResult result;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int it = 0; it < iterations; it++) {
+		for (size_t pos = 0; pos < capture.size(); pos += read_size) {
+			size_t length = std::min(read_size, capture.size() - pos);
+			const char* data = capture.data() + pos;
+
+			size_t used = 0;
+			while (used < length) {
+				used += parser.Feed(data + used, length - used);
+
+				std::string_view line;
+				while (parser.NextLine(line)) {
+					result.lines++;
+					SerialEventType type;
+					int value;
+					if (ParseSerialLine(line, type, value)) {
+						result.events++;
+						result.checksum += type * 8 + value;
+					}
+				}
+			}
+		}
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+// What SerialController::update() used to do with every read
+static BenchResult RunLegacy(const std::string& capture, size_t read_size, int iterations)
+{
+	BenchResult result;
+	std::string lastMessage;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int it = 0; it < iterations; it++) {
+		for (size_t pos = 0; pos < capture.size(); pos += read_size) {
+			char buffer[256] = { 0 };
+			size_t length = std::min(std::min(read_size, sizeof(buffer) - 1), capture.size() - pos);
+			std::memcpy(buffer, capture.data() + pos, length);
+			std::string input(buffer);
+			lastMessage = input;
+			result.lines++;
+
+			if (input.find("RESET_GAME") != std::string::npos) result.events++;
+			if (input.find("Button") != std::string::npos ||
+				input.find("NextScreen") != std::string::npos ||
+				input.find("Answering") != std::string::npos) result.events++;
+			if (input.find("Up") != std::string::npos && input.find("Selected") == std::string::npos) result.events++;
+			if (input.find("Down") != std::string::npos && input.find("Selected") == std::string::npos) result.events++;
+			if (input.find("Left") != std::string::npos) result.events++;
+			if (input.find("Right") != std::string::npos) result.events++;
+			size_t selectedPos = input.find("Selected: ");
+			if (selectedPos != std::string::npos && selectedPos + 10 < input.length()) result.events++;
+		}
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+// A line longer than serial_line_max whose end arrives in the same read has to
+// be dropped, wherever in the ring it lands, including across its end. The
+// lines around it still come out.
+static bool CheckLongLines()
+{
+	std::string long_line(250, 'x');
+	for (size_t shift = 0; shift < serial_ring_size; shift++) {
+		SerialLineParser parser;
+		// move the ring's start along so the long line wraps at every offset
+		std::string input = std::string(shift, 'y') + "\n" + long_line + "\r\nUp\n";
+
+		std::vector<std::string> lines;
+		size_t used = 0;
+		while (used < input.size()) {
+			used += parser.Feed(input.data() + used, input.size() - used);
+			std::string_view line;
+			while (parser.NextLine(line)) {
+				if (line.size() > serial_line_max) {
+					std::printf("line of %zu bytes came out at shift %zu\n", line.size(), shift);
+					return false;
+				}
+				lines.emplace_back(line);
+			}
+		}
+		size_t expected_dropped = shift > serial_line_max ? 2 : 1;
+		if (lines.empty() || lines.back() != "Up" || parser.DroppedLines() != expected_dropped) {
+			std::printf("long line mishandled at shift %zu: %zu lines, %u dropped\n",
+				shift, lines.size(), parser.DroppedLines());
+			return false;
+		}
+	}
+	return true;
+}
+
+// ns/line is per line in the capture, for both approaches
+static void Report(const char* name, size_t read_size, const BenchResult& r, size_t bytes, size_t lines)
+{
+	std::printf("%-8s read %4zu: %8.1f MB/s %8.1f ns/line  events %zu\n",
+		name, read_size, bytes / r.seconds / 1e6, r.seconds * 1e9 / lines, r.events);
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "serial_capture.txt";
+	int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::fprintf(stderr, "Can't open capture %s\n", path);
+		return 1;
+	}
+	std::string capture((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	size_t bytes = capture.size() * iterations;
+	size_t lines = std::count(capture.begin(), capture.end(), '\n') * iterations;
+	std::printf("%s: %zu bytes x %d\n", path, capture.size(), iterations);
+
+	const size_t read_sizes[] = { 1, 7, 64, 255 };
+	BenchResult reference;
+	bool consistent = true;
+	for (size_t read_size : read_sizes) {
+		BenchResult r = RunParser(capture, read_size, iterations);
+		Report("parser", read_size, r, bytes, lines);
+		if (read_size == read_sizes[0])
+			reference = r;
+		else if (r.lines != reference.lines || r.events != reference.events || r.checksum != reference.checksum)
+			consistent = false;
+	}
+	for (size_t read_size : read_sizes) {
+		if (read_size == 1)
+			continue;	// one byte reads never match anything the old way
+		Report("legacy", read_size, RunLegacy(capture, read_size, iterations), bytes, lines);
+	}
+
+	if (!CheckLongLines())
+		return 1;
+	std::printf("long lines dropped at every ring offset\n");
+
+	if (!consistent) {
+		std::printf("parser output depends on read size!\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,243 @@
+// Records and replays serial traffic between the game and the Arduino, see
+// SerialCapture.h for the file format. Not part of the game build:
+//
+//	g++ -std=c++17 -O2 -pthread -I.. SerialReplay.cpp ../SerialCapture.cpp ../SerialController.cpp ../SerialHub.cpp
+//		../SerialSupervisor.cpp ../SerialLineParser.cpp ../SerialPortPosix.cpp ../SerialPortWin32.cpp ../Log.cpp -o SerialReplay
+//
+//	./SerialReplay --record /dev/ttyACM0 session.bzcap 60	record a board for a minute
+//	./SerialReplay --dump session.bzcap					print a recording
+//	./SerialReplay session.bzcap							replay at the recorded pace
+//	./SerialReplay --fast session.bzcap					replay as fast as possible
+//
+// The game records a live exhibit itself with BUZZY_SERIAL_CAPTURE=file.
+//
+// A replay runs the recording through SerialController and prints the input it
+// produces. The commands the game sent (mode changes, resets, flowers) are
+// issued again at the point they were sent live, the handshake and retries the
+// controller does by itself. Exits with 2 if the controller's output didn't
+// match the recording.
+#include "SerialCapture.h"
+#include "SerialController.h"
+#include "Log.h"
+#include "Clock.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+const size_t replay_fast_reads = 2;
+
+static std::string Printable(const std::string& data)
+{
+	std::string out;
+	for (unsigned char c : data) {
+		if (c >= 32 && c < 127 && c != '\\') {
+			out += (char)c;
+		}
+		else {
+			char hex[8];
+			std::snprintf(hex, sizeof(hex), "\\x%02X", c);
+			out += hex;
+		}
+	}
+	return out;
+}
+
+static int Dump(const char* path)
+{
+	std::vector<CaptureRecord> records;
+	uint64_t started = 0;
+	if (!ReadSerialCapture(path, records, &started))
+		return 1;
+
+	std::printf("%s: %zu records, recorded at unix time %llu.%03llu\n", path, records.size(),
+		(unsigned long long)(started / 1000), (unsigned long long)(started % 1000));
+	for (const CaptureRecord& rec : records) {
+		double seconds = rec.time_us / 1e6;
+		if (rec.type == CAPTURE_BAUD) {
+			unsigned long baud = 0;
+			for (size_t i = 0; i < rec.data.size() && i < 4; i++)
+				baud |= (unsigned long)(uint8_t)rec.data[i] << (8 * i);
+			std::printf("%12.6f BAUD %lu\n", seconds, baud);
+		}
+		else {
+			std::printf("%12.6f %s  %s\n", seconds, rec.type == CAPTURE_IN ? "IN " : "OUT", Printable(rec.data).c_str());
+		}
+	}
+	return 0;
+}
+
+// Prints whatever input the controller produced this tick, returns how many events
+static int PrintInput(SerialController& controller, uint64_t start_us)
+{
+	double t = (MonotonicUs() - start_us) / 1e6;
+	int events = 0;
+	auto print = [&](const char* what, int value) {
+		if (value >= 0)
+			std::printf("%10.3f %s %d\n", t, what, value);
+		else
+			std::printf("%10.3f %s\n", t, what);
+		events++;
+	};
+
+	if (controller.isUpPressed()) print("UP", -1);
+	if (controller.isDownPressed()) print("DOWN", -1);
+	if (controller.isLeftPressed()) print("LEFT", -1);
+	if (controller.isRightPressed()) print("RIGHT", -1);
+	static int stick_x = 0, stick_y = 0;
+	if (controller.getStickX() != stick_x || controller.getStickY() != stick_y) {
+		stick_x = controller.getStickX();
+		stick_y = controller.getStickY();
+		std::printf("%10.3f STICK %d %d\n", t, stick_x, stick_y);
+		events++;
+	}
+	if (controller.isButtonPressed()) print("BUTTON", -1);
+	if (controller.isSelectionChanged()) print("SELECTED", controller.getSelectedAnswer());
+	if (controller.isResetRequested()) print("RESET_GAME", -1);
+	controller.resetJoystickFlags();
+	return events;
+}
+
+// Sends a recorded game command through the controller again. The handshake
+// and HELLO echo are the controller's own, and a write identical to the one
+// before is a retry it repeats by itself if the ack is missing again. LED
+// writes become the state they left the strip in, leds carries it along.
+static void IssueCommand(SerialController& controller, const std::string& data, std::string& last, unsigned& leds)
+{
+	bool retry = data == last;
+	last = data;
+	if (retry)
+		return;
+
+	if (data.size() == (size_t)frame_size && (uint8_t)data[0] == frame_sync) {
+		uint8_t type = (uint8_t)data[1], value = (uint8_t)data[2];
+		if (type == FRAME_MODE && value == 0) controller.setSteeringMode();
+		else if (type == FRAME_MODE) controller.setAnsweringMode();
+		else if (type == FRAME_GAME_RESET) {
+			controller.resetGame();
+			controller.setFlowerLeds(leds = 0);
+		}
+		else if (type == FRAME_FLOWER) controller.setFlowerLeds(leds = value == 5 ? 0 : leds | FlowerLed(value));
+		else if (type == FRAME_LEDS) controller.setFlowerLeds(leds = value);
+		return;
+	}
+
+	std::string line = data.substr(0, data.find_first_of("\r\n"));
+	if (line == "MODE:STEERING") controller.setSteeringMode();
+	else if (line == "MODE:ANSWERING") controller.setAnsweringMode();
+	else if (line == "GAME:RESET") {
+		controller.resetGame();
+		controller.setFlowerLeds(leds = 0);
+	}
+	else if (!line.empty() && line.find_first_not_of("0123456789") == std::string::npos) {
+		int flower = std::atoi(line.c_str());
+		controller.setFlowerLeds(leds = flower == 5 ? 0 : leds | FlowerLed(flower));
+	}
+}
+
+static int Replay(const char* path, bool fast)
+{
+	std::unique_ptr<ReplaySerialPort> owned(new ReplaySerialPort(!fast));
+	ReplaySerialPort* replay = owned.get();
+	if (fast)
+		replay->holdAt(replay_fast_reads);
+
+	SerialController controller;
+	if (!controller.initialize(path, std::move(owned)))
+		return 1;
+
+	const std::vector<CaptureRecord>& records = replay->recording();
+	uint64_t inbound = 0;
+	for (const CaptureRecord& rec : records) {
+		if (rec.type == CAPTURE_IN)
+			inbound += rec.data.size();
+	}
+
+	uint64_t start = MonotonicUs();
+	size_t next_out = 0;
+	std::string last_command;
+	unsigned leds = 0;
+	int events = 0;
+	while (!replay->finished()) {
+		for (; next_out < replay->position(); next_out++) {
+			if (records[next_out].type == CAPTURE_OUT)
+				IssueCommand(controller, records[next_out].data, last_command, leds);
+		}
+
+		controller.update();
+		events += PrintInput(controller, start);
+
+		if (fast) {
+			// Two reads are at most 128 frames, half of the controller's event queue
+			size_t position = replay->position();
+			replay->holdAt(position + replay_fast_reads);
+			while (replay->position() == position && !replay->finished())
+				std::this_thread::yield();
+		}
+		else {
+			// About the game's frame rate
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	double seconds = (MonotonicUs() - start) / 1e6;
+
+	// Input from the last read is still on its way through the reader thread
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	controller.update();
+	events += PrintInput(controller, start);
+	bool diverged = replay->mismatchedBytes() > 0 || replay->stalls() > 0;
+	controller.disconnect();
+
+	// A fast replay feeds two reads per poll, so it can see fewer inputs than a
+	// paced one: the controller's flags only say what happened since the last poll
+	std::printf("%zu records, %llu bytes in %.3f s (%.0f KB/s), %d inputs seen\n",
+		records.size(), (unsigned long long)inbound, seconds, seconds > 0 ? inbound / seconds / 1024 : 0.0, events);
+	std::printf("output %s the recording: %llu bytes differ, %u stalls\n", diverged ? "does NOT match" : "matches",
+		(unsigned long long)replay->mismatchedBytes(), replay->stalls());
+	return diverged ? 2 : 0;
+}
+
+// Runs a board through the controller and records the session, replaces the
+// old 30 second raw dump in Gameloop.cpp
+static int Record(const char* port_name, const char* path, int seconds)
+{
+	SerialController controller;
+	if (!controller.initialize(port_name, CreateCapturingSerialPort(CreateSerialPort(), path)))
+		return 1;
+	controller.resetGame();
+
+	std::printf("Recording %s to %s for %d seconds, move the joystick and press the button\n", port_name, path, seconds);
+	uint64_t start = MonotonicUs();
+	uint64_t end = start + (uint64_t)seconds * 1000000;
+	while (MonotonicUs() < end) {
+		controller.update();
+		PrintInput(controller, start);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	controller.disconnect();
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::string mode = argc > 1 ? argv[1] : "";
+	int result;
+
+	StartLog();
+	if (mode == "--dump" && argc == 3)
+		result = Dump(argv[2]);
+	else if (mode == "--record" && (argc == 4 || argc == 5))
+		result = Record(argv[2], argv[3], argc == 5 ? std::atoi(argv[4]) : 30);
+	else if (mode == "--fast" && argc == 3)
+		result = Replay(argv[2], true);
+	else if (argc == 2 && mode.compare(0, 2, "--") != 0)
+		result = Replay(argv[1], false);
+	else {
+		std::fprintf(stderr, "usage: %s [--fast] FILE | --dump FILE | --record PORT FILE [SECONDS]\n", argv[0]);
+		result = 1;
+	}
+	StopLog();
+	return result;
+}
@@ -0,0 +1,33 @@
+#ifndef ADAFRUIT_NEOPIXEL_H
+#define ADAFRUIT_NEOPIXEL_H
+// Stand-in for the NeoPixel library, keeps the colors so a host tool can see
+// what the strip would show. OnStripShow is implemented by that tool.
+#include "Arduino.h"
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+const int neopixel_max_pixels = 64;
+
+void OnStripShow(const uint32_t* pixels, int count);
+
+class Adafruit_NeoPixel
+{
+public:
+	Adafruit_NeoPixel(int count, int /* pin */, int /* type */) : count(count < neopixel_max_pixels ? count : neopixel_max_pixels) {}
+
+	void begin() { std::memset(pixels, 0, sizeof(pixels)); }
+	void show() { OnStripShow(pixels, count); }
+	void setPixelColor(int i, uint32_t color)
+	{
+		if (i >= 0 && i < count)
+			pixels[i] = color;
+	}
+	static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+
+private:
+	int count;
+	uint32_t pixels[neopixel_max_pixels] = {};
+};
+
+#endif // !ADAFRUIT_NEOPIXEL_H
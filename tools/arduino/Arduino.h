@@ -0,0 +1,48 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+// Just enough of the Arduino core to build CombinedSteeringAnswering.ino on a
+// PC. The functions are implemented by the tool that includes the sketch, see
+// ArduinoEmulator.cpp.
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define A0 14
+#define A1 15
+
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+int analogRead(int pin);	// 0 .. 1023
+void digitalWrite(int pin, int value);
+unsigned long millis();
+void delay(unsigned long ms);
+
+class HardwareSerial
+{
+public:
+	void begin(unsigned long baud);
+	void end();
+	void flush();
+	int available();
+	int peek();
+	int read();
+
+	size_t write(uint8_t byte) { return write(&byte, 1); }
+	size_t write(const uint8_t* data, size_t size);
+	size_t print(const char* text) { return write((const uint8_t*)text, std::strlen(text)); }
+	size_t print(int value) { return print(std::to_string(value).c_str()); }
+	size_t println() { return print("\r\n"); }
+	size_t println(const char* text) { return print(text) + println(); }
+	size_t println(int value) { return print(value) + println(); }
+};
+
+extern HardwareSerial Serial;
+
+#endif // !ARDUINO_H